@@ -1,99 +1,181 @@
 #include <cmath>
 #include <AdsrEnvelope.h>
 
+#ifdef ADSR_ENVELOPE_FLOAT
+const AdsrEnvelope::Level AdsrEnvelope::LEVEL_MAX = 1.0f;
+#else
+const AdsrEnvelope::Level AdsrEnvelope::LEVEL_MAX = 0xFFFF;
+#define RATE_INSTANT 0xFFFFFFFF
+#endif
+#define TIME_MAX 2147483U // Longest phase time (ms, half the clock range in us)
+
 // Class constructor/initialisation
 AdsrEnvelope::AdsrEnvelope() {
     data = {
         .state = AdsrEnvelope::IDLE,
-        .output = 0.0f,
-        .lastTime = 0U,
-        .target = 0.0f,
-        .attackRate = 0.0f,
-        .decayStart = 0.0f,
-        .decayRate = 0.0f,
-        .sustainLevel = 0.0f,
-        .releaseStart = 0.0f,
-        .releaseRate = 0.0f,
+        .output = 0,
+        .phaseStart = 0U,
+        .startPending = false,
+        .target = 0,
+        .attackRate = 0,
+        .decayStart = 0,
+        .decayRate = 0,
+        .sustainLevel = 0,
+        .releaseStart = 0,
+        .releaseRate = 0,
         .releaseTime = 0U,
+        .attackTime = 0U,
     };
 }
 
 // Start the ADSR envelope with given parameters
 void AdsrEnvelope::noteOn(unsigned long attackTime, unsigned long decayTime, float sustainLevel, unsigned long releaseTime) {
     data.state = AdsrEnvelope::ATTACK;
-    data.output = 0.0f;
-    data.lastTime = 0U;
-    data.target = 1.0f;
-    data.attackRate = 1.0f / attackTime;
-    data.decayRate = (1.0f - sustainLevel) / decayTime;
-    data.sustainLevel = sustainLevel;
+    data.output = 0;
+    data.startPending = true;
+    data.target = LEVEL_MAX;
+    data.sustainLevel = toLevel(sustainLevel);
+    data.attackRate = rate(LEVEL_MAX, attackTime);
+    data.decayRate = rate(LEVEL_MAX - data.sustainLevel, decayTime);
     data.releaseTime = releaseTime;
+    data.attackTime = toMicros(attackTime);
 }
 
 // Trigger the release phase of the ADSR envelope
 void AdsrEnvelope::noteOff(void) {
     if (data.state != AdsrEnvelope::IDLE) {
         data.state = AdsrEnvelope::RELEASE;
-        data.lastTime = 0U;
-        data.target = 0.0f;
+        data.startPending = true;
+        data.target = 0;
         data.releaseStart = data.output;
-        data.releaseRate = data.releaseStart / data.releaseTime;
+        data.releaseRate = rate(data.releaseStart, data.releaseTime);
     }
 }
 
-// Update the ADSR envelope phase and output value (assumes monotonically increasing time)
-void AdsrEnvelope::tick(unsigned long time) {
+// Update the ADSR envelope phase and output value (phases start at the first tick after they begin)
+// Returns true if the envelope was active and its output was updated
+bool AdsrEnvelope::tick(unsigned long time) {
     // Do nothing if the envelope is idle
     if (data.state == AdsrEnvelope::IDLE)
-        return;
+        return false;
 
-    // Handle envelope relative time
-    if (data.lastTime == 0U)
-        data.lastTime = time;
-    unsigned long relativeTime = time - data.lastTime;
+    // Handle envelope relative time (times before the phase start count as the phase start)
+    if (data.startPending) {
+        data.phaseStart = time;
+        data.startPending = false;
+    }
+    int32_t relativeTime = (int32_t)(time - data.phaseStart);
+    if (relativeTime < 0)
+        relativeTime = 0;
 
     // Update envelope state and output
+    Level delta, step;
     switch (data.state) {
+        case AdsrEnvelope::IDLE: // Idle phase (handled above)
+            break;
         case AdsrEnvelope::ATTACK: // Attack phase
-            data.output = std::isinf(data.attackRate) ? data.target : relativeTime * data.attackRate;
+            data.output = advance(data.target, data.attackRate, relativeTime);
             if (data.output >= data.target) { // Change to decay phase?
                 data.state = AdsrEnvelope::DECAY;
                 data.output = data.target;
-                data.lastTime = 0U;
+                data.phaseStart += data.attackTime;
                 data.decayStart = data.target;
                 data.target = data.sustainLevel;
             }
             break;
         case AdsrEnvelope::DECAY: // Decay phase
-            data.output = std::isinf(data.decayRate) ? data.target : data.decayStart - (relativeTime * data.decayRate);
-            if (data.output <= data.target) { // Change to sustain phase?
+            delta = data.decayStart - data.target;
+            step = advance(delta, data.decayRate, relativeTime);
+            data.output = data.decayStart - step;
+            if (step >= delta) { // Change to sustain phase?
                 data.state = AdsrEnvelope::SUSTAIN;
                 data.output = data.target;
-                data.lastTime = 0U;
             }
             break;
         case AdsrEnvelope::SUSTAIN: // Sustain phase
-            data.lastTime = 0U;
-            if (data.output == 0.0) // Skip to idle phase?
+            if (data.output == 0) // Skip to idle phase?
                 data.state = AdsrEnvelope::IDLE;
             break;
         case AdsrEnvelope::RELEASE: // Release phase
-            data.output = std::isinf(data.releaseRate) ? data.target : data.releaseStart - (relativeTime * data.releaseRate);
-            if (data.output <= data.target) { // Change to idle phase?
+            delta = data.releaseStart;
+            step = advance(delta, data.releaseRate, relativeTime);
+            data.output = data.releaseStart - step;
+            if (step >= delta) { // Change to idle phase?
                 data.state = AdsrEnvelope::IDLE;
                 data.output = data.target;
-                data.lastTime = 0U;
             }
             break;
     }
+    return true;
 }
 
-// Get the current ADSR envelope output value
+// Get the current ADSR envelope output value (0.0 to 1.0)
 float AdsrEnvelope::getOutput(void) {
+#ifdef ADSR_ENVELOPE_FLOAT
+    return data.output;
+#else
+    return data.output * (1.0f / LEVEL_MAX);
+#endif
+}
+
+// Get the current ADSR envelope output level (0 to LEVEL_MAX)
+AdsrEnvelope::Level AdsrEnvelope::getLevel(void) {
     return data.output;
 }
 
+// Scale an 8-bit value by the current ADSR envelope output
+uint8_t AdsrEnvelope::scale(uint8_t value) {
+#ifdef ADSR_ENVELOPE_FLOAT
+    return round(data.output * value);
+#else
+    return ((uint32_t)data.output * value + 0x8000) >> 16;
+#endif
+}
+
 // Test if the ADSR envelope is in idle state
 bool AdsrEnvelope::isIdle(void) {
     return data.state == AdsrEnvelope::IDLE;
 }
+
+// Convert a value in the 0.0 to 1.0 range into an envelope level
+AdsrEnvelope::Level AdsrEnvelope::toLevel(float value) {
+    if (value <= 0.0f)
+        return 0;
+    if (value >= 1.0f)
+        return LEVEL_MAX;
+#ifdef ADSR_ENVELOPE_FLOAT
+    return value;
+#else
+    return value * LEVEL_MAX + 0.5f;
+#endif
+}
+
+// Compute the rate needed to cover a level delta in the given time (ms, rounded up so phases end on time)
+AdsrEnvelope::Rate AdsrEnvelope::rate(Level delta, unsigned long time) {
+#ifdef ADSR_ENVELOPE_FLOAT
+    return time == 0U ? INFINITY : delta / toMicros(time);
+#else
+    if (time == 0U)
+        return RATE_INSTANT;
+    unsigned long micros = toMicros(time);
+    return (((uint64_t)delta << 24) + micros - 1) / micros;
+#endif
+}
+
+// Convert a phase time from ms to us (clamped to TIME_MAX, so that it does not overflow 32 bits)
+unsigned long AdsrEnvelope::toMicros(unsigned long time) {
+    return (time < TIME_MAX ? time : TIME_MAX) * 1000U;
+}
+
+// Compute how much a segment advanced at a given rate and relative time (clamped to delta)
+AdsrEnvelope::Level AdsrEnvelope::advance(Level delta, Rate rate, uint32_t relativeTime) {
+#ifdef ADSR_ENVELOPE_FLOAT
+    Level step = relativeTime * rate;
+    return (std::isinf(rate) || !(step < delta)) ? delta : step;
+#else
+    if (rate == RATE_INSTANT)
+        return delta;
+    uint64_t step = ((uint64_t)relativeTime * rate) >> 24;
+    return step < delta ? step : delta;
+#endif
+}
@@ -2,25 +2,55 @@
 #define ADSR_ENVELOPE_H
 /**
  * ADSR envelope class - Handles computation of a classical Attack-Decay-Sustain-Release envelope.
+ * This is a standalone single envelope (linear phases, own parameters) for sketches driving their own
+ * LEDs. MidiLeds and MidiLedsMultiChannel do not use it: they render with AdsrEnvelopeBank, which
+ * shares parameters between envelopes and supports curve shapes.
+ *
+ * By default the envelope runs on a fixed-point engine (Q16 levels, Q8.24 rates) so that ticking
+ * does not need any floating-point math. Define ADSR_ENVELOPE_FLOAT to use the floating-point
+ * reference engine instead (same curves within one brightness step, see extras/tests/AdsrEnvelopeTest.cpp).
+ * Times are microsecond timestamps (e.g. micros()) while phase times are given in ms. The start of the
+ * current phase is kept explicitly and compared as a signed 32-bit difference, so any timestamp
+ * (including 0) is valid and the clock can wrap around (phase times are clamped to 2147483 ms, half
+ * the clock range).
  *
  * Hugo Hromic - http://github.com/hhromic
  * MIT license
  */
 
-#include <Arduino.h>
+#include <cinttypes>
+#include <MidiLedsCompat.h>
+
+// Uncomment to use the floating-point reference engine
+//#define ADSR_ENVELOPE_FLOAT
 
 class AdsrEnvelope {
     public:
+        // Envelope level and rate types (rates are in level units per microsecond)
+#ifdef ADSR_ENVELOPE_FLOAT
+        typedef float Level;
+        typedef float Rate;
+#else
+        typedef uint16_t Level;
+        typedef uint32_t Rate; // Q8.24
+#endif
+
         // Class constructor
         AdsrEnvelope();
 
         // Public methods
         void noteOn(unsigned long attackTime, unsigned long decayTime, float sustainLevel, unsigned long releaseTime);
         void noteOff(void);
-        void tick(unsigned long time);
+        bool tick(unsigned long time);
         float getOutput(void);
+        Level getLevel(void);
+        uint8_t scale(uint8_t value);
         bool isIdle(void);
 
+        // Level helpers
+        static const Level LEVEL_MAX;
+        static Level toLevel(float value);
+
     private:
         // Possible envelope states
         enum States { IDLE, ATTACK, DECAY, SUSTAIN, RELEASE };
@@ -28,17 +58,24 @@ class AdsrEnvelope {
         // Internal envelope data
         struct Data {
             States state;
-            float output;
-            unsigned long lastTime;
-            float target;
-            float attackRate;
-            float decayStart;
-            float decayRate;
-            float sustainLevel;
-            float releaseStart;
-            float releaseRate;
+            Level output;
+            unsigned long phaseStart;
+            bool startPending; // Phase starts on the next tick
+            Level target;
+            Rate attackRate;
+            Level decayStart;
+            Rate decayRate;
+            Level sustainLevel;
+            Level releaseStart;
+            Rate releaseRate;
             unsigned long releaseTime;
+            unsigned long attackTime; // In us (the decay phase starts when the attack ends)
         } data;
+
+        // Segment helpers
+        static Rate rate(Level delta, unsigned long time);
+        static unsigned long toMicros(unsigned long time);
+        static Level advance(Level delta, Rate rate, uint32_t relativeTime);
 };
 
 #endif
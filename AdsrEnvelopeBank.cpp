@@ -0,0 +1,391 @@
+#include <AdsrEnvelopeBank.h>
+
+#define RATE_INSTANT 0xFFFFFFFF
+#define TIME_MAX 2147483U // Longest phase time (ms, half the clock range in us)
+
+// Curve data for (4 curve shapes x 33 points) of a phase progress (0 to LEVEL_MAX)
+// EXPONENTIAL is 1 - e^(-5x) and LOGARITHMIC is e^(5x) - 1 (normalised), S_CURVE is a smoothstep
+const uint16_t AdsrEnvelopeBank::curveData[4][CURVE_POINTS] = {
+    {0, 2048, 4096, 6144, 8192, 10240, 12288, 14336, 16384, 18432, 20480, 22528, 24576, 26624, 28672, 30720, 32768, 34815, 36863, 38911, 40959, 43007, 45055, 47103, 49151, 51199, 53247, 55295, 57343, 59391, 61439, 63487, 65535, }, // LINEAR
+    {0, 9544, 17708, 24691, 30663, 35772, 40142, 43879, 47076, 49811, 52149, 54150, 55861, 57325, 58577, 59648, 60564, 61347, 62017, 62590, 63081, 63500, 63859, 64165, 64428, 64652, 64844, 65009, 65149, 65269, 65372, 65460, 65535, }, // EXPONENTIAL
+    {0, 75, 163, 266, 386, 526, 691, 883, 1107, 1370, 1676, 2035, 2454, 2945, 3518, 4188, 4971, 5887, 6958, 8210, 9674, 11385, 13386, 15724, 18459, 21656, 25393, 29763, 34872, 40844, 47827, 55991, 65535, }, // LOGARITHMIC
+    {0, 188, 736, 1620, 2816, 4300, 6048, 8036, 10240, 12636, 15200, 17908, 20736, 23660, 26656, 29700, 32768, 35835, 38879, 41875, 44799, 47627, 50335, 52899, 55295, 57499, 59487, 61235, 62719, 63915, 64799, 65347, 65535, }, // S_CURVE
+};
+
+// Class constructor/initialisation
+AdsrEnvelopeBank::AdsrEnvelopeBank() {
+    size = 0;
+    states = NULL;
+    outputs = NULL;
+    releaseStarts = NULL;
+    phaseStarts = NULL;
+    startsPending = NULL;
+    groups = NULL;
+    numGroups = 0;
+    parameters = NULL;
+    setGroups(1);
+}
+
+// Class destructor
+AdsrEnvelopeBank::~AdsrEnvelopeBank() {
+    resize(0);
+    delete[] parameters;
+}
+
+// Resize the bank to hold the given number of envelopes (all envelopes become idle)
+void AdsrEnvelopeBank::resize(uint8_t size) {
+    if (size != this->size) {
+        delete[] states;
+        delete[] outputs;
+        delete[] releaseStarts;
+        delete[] phaseStarts;
+        delete[] startsPending;
+        delete[] groups;
+        states = size ? new uint8_t[size] : NULL;
+        outputs = size ? new uint16_t[size] : NULL;
+        releaseStarts = size ? new uint16_t[size] : NULL;
+        phaseStarts = size ? new unsigned long[size] : NULL;
+        startsPending = size ? new bool[size] : NULL;
+        groups = size ? new uint8_t[size] : NULL;
+        this->size = size;
+    }
+    for (size_t i=0; i<size; i++) {
+        states[i] = AdsrEnvelopeBank::IDLE;
+        outputs[i] = 0;
+        releaseStarts[i] = 0;
+        phaseStarts[i] = 0U;
+        startsPending[i] = false;
+        groups[i] = 0;
+    }
+}
+
+// Get the number of envelopes in the bank
+uint8_t AdsrEnvelopeBank::getSize(void) {
+    return size;
+}
+
+// Set the number of parameter groups (all groups get instant parameters and envelopes the first group)
+void AdsrEnvelopeBank::setGroups(uint8_t count) {
+    if (count == 0)
+        count = 1;
+    if (count != numGroups) {
+        delete[] parameters;
+        parameters = new struct AdsrEnvelopeBankParameters[count];
+        numGroups = count;
+    }
+    for (size_t i=0; i<numGroups; i++)
+        parameters[i] = {
+            .attackTime = 0U,
+            .attackRate = RATE_INSTANT,
+            .decayRate = RATE_INSTANT,
+            .sustainLevel = 0,
+            .releaseRate = RATE_INSTANT,
+            .attackCurve = curveData[LINEAR],
+            .decayCurve = curveData[LINEAR],
+            .releaseCurve = curveData[LINEAR],
+        };
+    for (size_t i=0; i<size; i++)
+        groups[i] = 0;
+}
+
+// Get the number of parameter groups
+uint8_t AdsrEnvelopeBank::getGroups(void) {
+    return numGroups;
+}
+
+// Assign an envelope to a parameter group
+void AdsrEnvelopeBank::setGroup(uint8_t index, uint8_t group) {
+    groups[index] = group < numGroups ? group : 0;
+}
+
+// Set the shared attack time (ms) of the first group
+void AdsrEnvelopeBank::setAttackTime(unsigned long attackTime) {
+    setAttackTime(0, attackTime);
+}
+
+// Set the shared decay time (ms) of the first group
+void AdsrEnvelopeBank::setDecayTime(unsigned long decayTime) {
+    setDecayTime(0, decayTime);
+}
+
+// Set the shared sustain level (0.0 to 1.0) of the first group
+void AdsrEnvelopeBank::setSustainLevel(float sustainLevel) {
+    setSustainLevel(0, sustainLevel);
+}
+
+// Set the shared release time (ms) of the first group
+void AdsrEnvelopeBank::setReleaseTime(unsigned long releaseTime) {
+    setReleaseTime(0, releaseTime);
+}
+
+// Set the shared attack time (ms) of a group
+void AdsrEnvelopeBank::setAttackTime(uint8_t group, unsigned long attackTime) {
+    if (group < numGroups) {
+        parameters[group].attackTime = toMicros(attackTime);
+        parameters[group].attackRate = rate(LEVEL_MAX, attackTime);
+    }
+}
+
+// Set the shared decay time (ms) of a group
+void AdsrEnvelopeBank::setDecayTime(uint8_t group, unsigned long decayTime) {
+    if (group < numGroups)
+        parameters[group].decayRate = rate(LEVEL_MAX, decayTime);
+}
+
+// Set the shared sustain level (0.0 to 1.0) of a group
+void AdsrEnvelopeBank::setSustainLevel(uint8_t group, float sustainLevel) {
+    if (group >= numGroups)
+        return;
+    if (sustainLevel <= 0.0f)
+        parameters[group].sustainLevel = 0;
+    else if (sustainLevel >= 1.0f)
+        parameters[group].sustainLevel = LEVEL_MAX;
+    else
+        parameters[group].sustainLevel = sustainLevel * LEVEL_MAX + 0.5f;
+}
+
+// Set the shared release time (ms) of a group
+void AdsrEnvelopeBank::setReleaseTime(uint8_t group, unsigned long releaseTime) {
+    if (group < numGroups)
+        parameters[group].releaseRate = rate(LEVEL_MAX, releaseTime);
+}
+
+// Set the shared attack curve shape of the first group
+void AdsrEnvelopeBank::setAttackCurve(Curves curve) {
+    setAttackCurve(0, curve);
+}
+
+// Set the shared decay curve shape of the first group
+void AdsrEnvelopeBank::setDecayCurve(Curves curve) {
+    setDecayCurve(0, curve);
+}
+
+// Set the shared release curve shape of the first group
+void AdsrEnvelopeBank::setReleaseCurve(Curves curve) {
+    setReleaseCurve(0, curve);
+}
+
+// Set the shared attack curve shape of a group
+void AdsrEnvelopeBank::setAttackCurve(uint8_t group, Curves curve) {
+    if (group < numGroups)
+        parameters[group].attackCurve = curveData[curve];
+}
+
+// Set the shared decay curve shape of a group
+void AdsrEnvelopeBank::setDecayCurve(uint8_t group, Curves curve) {
+    if (group < numGroups)
+        parameters[group].decayCurve = curveData[curve];
+}
+
+// Set the shared release curve shape of a group
+void AdsrEnvelopeBank::setReleaseCurve(uint8_t group, Curves curve) {
+    if (group < numGroups)
+        parameters[group].releaseCurve = curveData[curve];
+}
+
+// Start an envelope (its attack starts on the next tick)
+void AdsrEnvelopeBank::noteOn(uint8_t index) {
+    states[index] = AdsrEnvelopeBank::ATTACK;
+    outputs[index] = 0;
+    startsPending[index] = true;
+}
+
+// Start an envelope at a given time (us, e.g. the arrival time of its MIDI message)
+void AdsrEnvelopeBank::noteOn(uint8_t index, unsigned long time) {
+    noteOn(index);
+    phaseStarts[index] = time;
+    startsPending[index] = false;
+}
+
+// Trigger the release phase of an envelope (its release starts on the next tick)
+void AdsrEnvelopeBank::noteOff(uint8_t index) {
+    if (states[index] != AdsrEnvelopeBank::IDLE) {
+        states[index] = AdsrEnvelopeBank::RELEASE;
+        releaseStarts[index] = outputs[index];
+        startsPending[index] = true;
+    }
+}
+
+// Trigger the release phase of an envelope at a given time (us, releases from the level at that time)
+void AdsrEnvelopeBank::noteOff(uint8_t index, unsigned long time) {
+    if (states[index] != AdsrEnvelopeBank::IDLE) {
+        tick(index, time);
+        noteOff(index);
+        phaseStarts[index] = time;
+        startsPending[index] = false;
+    }
+}
+
+// Trigger the release phase of all envelopes
+void AdsrEnvelopeBank::allOff(void) {
+    for (size_t i=0; i<size; i++)
+        noteOff(i);
+}
+
+// Update an envelope phase and output value (ticks can be skipped, the output is computed analytically)
+// Returns true if the envelope was active and its output was updated
+bool AdsrEnvelopeBank::tick(uint8_t index, unsigned long time) {
+    // Do nothing if the envelope is idle
+    if (states[index] == AdsrEnvelopeBank::IDLE)
+        return false;
+
+    // Handle envelope relative time (times before the phase start count as the phase start)
+    if (startsPending[index]) {
+        phaseStarts[index] = time;
+        startsPending[index] = false;
+    }
+
+    // Update envelope state and output (completed phases carry over into the next one at their exact
+    // end time, so that the output is the same no matter how often or how late the envelope is ticked)
+    const struct AdsrEnvelopeBankParameters &parameters = this->parameters[groups[index]];
+    uint16_t progress, step;
+    for (bool carry=true; carry; ) {
+        carry = false;
+        int32_t relativeTime = (int32_t)(time - phaseStarts[index]);
+        if (relativeTime < 0)
+            relativeTime = 0;
+        switch (states[index]) {
+            case AdsrEnvelopeBank::ATTACK: // Attack phase
+                progress = advance(LEVEL_MAX, parameters.attackRate, relativeTime);
+                outputs[index] = shape(parameters.attackCurve, progress);
+                if (progress == LEVEL_MAX) { // Change to decay phase?
+                    states[index] = AdsrEnvelopeBank::DECAY;
+                    phaseStarts[index] += parameters.attackTime;
+                    carry = true;
+                }
+                break;
+            case AdsrEnvelopeBank::DECAY: // Decay phase
+                progress = advance(LEVEL_MAX, parameters.decayRate, relativeTime);
+                step = shape(parameters.decayCurve, progress);
+                outputs[index] = LEVEL_MAX - (((uint32_t)(LEVEL_MAX - parameters.sustainLevel) * step + 0x8000) >> 16);
+                if (progress == LEVEL_MAX) { // Change to sustain phase?
+                    states[index] = AdsrEnvelopeBank::SUSTAIN;
+                    carry = true;
+                }
+                break;
+            case AdsrEnvelopeBank::SUSTAIN: // Sustain phase
+                outputs[index] = parameters.sustainLevel;
+                if (outputs[index] == 0) // Skip to idle phase?
+                    states[index] = AdsrEnvelopeBank::IDLE;
+                break;
+            case AdsrEnvelopeBank::RELEASE: // Release phase (scaled from the release start level)
+                progress = advance(LEVEL_MAX, parameters.releaseRate, relativeTime);
+                step = shape(parameters.releaseCurve, progress);
+                outputs[index] = releaseStarts[index] - (((uint32_t)releaseStarts[index] * step + 0x8000) >> 16);
+                if (progress == LEVEL_MAX) { // Change to idle phase?
+                    states[index] = AdsrEnvelopeBank::IDLE;
+                    outputs[index] = 0;
+                }
+                break;
+        }
+    }
+    return true;
+}
+
+// Get the time at which an envelope output leaves a range of levels (or ends its phase if sooner)
+// The range must contain the current output, e.g. all levels shown at the same brightness
+// Returns false if the output will not change until the next Note On/Off (idle or sustaining)
+bool AdsrEnvelopeBank::getNextChange(uint8_t index, uint16_t low, uint16_t high, unsigned long &time) {
+    const struct AdsrEnvelopeBankParameters &parameters = this->parameters[groups[index]];
+    uint16_t progress, span;
+    uint32_t rate;
+    switch (states[index]) {
+        case AdsrEnvelopeBank::ATTACK: // Rising to the level above the range
+            rate = parameters.attackRate;
+            progress = high == LEVEL_MAX ? LEVEL_MAX : unshape(parameters.attackCurve, high + 1);
+            break;
+        case AdsrEnvelopeBank::DECAY: // Falling to the level below the range (down to the sustain level)
+            rate = parameters.decayRate;
+            span = LEVEL_MAX - parameters.sustainLevel;
+            progress = low <= parameters.sustainLevel ? LEVEL_MAX : unshape(parameters.decayCurve, unscale(span, LEVEL_MAX - low + 1));
+            break;
+        case AdsrEnvelopeBank::RELEASE: // Falling to the level below the range (down to zero)
+            rate = parameters.releaseRate;
+            span = releaseStarts[index];
+            progress = low == 0 ? LEVEL_MAX : unshape(parameters.releaseCurve, unscale(span, span - low + 1));
+            break;
+        default:
+            return false;
+    }
+    time = phaseStarts[index];
+    if (rate != RATE_INSTANT)
+        time += (((uint64_t)progress << 24) + rate - 1) / rate;
+    return true;
+}
+
+// Get an envelope output level (0 to LEVEL_MAX)
+uint16_t AdsrEnvelopeBank::getLevel(uint8_t index) {
+    return outputs[index];
+}
+
+// Scale an 8-bit value by an envelope output
+uint8_t AdsrEnvelopeBank::scale(uint8_t index, uint8_t value) {
+    return ((uint32_t)outputs[index] * value + 0x8000) >> 16;
+}
+
+// Test if an envelope is in idle state
+bool AdsrEnvelopeBank::isIdle(uint8_t index) {
+    return states[index] == AdsrEnvelopeBank::IDLE;
+}
+
+// Test if an envelope is in its release phase
+bool AdsrEnvelopeBank::isReleased(uint8_t index) {
+    return states[index] == AdsrEnvelopeBank::RELEASE;
+}
+
+// Compute the rate needed to cover a level delta in the given time (ms, rounded up so phases end on time)
+uint32_t AdsrEnvelopeBank::rate(uint16_t delta, unsigned long time) {
+    if (time == 0U)
+        return RATE_INSTANT;
+    unsigned long micros = toMicros(time);
+    return (((uint64_t)delta << 24) + micros - 1) / micros;
+}
+
+// Convert a phase time from ms to us (clamped to TIME_MAX, so that it does not overflow 32 bits)
+unsigned long AdsrEnvelopeBank::toMicros(unsigned long time) {
+    return (time < TIME_MAX ? time : TIME_MAX) * 1000U;
+}
+
+// Compute how much a segment advanced at a given rate and relative time (clamped to delta)
+uint16_t AdsrEnvelopeBank::advance(uint16_t delta, uint32_t rate, uint32_t relativeTime) {
+    if (rate == RATE_INSTANT)
+        return delta;
+    uint64_t step = ((uint64_t)relativeTime * rate) >> 24;
+    return step < delta ? step : delta;
+}
+
+// Find the lowest phase progress (0 to LEVEL_MAX) at which a curve reaches a level (inverse of shape())
+uint16_t AdsrEnvelopeBank::unshape(const uint16_t *curve, uint16_t level) {
+    if (level == 0)
+        return 0;
+    if (level == LEVEL_MAX)
+        return LEVEL_MAX;
+    uint8_t low = 1, high = CURVE_POINTS - 1; // Find the first curve point at or above the level
+    while (low < high) {
+        uint8_t middle = (low + high) / 2;
+        if (curve[middle] >= level)
+            high = middle;
+        else
+            low = middle + 1;
+    }
+    uint32_t span = curve[low] - curve[low - 1];
+    uint32_t progress = ((uint32_t)(low - 1) << 11) + (((uint32_t)(level - curve[low - 1]) << 11) + span - 1) / span;
+    return progress < LEVEL_MAX ? progress : LEVEL_MAX;
+}
+
+// Find the lowest curve level at which a span scaled by it (rounded) reaches a step (inverse of the phase scaling)
+uint16_t AdsrEnvelopeBank::unscale(uint16_t span, uint16_t step) {
+    if (step == 0)
+        return 0;
+    uint32_t level = (((uint32_t)step << 16) - 0x8000 + span - 1) / span;
+    return level < LEVEL_MAX ? level : LEVEL_MAX;
+}
+
+// Look up a phase progress (0 to LEVEL_MAX) in a curve, interpolating between curve points
+uint16_t AdsrEnvelopeBank::shape(const uint16_t *curve, uint16_t progress) {
+    if (progress == LEVEL_MAX)
+        return LEVEL_MAX;
+    uint8_t point = progress >> 11; // 32 segments of 2048 progress units
+    uint16_t fraction = progress & 0x7FF;
+    return curve[point] + ((((int32_t)curve[point + 1] - curve[point]) * fraction) >> 11);
+}
@@ -0,0 +1,123 @@
+#ifndef ADSR_ENVELOPE_BANK_H
+#define ADSR_ENVELOPE_BANK_H
+/**
+ * ADSR envelope bank class - Handles a bank of ADSR envelopes sharing the same parameters.
+ *
+ * Envelope state is kept in separate compact arrays (structure-of-arrays) sized to the number
+ * of envelopes actually needed, and parameters are shared by all envelopes in the bank.
+ * Parameter changes therefore also apply to envelopes that are already running.
+ * Envelopes can also be split into groups with their own shared parameters (e.g. one per MIDI
+ * channel), in which case each envelope uses the parameters of the group it was assigned to.
+ * Levels are fixed-point Q16 values (0 to LEVEL_MAX).
+ *
+ * Times are microsecond timestamps (e.g. micros()) while phase times are set in ms. Each envelope keeps
+ * the explicit start time of its current phase, and times are compared as signed 32-bit differences,
+ * so any timestamp (including 0) is valid and the clock can wrap around (phases must be shorter than
+ * half the clock range, so longer phase times are clamped to 2147483 ms, about 35 minutes).
+ *
+ * Each phase can follow a different curve shape, looked up in a constant 33-point table and
+ * linearly interpolated (so every shape costs the same to tick):
+ *   LINEAR: constant speed
+ *   EXPONENTIAL: fast at first, then slowing down (e.g. a natural piano decay)
+ *   LOGARITHMIC: slow at first, then speeding up
+ *   S_CURVE: slow at both ends (smoothstep)
+ *
+ * Hugo Hromic - http://github.com/hhromic
+ * MIT license
+ */
+
+#include <cinttypes>
+#include <MidiLedsCompat.h>
+
+class AdsrEnvelopeBank {
+    public:
+        // Maximum envelope level
+        static const uint16_t LEVEL_MAX = 0xFFFF;
+
+        // Available curve shapes
+        enum Curves { LINEAR, EXPONENTIAL, LOGARITHMIC, S_CURVE };
+
+        // Class constructor/destructor
+        AdsrEnvelopeBank();
+        ~AdsrEnvelopeBank();
+
+        // Configuration
+        void resize(uint8_t size);
+        uint8_t getSize(void);
+        void setGroups(uint8_t count);
+        uint8_t getGroups(void);
+        void setGroup(uint8_t index, uint8_t group);
+
+        // Shared parameter setters (for the first group or a given group)
+        void setAttackTime(unsigned long attackTime);
+        void setDecayTime(unsigned long decayTime);
+        void setSustainLevel(float sustainLevel);
+        void setReleaseTime(unsigned long releaseTime);
+        void setAttackTime(uint8_t group, unsigned long attackTime);
+        void setDecayTime(uint8_t group, unsigned long decayTime);
+        void setSustainLevel(uint8_t group, float sustainLevel);
+        void setReleaseTime(uint8_t group, unsigned long releaseTime);
+        void setAttackCurve(Curves curve);
+        void setDecayCurve(Curves curve);
+        void setReleaseCurve(Curves curve);
+        void setAttackCurve(uint8_t group, Curves curve);
+        void setDecayCurve(uint8_t group, Curves curve);
+        void setReleaseCurve(uint8_t group, Curves curve);
+
+        // Public methods
+        void noteOn(uint8_t index);
+        void noteOn(uint8_t index, unsigned long time);
+        void noteOff(uint8_t index);
+        void noteOff(uint8_t index, unsigned long time);
+        void allOff(void);
+        bool tick(uint8_t index, unsigned long time);
+        uint16_t getLevel(uint8_t index);
+        uint8_t scale(uint8_t index, uint8_t value);
+        bool isIdle(uint8_t index);
+        bool isReleased(uint8_t index);
+        bool getNextChange(uint8_t index, uint16_t low, uint16_t high, unsigned long &time);
+
+    private:
+        // Possible envelope states
+        enum States { IDLE, ATTACK, DECAY, SUSTAIN, RELEASE };
+
+        // Envelope data (one entry per envelope)
+        uint8_t size;
+        uint8_t *states;
+        uint16_t *outputs;
+        uint16_t *releaseStarts;
+        unsigned long *phaseStarts;
+        bool *startsPending; // Phase starts on the next tick (started without a time)
+        uint8_t *groups;
+
+        // Shared parameters per group (rates are Q8.24 phase progress units per microsecond)
+        uint8_t numGroups;
+        struct AdsrEnvelopeBankParameters {
+            unsigned long attackTime;
+            uint32_t attackRate;
+            uint32_t decayRate;
+            uint16_t sustainLevel;
+            uint32_t releaseRate;
+            const uint16_t *attackCurve;
+            const uint16_t *decayCurve;
+            const uint16_t *releaseCurve;
+        } *parameters;
+
+        // Curve data (CURVE_POINTS points per curve shape)
+        static const size_t CURVE_POINTS = 33;
+        static const uint16_t curveData[4][CURVE_POINTS];
+
+        // Segment helpers
+        static uint32_t rate(uint16_t delta, unsigned long time);
+        static unsigned long toMicros(unsigned long time);
+        static uint16_t advance(uint16_t delta, uint32_t rate, uint32_t relativeTime);
+        static uint16_t shape(const uint16_t *curve, uint16_t progress);
+        static uint16_t unshape(const uint16_t *curve, uint16_t level);
+        static uint16_t unscale(uint16_t span, uint16_t step);
+
+        // Non-copyable (owns its envelope data)
+        AdsrEnvelopeBank(const AdsrEnvelopeBank &);
+        AdsrEnvelopeBank &operator=(const AdsrEnvelopeBank &);
+};
+
+#endif
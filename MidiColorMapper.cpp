@@ -3,10 +3,19 @@
 
 // Class constructor/initialisation
 MidiColorMapper::MidiColorMapper() {
-    for (uint8_t i=16; i--;)
+    staleCaches = 0x0000;
+    for (uint8_t i=16; i--;) {
+        colorCache[i] = NULL;
         reset(i);
+    }
 };
 
+// Class destructor
+MidiColorMapper::~MidiColorMapper() {
+    for (size_t i=0; i<16; i++)
+        delete[] colorCache[i];
+}
+
 // Get the minimum note value for a MIDI channel
 uint8_t MidiColorMapper::getNoteMin(uint8_t channel) {
     return parameters[channel & 0xF].noteMin;
@@ -15,6 +24,7 @@ uint8_t MidiColorMapper::getNoteMin(uint8_t channel) {
 // Set the minimum note value for a MIDI channel
 void MidiColorMapper::setNoteMin(uint8_t channel, uint8_t noteMin) {
     parameters[channel & 0xF].noteMin = noteMin & 0x7F;
+    updateCache(channel);
 }
 
 // Get the maximum note value for a MIDI channel
@@ -25,6 +35,7 @@ uint8_t MidiColorMapper::getNoteMax(uint8_t channel) {
 // Set the maximum note value for a MIDI channel
 void MidiColorMapper::setNoteMax(uint8_t channel, uint8_t noteMax) {
     parameters[channel & 0xF].noteMax = noteMax & 0x7F;
+    updateCache(channel);
 }
 
 // Get the active color mapper for a MIDI channel
@@ -35,6 +46,7 @@ MidiColorMapper::Mappers MidiColorMapper::getMapper(uint8_t channel) {
 // Set the active color mapper to use for a MIDI channel
 void MidiColorMapper::setMapper(uint8_t channel, Mappers mapper) {
     parameters[channel & 0xF].mapper = mapper;
+    updateCache(channel);
 }
 
 // Get the active note color map for a MIDI channel
@@ -45,6 +57,7 @@ MidiNoteColors::Maps MidiColorMapper::getNoteColorMap(uint8_t channel) {
 // Set the active note color map to use for a MIDI channel
 void MidiColorMapper::setNoteColorMap(uint8_t channel, MidiNoteColors::Maps noteColorMap) {
     parameters[channel & 0xF].noteColorMap = noteColorMap;
+    updateCache(channel);
 }
 
 // Get the active fixed color hue for a MIDI channel
@@ -55,6 +68,7 @@ uint8_t MidiColorMapper::getFixedHue(uint8_t channel) {
 // Set the active fixed color hue to use for a MIDI channel
 void MidiColorMapper::setFixedHue(uint8_t channel, uint8_t fixedHue) {
     parameters[channel & 0xF].fixedHue = fixedHue;
+    updateCache(channel);
 }
 
 // Get the active velocity ignoring state for a MIDI channel
@@ -67,32 +81,72 @@ void MidiColorMapper::setIgnoreVelocity(uint8_t channel, bool state) {
     parameters[channel & 0xF].ignoreVelocity = state;
 }
 
+// Get the custom color mapper for a MIDI channel
+MidiColorMapper::CustomMapper MidiColorMapper::getCustomMapper(uint8_t channel) {
+    return parameters[channel & 0xF].customMapper;
+}
+
+// Set the custom color mapper to use for a MIDI channel (used by the CUSTOM mapper)
+void MidiColorMapper::setCustomMapper(uint8_t channel, CustomMapper customMapper) {
+    parameters[channel & 0xF].customMapper = customMapper;
+    updateCache(channel);
+}
+
 // Map a MIDI note message to an HSV color
 struct CHSV MidiColorMapper::map(uint8_t channel, uint8_t note, uint8_t velocity) {
-    struct MidiColorMapperParameters *p = &parameters[channel & 0xF];
-    struct CHSV noteColor = CHSV(0,0,0);
-    if (note >= p->noteMin && note <= p->noteMax) {
-        uint8_t _velocity = p->ignoreVelocity ? 0x7F : velocity & 0x7F;
-        switch (p->mapper) {
-            case COLOR_MAP: // Use Midi Note Color maps
-                noteColor = MidiNoteColors::get(p->noteColorMap, note);
-                noteColor.v = round((_velocity * 1.0f / 0x7F) * noteColor.v);
-                break;
-            case RAINBOW: // Generate rainbow-like colors
-                noteColor = CHSV(
-                    round((note - p->noteMin) * (0xFF / (p->noteMax - p->noteMin + 1.0f))),
-                    0xFF, round((_velocity * 1.0f / 0x7F) * 0xFF)
-                );
-                break;
-            case FIXED_COLOR: // Fixed color mapping
-                noteColor = CHSV(p->fixedHue, 0xFF, round((_velocity * 1.0f / 0x7F) * 0xFF));
-                break;
-        }
-    }
+    if (colorCache[channel & 0xF] == NULL || bitRead(staleCaches, channel & 0xF))
+        buildCache(channel);
+    struct CHSV noteColor = colorCache[channel & 0xF][note & 0x7F];
+    uint8_t _velocity = parameters[channel & 0xF].ignoreVelocity ? 0x7F : velocity & 0x7F;
+    uint8_t scale = (_velocity << 1) | (_velocity >> 6); // 0x00-0x7F to 0x00-0xFF
+    noteColor.v = ((uint16_t)noteColor.v * (scale + 1)) >> 8;
     return noteColor;
 }
 
+// Rebuild the note colors of a MIDI channel (e.g. after a custom mapper or note color map changed)
+void MidiColorMapper::refresh(uint8_t channel) {
+    if (colorCache[channel & 0xF] != NULL)
+        buildCache(channel);
+}
+
 // Reset parameters values to defaults for a MIDI channel
 void MidiColorMapper::reset(uint8_t channel) {
     parameters[channel & 0xF] = DEFAULTS;
+    updateCache(channel);
+}
+
+// Build the full-velocity note colors cache for a MIDI channel
+void MidiColorMapper::buildCache(uint8_t channel) {
+    struct MidiColorMapperParameters *p = &parameters[channel & 0xF];
+    if (colorCache[channel & 0xF] == NULL)
+        colorCache[channel & 0xF] = new CHSV[128];
+    struct CHSV *noteColors = colorCache[channel & 0xF];
+    bitClear(staleCaches, channel & 0xF);
+    for (size_t note=0; note<128; note++) {
+        if (note >= p->noteMin && note <= p->noteMax) {
+            switch (p->mapper) {
+                case COLOR_MAP: // Use Midi Note Color maps
+                    noteColors[note] = MidiNoteColors::get(p->noteColorMap, note);
+                    break;
+                case RAINBOW: // Generate rainbow-like colors
+                    noteColors[note] = CHSV(round((note - p->noteMin) * (0xFF / (p->noteMax - p->noteMin + 1.0f))), 0xFF, 0xFF);
+                    break;
+                case FIXED_COLOR: // Fixed color mapping
+                    noteColors[note] = CHSV(p->fixedHue, 0xFF, 0xFF);
+                    break;
+                case CUSTOM: // User-defined mapping (filled below)
+                    noteColors[note] = CHSV(0,0,0);
+                    break;
+            }
+        }
+        else
+            noteColors[note] = CHSV(0,0,0);
+    }
+    if (p->mapper == CUSTOM && p->customMapper != NULL && p->noteMin <= p->noteMax)
+        p->customMapper(noteColors, p->noteMin, p->noteMax);
+}
+
+// Flag the note colors cache of a MIDI channel for rebuilding on the next map (batches several setters)
+void MidiColorMapper::updateCache(uint8_t channel) {
+    bitSet(staleCaches, channel & 0xF);
 }
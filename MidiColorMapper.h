@@ -2,12 +2,22 @@
 #define MIDI_COLOR_MAPPER_H
 /**
  * Midi Color Mapper class - Handles mapping of MIDI notes to colors.
+ * Full-velocity note colors are cached per MIDI channel (128 entries, allocated on first use),
+ * so mapping a note is a table read and a scale. Setters only flag the cache of their channel, which
+ * is rebuilt once on the next map(), so changing several parameters at once costs a single rebuild.
+ *
+ * Besides the built-in mappers, the CUSTOM mapper fills the note colors with a user-defined
+ * function (e.g. per-octave gradients). A mapper class with a static color(note, noteMin, noteMax)
+ * method is turned into such a function at compile time with customMapper<Class>, so its code is
+ * inlined into the cache building loop. As mappers only run when the cache is built, custom
+ * mappers cost nothing per Note On. Mappers with their own state (e.g. chord-aware hues) can call
+ * refresh() to rebuild the cache when it changes.
  *
  * Hugo Hromic - http://github.com/hhromic
  * MIT license
  */
 
-#include <Arduino.h>
+#include <MidiLedsCompat.h>
 #include <cinttypes>
 #include <MidiNoteColors.h>
 #include <pixeltypes.h>
@@ -15,10 +25,14 @@
 class MidiColorMapper {
     public:
         // Available color mappers
-        enum Mappers { COLOR_MAP, RAINBOW, FIXED_COLOR };
+        enum Mappers { COLOR_MAP, RAINBOW, FIXED_COLOR, CUSTOM };
+
+        // User-defined mapper (fills the full-velocity colors of the notes from noteMin to noteMax)
+        typedef void (*CustomMapper)(struct CHSV *noteColors, uint8_t noteMin, uint8_t noteMax);
 
-        // Class constructor
+        // Class constructor/destructor
         MidiColorMapper();
+        ~MidiColorMapper();
 
         // Getter/setters
         uint8_t getNoteMin(uint8_t channel);
@@ -33,11 +47,20 @@ class MidiColorMapper {
         void setFixedHue(uint8_t channel, uint8_t fixedHue);
         bool isIgnoreVelocity(uint8_t channel);
         void setIgnoreVelocity(uint8_t channel, bool state);
+        CustomMapper getCustomMapper(uint8_t channel);
+        void setCustomMapper(uint8_t channel, CustomMapper customMapper);
 
         // Public methods
         struct CHSV map(uint8_t channel, uint8_t note, uint8_t velocity);
+        void refresh(uint8_t channel);
         void reset(uint8_t channel);
 
+        // Custom mapper of a class with a static "struct CHSV color(uint8_t note, uint8_t noteMin, uint8_t noteMax)"
+        template <class Mapper> static void customMapper(struct CHSV *noteColors, uint8_t noteMin, uint8_t noteMax) {
+            for (uint16_t note=noteMin; note<=noteMax; note++)
+                noteColors[note] = Mapper::color(note, noteMin, noteMax);
+        }
+
     private:
         // Parameters per MIDI channel
         struct MidiColorMapperParameters {
@@ -47,8 +70,15 @@ class MidiColorMapper {
             MidiNoteColors::Maps noteColorMap;
             uint8_t fixedHue;
             bool ignoreVelocity;
+            CustomMapper customMapper;
         } parameters[16];
 
+        // Full-velocity note colors per MIDI channel
+        struct CHSV *colorCache[16];
+        uint16_t staleCaches; // Channels whose cache must be rebuilt before mapping
+        void buildCache(uint8_t channel);
+        void updateCache(uint8_t channel);
+
         // Default parameters settings
         const struct MidiColorMapperParameters DEFAULTS = {
             .noteMin = 0x00,
@@ -57,7 +87,12 @@ class MidiColorMapper {
             .noteColorMap = MidiNoteColors::NEWTON_1704,
             .fixedHue = 0x00,
             .ignoreVelocity = true,
+            .customMapper = NULL,
         };
+
+        // Non-copyable (owns its color caches)
+        MidiColorMapper(const MidiColorMapper &);
+        MidiColorMapper &operator=(const MidiColorMapper &);
 };
 
 #endif
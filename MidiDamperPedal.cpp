@@ -6,8 +6,6 @@ MidiDamperPedal::MidiDamperPedal() {
     for (size_t i=0; i<16; i++)
         for (size_t j=0; j<4; j++)
             heldNotes[i][j] = 0x00000000;
-    handleNoteOn = NULL;
-    handleNoteOff = NULL;
 }
 
 // Emulate the pedal being pressed
@@ -17,36 +15,45 @@ void MidiDamperPedal::press(uint8_t channel) {
 
 // Emulate the pedal being released
 void MidiDamperPedal::release(uint8_t channel) {
-    bitClear(pressed, channel & 0xF);
-    for (size_t i=0; i<128; i++) { // Send Note Off messages for all channel held notes
-        if (bitRead(heldNotes[channel & 0xF][i / 32], i % 32)) {
-            bitClear(heldNotes[channel & 0xF][i / 32], i % 32);
-            handleNoteOff(channel, i, 0x00);
-        }
-    }
+    release(channel, handlers);
 }
 
 // Process a MIDI Note On message
 void MidiDamperPedal::noteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
-    if (bitRead(heldNotes[channel & 0xF][(note & 0x7F) / 32], (note & 0x7F) % 32))
-        bitClear(heldNotes[channel & 0xF][(note & 0x7F) / 32], (note & 0x7F) % 32); // Reset channel held note
-    handleNoteOn(channel, note, velocity);
+    noteOn(channel, note, velocity, handlers);
 }
 
 // Process a MIDI Note Off message
 void MidiDamperPedal::noteOff(uint8_t channel, uint8_t note, uint8_t velocity) {
-    if (bitRead(pressed, channel & 0xF)) // If pedal pressed, hold channel Note Off message
-        bitSet(heldNotes[channel & 0xF][(note & 0x7F) / 32], (note & 0x7F) % 32);
-    else
-        handleNoteOff(channel, note, velocity);
+    noteOff(channel, note, velocity, handlers);
+}
+
+// Process a batch of MIDI Note Off messages (128-bit notes mask, uint32_t[4])
+void MidiDamperPedal::notesOff(uint8_t channel, const uint32_t *notes) {
+    notesOff(channel, notes, handlers);
+}
+
+// Get the number of notes held by the pedal (all MIDI channels)
+uint16_t MidiDamperPedal::getHeldNotes(void) {
+    uint16_t count = 0;
+    for (size_t i=0; i<16; i++)
+        for (size_t j=0; j<4; j++)
+            count += __builtin_popcount(heldNotes[i][j]);
+    return count;
 }
 
 // Set a handler for processed Note On messages
 void MidiDamperPedal::setHandleNoteOn(void (*fptr)(uint8_t channel, uint8_t note, uint8_t velocity)) {
-    handleNoteOn = fptr;
+    handlers.handleNoteOn = fptr;
 }
 
 // Set a handler for processed Note Off messages
 void MidiDamperPedal::setHandleNoteOff(void (*fptr)(uint8_t channel, uint8_t note, uint8_t velocity)) {
-    handleNoteOff = fptr;
+    handlers.handleNoteOff = fptr;
+}
+
+// Set a handler for batches of processed Note Off messages (128-bit notes mask, uint32_t[4])
+// If set, it is used instead of the Note Off handler when releasing the pedal
+void MidiDamperPedal::setHandleNotesOff(void (*fptr)(uint8_t channel, const uint32_t *notes)) {
+    handlers.handleNotesOff = fptr;
 }
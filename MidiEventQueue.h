@@ -0,0 +1,77 @@
+#ifndef MIDI_EVENT_QUEUE_H
+#define MIDI_EVENT_QUEUE_H
+/**
+ * MIDI Event Queue class - Lock-free single-producer/single-consumer queue of timestamped MIDI events.
+ * The producer (e.g. a MIDI input callback or ISR) stamps events at arrival and pushes them, the
+ * consumer (e.g. the main loop) pops them and applies them at their original timestamp.
+ * The queue size must be a power of two.
+ * Only plain atomic loads and stores are used (each counter has a single writer), so the queue stays
+ * lock-free on cores without atomic read-modify-write instructions (e.g. Cortex-M0).
+ *
+ * Hugo Hromic - http://github.com/hhromic
+ * MIT license
+ */
+
+#include <atomic>
+#include <cinttypes>
+#include <cstddef>
+
+// Timestamped MIDI event
+struct MidiEvent {
+    // Supported event types
+    enum Types { NOTE_ON, NOTE_OFF, CONTROL_CHANGE };
+
+    unsigned long time;
+    uint8_t type;
+    uint8_t channel;
+    uint8_t data1;
+    uint8_t data2;
+};
+
+template <size_t SIZE>
+class MidiEventQueue {
+    static_assert(SIZE > 0 && (SIZE & (SIZE - 1)) == 0, "MidiEventQueue SIZE must be a power of two");
+
+    public:
+        // Class constructor
+        MidiEventQueue() : head(0), tail(0), dropped(0) {}
+
+        // Producer side (returns false and counts the event as dropped if the queue is full)
+        bool push(const struct MidiEvent &event) {
+            size_t _head = head.load(std::memory_order_relaxed);
+            if (_head - tail.load(std::memory_order_acquire) == SIZE) {
+                dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); // Producer only
+                return false;
+            }
+            events[_head & (SIZE - 1)] = event;
+            head.store(_head + 1, std::memory_order_release);
+            return true;
+        }
+        bool push(unsigned long time, uint8_t type, uint8_t channel, uint8_t data1, uint8_t data2) {
+            struct MidiEvent event = { .time = time, .type = type, .channel = channel, .data1 = data1, .data2 = data2 };
+            return push(event);
+        }
+
+        // Consumer side (returns false if the queue is empty)
+        bool pop(struct MidiEvent &event) {
+            size_t _tail = tail.load(std::memory_order_relaxed);
+            if (_tail == head.load(std::memory_order_acquire))
+                return false;
+            event = events[_tail & (SIZE - 1)];
+            tail.store(_tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Queue state
+        bool isEmpty(void) { return tail.load(std::memory_order_acquire) == head.load(std::memory_order_acquire); }
+        size_t getCount(void) { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire); }
+        unsigned long getDropped(void) { return dropped.load(std::memory_order_relaxed); }
+
+    private:
+        struct MidiEvent events[SIZE];
+        std::atomic<size_t> head;
+        std::atomic<size_t> tail;
+        std::atomic<unsigned long> dropped;
+};
+
+#endif
@@ -0,0 +1,270 @@
+#include <MidiFileReader.h>
+
+// Class constructor
+MidiFileReader::MidiFileReader() {
+    format = 0;
+    numTracks = 0;
+    division = 96;
+    tempo = 500000U;
+    tempoTick = 0U;
+    tempoTime = 0U;
+    currentTick = 0U;
+    handleRead = NULL;
+    handleNoteOn = NULL;
+    handleNoteOff = NULL;
+    handleControlChange = NULL;
+}
+
+// Read the file header and prepare all tracks for streaming
+// Returns false if not a valid file or if it has more tracks than MIDI_FILE_MAX_TRACKS
+bool MidiFileReader::begin(void) {
+    numTracks = 0;
+    if (handleRead == NULL || readBytes(0, 4) != 0x4D546864) // "MThd"
+        return false;
+    uint32_t headerLength = readBytes(4, 4);
+    format = readBytes(8, 2);
+    uint16_t chunks = readBytes(10, 2);
+    division = readBytes(12, 2);
+    if (headerLength < 6 || format > 1 || division == 0)
+        return false;
+
+    // Locate track chunks (unknown chunks are skipped)
+    uint32_t offset = 8 + headerLength;
+    for (size_t i=0; i<chunks; i++) {
+        uint32_t type = readBytes(offset, 4);
+        uint32_t length = readBytes(offset + 4, 4);
+        if (type == 0x4D54726B) { // "MTrk"
+            if (numTracks == MIDI_FILE_MAX_TRACKS) { // Would replay with missing notes
+                numTracks = 0;
+                return false;
+            }
+            struct Track *track = &tracks[numTracks++];
+            track->offset = offset + 8;
+            track->end = offset + 8 + length;
+            track->bufferPos = 0;
+            track->bufferLen = 0;
+            track->runningStatus = 0x00;
+            track->finished = false;
+            track->nextTick = 0U;
+            readDelta(track);
+        }
+        offset += 8 + length;
+    }
+
+    // Reset tempo state (120 bpm until a tempo event is found)
+    tempo = 500000U;
+    tempoTick = 0U;
+    tempoTime = 0U;
+    currentTick = 0U;
+    return numTracks > 0;
+}
+
+// Dispatch all events up to the given time (ms), returns false when all tracks are finished
+bool MidiFileReader::playUntil(unsigned long time) {
+    struct Track *track;
+    while ((track = nextTrack()) != NULL) {
+        if (tickToTime(track->nextTick) > (uint64_t)time * 1000U)
+            return true;
+        currentTick = track->nextTick;
+        processEvent(track);
+        readDelta(track);
+    }
+    return false;
+}
+
+// Get the time (ms) of the next event to be dispatched
+unsigned long MidiFileReader::getNextEventTime(void) {
+    struct Track *track = nextTrack();
+    return track != NULL ? tickToTime(track->nextTick) / 1000U : 0U;
+}
+
+// Get the time (ms) of the event being dispatched (or last dispatched)
+unsigned long MidiFileReader::getEventTime(void) {
+    return tickToTime(currentTick) / 1000U;
+}
+
+// Test if all tracks are finished
+bool MidiFileReader::isFinished(void) {
+    return nextTrack() == NULL;
+}
+
+// Get the file format (0 or 1)
+uint16_t MidiFileReader::getFormat(void) {
+    return format;
+}
+
+// Get the number of tracks being streamed
+uint16_t MidiFileReader::getNumTracks(void) {
+    return numTracks;
+}
+
+// Set a handler for reading file data at a given offset (returns the number of bytes read)
+void MidiFileReader::setHandleRead(size_t (*fptr)(uint32_t offset, uint8_t *buffer, size_t length)) {
+    handleRead = fptr;
+}
+
+// Set a handler for replayed Note On messages
+void MidiFileReader::setHandleNoteOn(void (*fptr)(uint8_t channel, uint8_t note, uint8_t velocity)) {
+    handleNoteOn = fptr;
+}
+
+// Set a handler for replayed Note Off messages
+void MidiFileReader::setHandleNoteOff(void (*fptr)(uint8_t channel, uint8_t note, uint8_t velocity)) {
+    handleNoteOff = fptr;
+}
+
+// Set a handler for replayed Control Change messages
+void MidiFileReader::setHandleControlChange(void (*fptr)(uint8_t channel, uint8_t control, uint8_t value)) {
+    handleControlChange = fptr;
+}
+
+// Read a big-endian value of up to 4 bytes directly from the file
+uint32_t MidiFileReader::readBytes(uint32_t offset, uint8_t length) {
+    uint8_t buffer[4] = {0x00, 0x00, 0x00, 0x00};
+    uint32_t value = 0U;
+    if (handleRead(offset, buffer, length) != length)
+        return 0U;
+    for (size_t i=0; i<length; i++)
+        value = (value << 8) | buffer[i];
+    return value;
+}
+
+// Read the next byte of a track (refilling its buffer as needed)
+uint8_t MidiFileReader::readByte(struct Track *track) {
+    if (track->bufferPos == track->bufferLen) {
+        uint32_t length = track->end - track->offset;
+        if (length > MIDI_FILE_BUFFER_SIZE)
+            length = MIDI_FILE_BUFFER_SIZE;
+        track->bufferPos = 0;
+        track->bufferLen = track->offset < track->end ? handleRead(track->offset, track->buffer, length) : 0;
+        track->offset += track->bufferLen;
+        if (track->bufferLen == 0) { // End of track data?
+            track->finished = true;
+            return 0x00;
+        }
+    }
+    return track->buffer[track->bufferPos++];
+}
+
+// Read a variable-length quantity from a track
+uint32_t MidiFileReader::readVarLen(struct Track *track) {
+    uint32_t value = 0U;
+    for (size_t i=0; i<4; i++) {
+        uint8_t data = readByte(track);
+        value = (value << 7) | (data & 0x7F);
+        if (!(data & 0x80))
+            break;
+    }
+    return value;
+}
+
+// Skip bytes of a track
+void MidiFileReader::skip(struct Track *track, uint32_t length) {
+    uint8_t buffered = track->bufferLen - track->bufferPos;
+    if (length <= buffered) {
+        track->bufferPos += length;
+        return;
+    }
+    track->bufferPos = track->bufferLen;
+    track->offset += length - buffered;
+    if (track->offset > track->end)
+        track->offset = track->end;
+}
+
+// Read the delta time of the next event of a track
+void MidiFileReader::readDelta(struct Track *track) {
+    if (!track->finished) {
+        uint32_t delta = readVarLen(track);
+        track->nextTick += delta;
+    }
+}
+
+// Process the next event of a track
+void MidiFileReader::processEvent(struct Track *track) {
+    uint8_t status = readByte(track);
+    uint8_t data1, data2;
+    if (track->finished)
+        return;
+
+    // System exclusive and meta events
+    if (status == 0xF0 || status == 0xF7) {
+        track->runningStatus = 0x00;
+        skip(track, readVarLen(track));
+        return;
+    }
+    if (status == 0xFF) {
+        track->runningStatus = 0x00;
+        uint8_t type = readByte(track);
+        uint32_t length = readVarLen(track);
+        if (type == 0x51 && length == 3) { // Set tempo
+            uint32_t value = readByte(track);
+            value = (value << 8) | readByte(track);
+            value = (value << 8) | readByte(track);
+            tempoTime = tickToTime(currentTick);
+            tempoTick = currentTick;
+            tempo = value;
+        }
+        else if (type == 0x2F) // End of track
+            track->finished = true;
+        else
+            skip(track, length);
+        return;
+    }
+
+    // Channel messages (with running status)
+    if (status & 0x80) {
+        track->runningStatus = status;
+        data1 = readByte(track);
+    }
+    else if (track->runningStatus) {
+        data1 = status;
+        status = track->runningStatus;
+    }
+    else // Data byte without running status, ignore
+        return;
+    switch (status & 0xF0) {
+        case 0x80: // Note Off
+            data2 = readByte(track);
+            if (handleNoteOff != NULL)
+                handleNoteOff(status & 0x0F, data1, data2);
+            break;
+        case 0x90: // Note On (velocity 0 means Note Off)
+            data2 = readByte(track);
+            if (data2 == 0x00) {
+                if (handleNoteOff != NULL)
+                    handleNoteOff(status & 0x0F, data1, data2);
+            }
+            else if (handleNoteOn != NULL)
+                handleNoteOn(status & 0x0F, data1, data2);
+            break;
+        case 0xB0: // Control Change
+            data2 = readByte(track);
+            if (handleControlChange != NULL)
+                handleControlChange(status & 0x0F, data1, data2);
+            break;
+        case 0xA0: // Polyphonic Key Pressure
+        case 0xE0: // Pitch Bend
+            readByte(track);
+            break;
+        default: // Program Change and Channel Pressure (single data byte)
+            break;
+    }
+}
+
+// Get the unfinished track with the earliest next event
+struct MidiFileReader::Track *MidiFileReader::nextTrack(void) {
+    struct Track *next = NULL;
+    for (size_t i=0; i<numTracks; i++)
+        if (!tracks[i].finished && (next == NULL || tracks[i].nextTick < next->nextTick))
+            next = &tracks[i];
+    return next;
+}
+
+// Convert an absolute tick into time (us) using the current tempo
+uint64_t MidiFileReader::tickToTime(uint32_t tick) {
+    if (division & 0x8000) { // SMPTE time division (frames per second x ticks per frame)
+        uint32_t ticksPerSecond = (uint8_t)(-(int8_t)(division >> 8)) * (division & 0xFF);
+        return ticksPerSecond ? (uint64_t)tick * 1000000U / ticksPerSecond : 0U;
+    }
+    return tempoTime + (uint64_t)(tick - tempoTick) * tempo / division;
+}
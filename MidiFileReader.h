@@ -0,0 +1,79 @@
+#ifndef MIDI_FILE_READER_H
+#define MIDI_FILE_READER_H
+/**
+ * MIDI File Reader class - Streams Standard MIDI Files (format 0/1) and replays their events.
+ * Tracks are read through a user-supplied positional read handler with a small fixed-size buffer
+ * per track, so files of any length can be replayed with bounded memory. Events of all tracks
+ * are merged in time order and dispatched to the usual Note On/Off and Control Change handlers
+ * (MIDI channels in 0..15 range) when a virtual clock (in ms) reaches them. Files with more than
+ * MIDI_FILE_MAX_TRACKS tracks are rejected by begin() rather than replayed with missing tracks.
+ *
+ * Hugo Hromic - http://github.com/hhromic
+ * MIT license
+ */
+
+#include <cinttypes>
+#include <MidiLedsCompat.h>
+
+// Maximum number of tracks and per-track buffer size
+#define MIDI_FILE_MAX_TRACKS 16
+#define MIDI_FILE_BUFFER_SIZE 32
+
+class MidiFileReader {
+    public:
+        // Class constructor
+        MidiFileReader();
+
+        // Public methods
+        bool begin(void);
+        bool playUntil(unsigned long time);
+        unsigned long getNextEventTime(void);
+        unsigned long getEventTime(void);
+        bool isFinished(void);
+        uint16_t getFormat(void);
+        uint16_t getNumTracks(void);
+        void setHandleRead(size_t (*fptr)(uint32_t offset, uint8_t *buffer, size_t length));
+        void setHandleNoteOn(void (*fptr)(uint8_t channel, uint8_t note, uint8_t velocity));
+        void setHandleNoteOff(void (*fptr)(uint8_t channel, uint8_t note, uint8_t velocity));
+        void setHandleControlChange(void (*fptr)(uint8_t channel, uint8_t control, uint8_t value));
+
+    private:
+        // Streaming state per track
+        struct Track {
+            uint32_t offset;
+            uint32_t end;
+            uint8_t buffer[MIDI_FILE_BUFFER_SIZE];
+            uint8_t bufferPos;
+            uint8_t bufferLen;
+            uint8_t runningStatus;
+            bool finished;
+            uint32_t nextTick;
+        } tracks[MIDI_FILE_MAX_TRACKS];
+
+        // File and tempo state
+        uint16_t format;
+        uint16_t numTracks;
+        uint16_t division;
+        uint32_t tempo;
+        uint32_t tempoTick;
+        uint64_t tempoTime;
+        uint32_t currentTick;
+
+        // Handlers
+        size_t (*handleRead)(uint32_t offset, uint8_t *buffer, size_t length);
+        void (*handleNoteOn)(uint8_t channel, uint8_t note, uint8_t velocity);
+        void (*handleNoteOff)(uint8_t channel, uint8_t note, uint8_t velocity);
+        void (*handleControlChange)(uint8_t channel, uint8_t control, uint8_t value);
+
+        // Internal helpers
+        uint32_t readBytes(uint32_t offset, uint8_t length);
+        uint8_t readByte(struct Track *track);
+        uint32_t readVarLen(struct Track *track);
+        void skip(struct Track *track, uint32_t length);
+        void readDelta(struct Track *track);
+        void processEvent(struct Track *track);
+        struct Track *nextTrack(void);
+        uint64_t tickToTime(uint32_t tick);
+};
+
+#endif
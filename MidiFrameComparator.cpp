@@ -0,0 +1,112 @@
+#include <MidiFrameComparator.h>
+
+// Class constructor
+MidiFrameComparator::MidiFrameComparator() {
+    numLeds = 0;
+    tolerance = 0;
+    valid = false;
+    frameCount = 0U;
+    mismatchedFrames = 0U;
+    maxDifference = 0;
+    handleRead = NULL;
+    handleDiff = NULL;
+}
+
+// Set the largest accepted difference of a color component (0 for exact matches)
+void MidiFrameComparator::setTolerance(uint8_t tolerance) {
+    this->tolerance = tolerance;
+}
+
+// Get the largest accepted difference of a color component
+uint8_t MidiFrameComparator::getTolerance(void) {
+    return tolerance;
+}
+
+// Start a new comparison for the given number of LEDs (reads and checks the golden header)
+bool MidiFrameComparator::begin(uint16_t numLeds) {
+    uint8_t header[6];
+    this->numLeds = numLeds;
+    frameCount = 0U;
+    mismatchedFrames = 0U;
+    maxDifference = 0;
+    valid = read(header, sizeof(header)) && header[0] == 'M' && header[1] == 'L' && header[2] == 'F' && header[3] == 'R'
+        && (header[4] | (header[5] << 8)) == numLeds;
+    return valid;
+}
+
+// Compare a frame of LEDs rendered at the given time (us) with the next golden frame
+// Returns true if the frame matches within the tolerance (missing golden frames never match)
+bool MidiFrameComparator::compare(unsigned long time, const struct CRGB *leds) {
+    uint8_t frameTime[4];
+    uint8_t chunk[CHUNK_LEDS * 3];
+    uint16_t mismatches = 0, firstLed = 0;
+    uint8_t frameDifference = 0;
+    valid = valid && read(frameTime, sizeof(frameTime));
+    unsigned long goldenTime = valid ? frameTime[0] | (frameTime[1] << 8) | ((uint32_t)frameTime[2] << 16) | ((uint32_t)frameTime[3] << 24) : 0U;
+    bool timed = valid && (uint32_t)goldenTime == (uint32_t)time;
+    for (uint16_t i=0; i<numLeds && valid; i+=CHUNK_LEDS) {
+        uint16_t count = numLeds - i < CHUNK_LEDS ? numLeds - i : CHUNK_LEDS;
+        valid = read(chunk, count * 3);
+        for (uint16_t j=0; j<count && valid; j++) {
+            uint8_t difference = 0;
+            for (uint8_t k=0; k<3; k++) {
+                uint8_t value = ((const uint8_t *)&leds[i + j])[k]; // CRGB is packed R,G,B
+                uint8_t golden = chunk[j * 3 + k];
+                uint8_t delta = value > golden ? value - golden : golden - value;
+                if (delta > difference)
+                    difference = delta;
+            }
+            if (difference > tolerance && mismatches++ == 0)
+                firstLed = i + j;
+            if (difference > frameDifference)
+                frameDifference = difference;
+        }
+    }
+    if (frameDifference > maxDifference)
+        maxDifference = frameDifference;
+    frameCount++;
+    if (valid && timed && mismatches == 0)
+        return true;
+    mismatchedFrames++;
+    if (handleDiff != NULL)
+        handleDiff(frameCount - 1, time, goldenTime, valid ? mismatches : numLeds, firstLed, frameDifference);
+    return false;
+}
+
+// Finish a comparison (returns true if all frames matched and the golden stream has no more frames)
+bool MidiFrameComparator::end(void) {
+    uint8_t extra;
+    return valid && mismatchedFrames == 0U && (handleRead == NULL || handleRead(&extra, 1) == 0);
+}
+
+// Get the number of frames compared so far
+unsigned long MidiFrameComparator::getFrameCount(void) {
+    return frameCount;
+}
+
+// Get the number of frames that did not match so far
+unsigned long MidiFrameComparator::getMismatchedFrames(void) {
+    return mismatchedFrames;
+}
+
+// Get the largest difference of a color component found so far
+uint8_t MidiFrameComparator::getMaxDifference(void) {
+    return maxDifference;
+}
+
+// Set a handler for reading golden data (returns the number of bytes read)
+void MidiFrameComparator::setHandleRead(size_t (*fptr)(uint8_t *buffer, size_t length)) {
+    handleRead = fptr;
+}
+
+// Set a handler for frames that do not match (frames are counted from 0)
+// A frame whose LEDs all match but was rendered at another time than the golden frame (goldenTime)
+// is reported with no mismatched LEDs. Missing golden frames report all LEDs mismatched.
+void MidiFrameComparator::setHandleDiff(void (*fptr)(unsigned long frame, unsigned long time, unsigned long goldenTime, uint16_t mismatches, uint16_t firstLed, uint8_t maxDifference)) {
+    handleDiff = fptr;
+}
+
+// Read exactly a number of bytes from the golden stream
+bool MidiFrameComparator::read(uint8_t *buffer, size_t length) {
+    return handleRead != NULL && handleRead(buffer, length) == length;
+}
@@ -0,0 +1,54 @@
+#ifndef MIDI_FRAME_COMPARATOR_H
+#define MIDI_FRAME_COMPARATOR_H
+/**
+ * MIDI Frame Comparator class - Compares rendered LED frames against a golden frames stream.
+ * The golden stream uses the MidiFrameRecorder layout and is read through a user-supplied read handler,
+ * a few LEDs at a time (no frame buffer is needed). Each frame is compared with a tolerance on every
+ * R,G,B component, so that small rounding changes can be accepted while real regressions are reported.
+ * Frames that do not match (different time, or any component beyond the tolerance) are reported to a
+ * diff handler with the rendered and golden frame times, the number of mismatched LEDs, the first of
+ * them and the largest difference (a frame with only a wrong time has no mismatched LEDs).
+ *
+ * Hugo Hromic - http://github.com/hhromic
+ * MIT license
+ */
+
+#include <cinttypes>
+#include <MidiLedsCompat.h>
+#include <pixeltypes.h>
+
+class MidiFrameComparator {
+    public:
+        // Class constructor
+        MidiFrameComparator();
+
+        // Configuration
+        void setTolerance(uint8_t tolerance);
+        uint8_t getTolerance(void);
+
+        // Public methods
+        bool begin(uint16_t numLeds);
+        bool compare(unsigned long time, const struct CRGB *leds);
+        bool end(void);
+        unsigned long getFrameCount(void);
+        unsigned long getMismatchedFrames(void);
+        uint8_t getMaxDifference(void);
+        void setHandleRead(size_t (*fptr)(uint8_t *buffer, size_t length));
+        void setHandleDiff(void (*fptr)(unsigned long frame, unsigned long time, unsigned long goldenTime, uint16_t mismatches, uint16_t firstLed, uint8_t maxDifference));
+
+    private:
+        // Number of LEDs read from the golden stream at a time
+        static const uint16_t CHUNK_LEDS = 16;
+
+        uint16_t numLeds;
+        uint8_t tolerance;
+        bool valid;
+        unsigned long frameCount;
+        unsigned long mismatchedFrames;
+        uint8_t maxDifference;
+        size_t (*handleRead)(uint8_t *buffer, size_t length);
+        void (*handleDiff)(unsigned long frame, unsigned long time, unsigned long goldenTime, uint16_t mismatches, uint16_t firstLed, uint8_t maxDifference);
+        bool read(uint8_t *buffer, size_t length);
+};
+
+#endif
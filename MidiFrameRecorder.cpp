@@ -0,0 +1,40 @@
+#include <MidiFrameRecorder.h>
+
+// Class constructor
+MidiFrameRecorder::MidiFrameRecorder() {
+    numLeds = 0;
+    frameCount = 0U;
+    handleWrite = NULL;
+}
+
+// Start a new recording for the given number of LEDs (writes the header)
+bool MidiFrameRecorder::begin(uint16_t numLeds) {
+    uint8_t header[6] = {'M', 'L', 'F', 'R', (uint8_t)(numLeds & 0xFF), (uint8_t)(numLeds >> 8)};
+    this->numLeds = numLeds;
+    frameCount = 0U;
+    return handleWrite != NULL && handleWrite(header, sizeof(header)) == sizeof(header);
+}
+
+// Record a frame of LEDs rendered at the given time (us)
+bool MidiFrameRecorder::record(unsigned long time, const struct CRGB *leds) {
+    uint8_t frameTime[4] = {
+        (uint8_t)(time & 0xFF), (uint8_t)((time >> 8) & 0xFF),
+        (uint8_t)((time >> 16) & 0xFF), (uint8_t)((time >> 24) & 0xFF),
+    };
+    if (handleWrite == NULL || handleWrite(frameTime, sizeof(frameTime)) != sizeof(frameTime))
+        return false;
+    if (handleWrite((const uint8_t *)leds, numLeds * sizeof(struct CRGB)) != numLeds * sizeof(struct CRGB)) // CRGB is packed R,G,B
+        return false;
+    frameCount++;
+    return true;
+}
+
+// Get the number of frames recorded so far
+unsigned long MidiFrameRecorder::getFrameCount(void) {
+    return frameCount;
+}
+
+// Set a handler for writing recorded data (returns the number of bytes written)
+void MidiFrameRecorder::setHandleWrite(size_t (*fptr)(const uint8_t *buffer, size_t length)) {
+    handleWrite = fptr;
+}
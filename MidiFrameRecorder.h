@@ -0,0 +1,34 @@
+#ifndef MIDI_FRAME_RECORDER_H
+#define MIDI_FRAME_RECORDER_H
+/**
+ * MIDI Frame Recorder class - Records rendered LED frames into a compact binary stream.
+ * Data is written through a user-supplied write handler using the following layout:
+ *   header: "MLFR" magic, number of LEDs (uint16, little-endian)
+ *   frame:  time in us (uint32, little-endian), followed by R,G,B bytes for each LED
+ *
+ * Hugo Hromic - http://github.com/hhromic
+ * MIT license
+ */
+
+#include <cinttypes>
+#include <MidiLedsCompat.h>
+#include <pixeltypes.h>
+
+class MidiFrameRecorder {
+    public:
+        // Class constructor
+        MidiFrameRecorder();
+
+        // Public methods
+        bool begin(uint16_t numLeds);
+        bool record(unsigned long time, const struct CRGB *leds);
+        unsigned long getFrameCount(void);
+        void setHandleWrite(size_t (*fptr)(const uint8_t *buffer, size_t length));
+
+    private:
+        uint16_t numLeds;
+        unsigned long frameCount;
+        size_t (*handleWrite)(const uint8_t *buffer, size_t length);
+};
+
+#endif
@@ -0,0 +1,111 @@
+#include <MidiFrameScheduler.h>
+
+// Class constructor
+MidiFrameScheduler::MidiFrameScheduler() {
+    started = false;
+    frameTime = 0U;
+    nextFrameTime = 0U;
+    nextFrameFraction = 0U;
+    setFrameRate(60);
+    resetStats();
+}
+
+// Set the target frame rate (frames per second, 1 to 1000)
+void MidiFrameScheduler::setFrameRate(uint16_t frameRate) {
+    if (frameRate < 1)
+        frameRate = 1;
+    else if (frameRate > 1000)
+        frameRate = 1000;
+    this->frameRate = frameRate;
+    framePeriod = 1000000000U / frameRate;
+}
+
+// Get the target frame rate (frames per second)
+uint16_t MidiFrameScheduler::getFrameRate(void) {
+    return frameRate;
+}
+
+// Start the frame schedule with a frame due at the given time
+void MidiFrameScheduler::begin(unsigned long time) {
+    started = true;
+    frameTime = time;
+    nextFrameTime = time;
+    nextFrameFraction = 0U;
+}
+
+// Test if a frame is due at the given time (the schedule starts on the first call if not begun)
+// When true, the frame should be rendered at getFrameTime() and then endFrame() called
+bool MidiFrameScheduler::isFrameDue(unsigned long time) {
+    if (!started)
+        begin(time);
+    if ((int32_t)(time - nextFrameTime) < 0) // Still some slack?
+        return false;
+
+    // Drop the frames that are already a whole frame period late
+    unsigned long dropped = (uint64_t)(uint32_t)(time - nextFrameTime) * 1000U / framePeriod;
+    if (dropped > 0) {
+        advance(dropped);
+        droppedFrames += dropped;
+    }
+
+    // Render this frame at its timestamp and schedule the next one
+    frameTime = nextFrameTime;
+    if ((uint32_t)(time - frameTime) > maxLateness)
+        maxLateness = (uint32_t)(time - frameTime);
+    frameCount++;
+    advance(1);
+    return true;
+}
+
+// Notify the end of a frame rendering (counts an overrun if the next frame is already due)
+void MidiFrameScheduler::endFrame(unsigned long time) {
+    if ((int32_t)(time - nextFrameTime) >= 0)
+        overruns++;
+}
+
+// Get the timestamp of the frame being rendered (use it as the tick time)
+unsigned long MidiFrameScheduler::getFrameTime(void) {
+    return frameTime;
+}
+
+// Get the time left until the next frame is due (0 if already due)
+unsigned long MidiFrameScheduler::getSlack(unsigned long time) {
+    if (!started || (int32_t)(time - nextFrameTime) >= 0)
+        return 0U;
+    return (uint32_t)(nextFrameTime - time);
+}
+
+// Get the number of frames rendered
+unsigned long MidiFrameScheduler::getFrameCount(void) {
+    return frameCount;
+}
+
+// Get the number of frames dropped for starting a whole frame period late
+unsigned long MidiFrameScheduler::getDroppedFrames(void) {
+    return droppedFrames;
+}
+
+// Get the number of frames whose rendering ended after the next frame was due
+unsigned long MidiFrameScheduler::getOverruns(void) {
+    return overruns;
+}
+
+// Get the maximum time a rendered frame started after its timestamp (us)
+unsigned long MidiFrameScheduler::getMaxLateness(void) {
+    return maxLateness;
+}
+
+// Reset all statistics
+void MidiFrameScheduler::resetStats(void) {
+    frameCount = 0U;
+    droppedFrames = 0U;
+    overruns = 0U;
+    maxLateness = 0U;
+}
+
+// Advance the schedule by a number of frame periods (carrying the sub-microsecond remainder)
+void MidiFrameScheduler::advance(unsigned long frames) {
+    uint64_t fraction = nextFrameFraction + (uint64_t)frames * framePeriod;
+    nextFrameTime += fraction / 1000U;
+    nextFrameFraction = fraction % 1000U;
+}
@@ -0,0 +1,63 @@
+#ifndef MIDI_FRAME_SCHEDULER_H
+#define MIDI_FRAME_SCHEDULER_H
+/**
+ * MIDI Frame Scheduler class - Paces LED rendering at a target frame rate.
+ * The main loop polls MIDI as often as it can and only renders (ticks and shows the LEDs) when
+ * isFrameDue() says a frame is due. Frames are rendered at their scheduled timestamp (see
+ * getFrameTime()) rather than at the current time, so frames are evenly spaced even when a
+ * frame starts late. Because envelopes are computed analytically, skipping ticks between frames
+ * does not change what is shown.
+ *
+ * Frames that start a whole frame period late or more are dropped (the schedule skips ahead)
+ * and frames whose rendering ends after the next frame is due are counted as overruns.
+ * Times are in us and are given by the caller (e.g. micros() or a simulated clock), and may wrap around
+ * (they are compared as 32-bit differences, also where unsigned long is wider).
+ *
+ * Hugo Hromic - http://github.com/hhromic
+ * MIT license
+ */
+
+#include <cinttypes>
+#include <MidiLedsCompat.h>
+
+class MidiFrameScheduler {
+    public:
+        // Class constructor
+        MidiFrameScheduler();
+
+        // Configuration
+        void setFrameRate(uint16_t frameRate);
+        uint16_t getFrameRate(void);
+
+        // Public methods
+        void begin(unsigned long time);
+        bool isFrameDue(unsigned long time);
+        void endFrame(unsigned long time);
+        unsigned long getFrameTime(void);
+        unsigned long getSlack(unsigned long time);
+
+        // Statistics
+        unsigned long getFrameCount(void);
+        unsigned long getDroppedFrames(void);
+        unsigned long getOverruns(void);
+        unsigned long getMaxLateness(void);
+        void resetStats(void);
+
+    private:
+        // Frame schedule (the frame period is kept in ns so that any frame rate averages exactly)
+        uint16_t frameRate;
+        unsigned long framePeriod;
+        bool started;
+        unsigned long frameTime;
+        unsigned long nextFrameTime;
+        unsigned long nextFrameFraction;
+        void advance(unsigned long frames);
+
+        // Statistics
+        unsigned long frameCount;
+        unsigned long droppedFrames;
+        unsigned long overruns;
+        unsigned long maxLateness;
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef MIDI_HANDLERS_H
+#define MIDI_HANDLERS_H
+/**
+ * MIDI Handlers struct - Runtime (function pointer) MIDI message handlers usable as a pipeline stage.
+ * Unset (NULL) handlers are safely ignored. If no batch Note Off handler is set, batches of
+ * Note Off messages are delivered one note at a time to the Note Off handler.
+ *
+ * Hugo Hromic - http://github.com/hhromic
+ * MIT license
+ */
+
+#include <cinttypes>
+#include <MidiLedsCompat.h>
+
+struct MidiHandlers {
+    void (*handleNoteOn)(uint8_t channel, uint8_t note, uint8_t velocity);
+    void (*handleNoteOff)(uint8_t channel, uint8_t note, uint8_t velocity);
+    void (*handleNotesOff)(uint8_t channel, const uint32_t *notes);
+
+    // Class constructor
+    MidiHandlers() : handleNoteOn(NULL), handleNoteOff(NULL), handleNotesOff(NULL) {}
+
+    // Process a Note On message
+    void noteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
+        if (handleNoteOn != NULL)
+            handleNoteOn(channel, note, velocity);
+    }
+
+    // Process a Note Off message
+    void noteOff(uint8_t channel, uint8_t note, uint8_t velocity) {
+        if (handleNoteOff != NULL)
+            handleNoteOff(channel, note, velocity);
+    }
+
+    // Process a batch of Note Off messages (128-bit notes mask, uint32_t[4])
+    void notesOff(uint8_t channel, const uint32_t *notes) {
+        if (handleNotesOff != NULL) {
+            handleNotesOff(channel, notes);
+            return;
+        }
+        if (handleNoteOff == NULL)
+            return;
+        for (size_t i=0; i<4; i++) {
+            uint32_t bits = notes[i];
+            while (bits) { // Only visit set bits
+                handleNoteOff(channel, i * 32 + __builtin_ctz(bits), 0x00);
+                bits &= bits - 1;
+            }
+        }
+    }
+};
+
+#endif
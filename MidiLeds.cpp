@@ -3,86 +3,578 @@
 
 // Class constructor
 MidiLeds::MidiLeds() {
+    noteData = NULL;
+    outputMap = NULL;
+    brightnessTable16 = NULL;
+    ditherFrame = 0x00;
+    nextWakeTime = 0U;
+    backgroundBrightness = 0x00;
+    velocityGroups = false;
     useLeds(NULL, 0x00, 0x7F);
 }
 
+// Class destructor
+MidiLeds::~MidiLeds() {
+    delete[] noteData;
+    delete[] brightnessTable16;
+}
+
 // Use LEDs array with given noteMin and noteMax limits
 void MidiLeds::useLeds(struct CRGB *leds, uint8_t noteMin, uint8_t noteMax) {
     this->leds = leds;
     this->noteMin = noteMin;
     this->noteMax = noteMax;
-    midiColorMapper.setNoteMin(noteMin);
-    midiColorMapper.setNoteMax(noteMax);
-    allLedsOff();
+    midiColorMapper.setNoteMin(0, noteMin);
+    midiColorMapper.setNoteMax(0, noteMax);
+    resizeSlots();
     reset();
 }
 
+// Write LEDs through an output map instead of the LEDs array (NULL goes back to the LEDs array)
+void MidiLeds::useOutputMap(MidiLedsOutputMap *outputMap) {
+    this->outputMap = outputMap;
+}
+
+// Use a pool of voices for up to the given number of notes lit at once (0 uses one envelope per LED)
+void MidiLeds::useVoices(uint8_t polyphony) {
+    voicePool.resize(polyphony);
+    resizeSlots();
+}
+
+// Get the number of voices in the pool (0 if using one envelope per LED)
+uint8_t MidiLeds::getPolyphony(void) {
+    return voicePool.getPolyphony();
+}
+
+// Get the voice stealing policy
+MidiVoicePool::StealPolicies MidiLeds::getStealPolicy(void) {
+    return voicePool.getStealPolicy();
+}
+
+// Set the voice stealing policy (used when a Note On message arrives and all voices are in use)
+void MidiLeds::setStealPolicy(MidiVoicePool::StealPolicies stealPolicy) {
+    voicePool.setStealPolicy(stealPolicy);
+}
+
+// Test if brightness is dithered
+bool MidiLeds::getDithering(void) {
+    return brightnessTable16 != NULL;
+}
+
+// Set brightness dithering (16-bit brightness, allocates a 16-bit brightness table)
+// The dither sequence restarts, so that replaying the same events renders the same frames
+void MidiLeds::setDithering(bool state) {
+    ditherFrame = 0x00;
+    if (state && brightnessTable16 == NULL) {
+        brightnessTable16 = new uint16_t[256];
+        buildBrightnessTable16(brightnessTable16, parameters.gamma);
+    }
+    else if (!state) {
+        delete[] brightnessTable16;
+        brightnessTable16 = NULL;
+    }
+    wakeAll();
+}
+
 // Parameter getters
 unsigned long MidiLeds::getAttackTime(void) { return parameters.attackTime; }
 unsigned long MidiLeds::getDecayTime(void) { return parameters.decayTime; }
 float MidiLeds::getSustainLevel(void) { return parameters.sustainLevel; }
 unsigned long MidiLeds::getReleaseTime(void) { return parameters.releaseTime; }
+AdsrEnvelopeBank::Curves MidiLeds::getAttackCurve(void) { return parameters.attackCurve; }
+AdsrEnvelopeBank::Curves MidiLeds::getDecayCurve(void) { return parameters.decayCurve; }
+AdsrEnvelopeBank::Curves MidiLeds::getReleaseCurve(void) { return parameters.releaseCurve; }
 MidiColorMapper::Mappers MidiLeds::getColorMapper(void) { return parameters.colorMapper; }
 MidiNoteColors::Maps MidiLeds::getNoteColorMap(void) { return parameters.noteColorMap; }
+MidiColorMapper::CustomMapper MidiLeds::getCustomColorMapper(void) { return parameters.customColorMapper; }
 uint8_t MidiLeds::getFixedHue(void) { return parameters.fixedHue; }
 bool MidiLeds::getIgnoreVelocity(void) { return parameters.ignoreVelocity; }
 uint8_t MidiLeds::getBaseBrightness(void) { return parameters.baseBrightness; }
+float MidiLeds::getGamma(void) { return parameters.gamma; }
+float MidiLeds::getVelocityToAttack(void) { return parameters.velocityToAttack; }
+float MidiLeds::getVelocityToDecay(void) { return parameters.velocityToDecay; }
+float MidiLeds::getVelocityToSustain(void) { return parameters.velocityToSustain; }
 
-// Parameter setters
-void MidiLeds::setAttackTime(unsigned long attackTime) { parameters.attackTime = attackTime; }
-void MidiLeds::setDecayTime(unsigned long decayTime) { parameters.decayTime = decayTime; }
-void MidiLeds::setSustainLevel(float sustainLevel) { parameters.sustainLevel = sustainLevel; }
-void MidiLeds::setReleaseTime(unsigned long releaseTime) { parameters.releaseTime = releaseTime; }
+// Parameter setters (applied once on the next tick, see applyChanges())
+void MidiLeds::setAttackTime(unsigned long attackTime) {
+    parameters.attackTime = attackTime;
+    envelopesChanged = true;
+}
+void MidiLeds::setDecayTime(unsigned long decayTime) {
+    parameters.decayTime = decayTime;
+    envelopesChanged = true;
+}
+void MidiLeds::setSustainLevel(float sustainLevel) {
+    parameters.sustainLevel = sustainLevel;
+    envelopesChanged = true;
+}
+void MidiLeds::setReleaseTime(unsigned long releaseTime) {
+    parameters.releaseTime = releaseTime;
+    envelopesChanged = true;
+}
+void MidiLeds::setAttackCurve(AdsrEnvelopeBank::Curves curve) {
+    parameters.attackCurve = curve;
+    envelopesChanged = true;
+}
+void MidiLeds::setDecayCurve(AdsrEnvelopeBank::Curves curve) {
+    parameters.decayCurve = curve;
+    envelopesChanged = true;
+}
+void MidiLeds::setReleaseCurve(AdsrEnvelopeBank::Curves curve) {
+    parameters.releaseCurve = curve;
+    envelopesChanged = true;
+}
 void MidiLeds::setColorMapper(MidiColorMapper::Mappers colorMapper) {
     parameters.colorMapper = colorMapper;
-    midiColorMapper.setMapper(colorMapper);
+    colorsChanged = true;
 }
 void MidiLeds::setNoteColorMap(MidiNoteColors::Maps noteColorMap) {
     parameters.noteColorMap = noteColorMap;
-    midiColorMapper.setNoteColorMap(noteColorMap);
+    colorsChanged = true;
+}
+void MidiLeds::setCustomColorMapper(MidiColorMapper::CustomMapper customMapper) {
+    parameters.customColorMapper = customMapper;
+    colorsChanged = true;
 }
 void MidiLeds::setFixedHue(uint8_t hue) {
     parameters.fixedHue = hue;
-    midiColorMapper.setFixedHue(hue);
+    colorsChanged = true;
+}
+void MidiLeds::setIgnoreVelocity(bool state) {
+    parameters.ignoreVelocity = state;
+    colorsChanged = true;
+}
+void MidiLeds::setBaseBrightness(uint8_t value) {
+    parameters.baseBrightness = value;
+    colorsChanged = true;
+}
+void MidiLeds::setGamma(float gamma) {
+    parameters.gamma = gamma;
+    colorsChanged = true;
+}
+void MidiLeds::setVelocityToAttack(float amount) {
+    parameters.velocityToAttack = amount;
+    envelopesChanged = true;
+    allocateVelocityGroups(amount);
+}
+void MidiLeds::setVelocityToDecay(float amount) {
+    parameters.velocityToDecay = amount;
+    envelopesChanged = true;
+    allocateVelocityGroups(amount);
+}
+void MidiLeds::setVelocityToSustain(float amount) {
+    parameters.velocityToSustain = amount;
+    envelopesChanged = true;
+    allocateVelocityGroups(amount);
+}
+
+// Allocate the velocity parameter groups on the first non-zero velocity amount (kept afterwards, so
+// ticks never allocate), keeping the parameters of the notes sounding until the next tick
+void MidiLeds::allocateVelocityGroups(float amount) {
+    if (amount == 0.0f || adsrEnvelopes.getGroups() == VELOCITY_GROUPS)
+        return;
+    adsrEnvelopes.setGroups(VELOCITY_GROUPS);
+    velocityGroups = false;
+    applyEnvelopes();
 }
-void MidiLeds::setIgnoreVelocity(bool state) { parameters.ignoreVelocity = state; }
-void MidiLeds::setBaseBrightness(uint8_t value) { parameters.baseBrightness = value; }
 
-// Process a Note On message
+// Process a Note On message (its envelope starts on the next tick)
 void MidiLeds::noteOn(uint8_t note, uint8_t velocity) {
-    if (note >= noteMin && note <= noteMax) {
-        hsvData[note] = midiColorMapper.map(note, parameters.ignoreVelocity ? 0x7F : velocity);
-        adsrEnvelopes[note].noteOn(parameters.attackTime, parameters.decayTime, parameters.sustainLevel, parameters.releaseTime);
+    int16_t slot = startNote(note, velocity);
+    if (slot >= 0) {
+        adsrEnvelopes.noteOn(slot);
+        wakeNote(note);
     }
 }
 
 // Process a Note Off message
 void MidiLeds::noteOff(uint8_t note) {
-    if (note >= noteMin && note <= noteMax)
-        adsrEnvelopes[note].noteOff();
+    int16_t slot = slotOf(note);
+    if (slot >= 0) {
+        adsrEnvelopes.noteOff(slot);
+        wakeNote(note);
+    }
+}
+
+// Process a Note On message that arrived at a given time (us)
+void MidiLeds::noteOn(uint8_t note, uint8_t velocity, unsigned long time) {
+    int16_t slot = startNote(note, velocity);
+    if (slot >= 0) {
+        adsrEnvelopes.noteOn(slot, time);
+        wakeNote(note);
+    }
+}
+
+// Allocate and color the slot of a Note On message (returns -1 for notes out of range)
+int16_t MidiLeds::startNote(uint8_t note, uint8_t velocity) {
+    if (note < noteMin || note > noteMax)
+        return -1;
+    int16_t slot = note - noteMin;
+    if (voicePool.getPolyphony() > 0) {
+        slot = voicePool.allocateVoice(0, note);
+        if (slot < 0) { // All voices in use, steal one and leave its LED at the base brightness
+            slot = voicePool.stealVoice(adsrEnvelopes);
+            uint8_t stolen = voicePool.getNote(slot);
+            struct CRGB color = noteData[slot].color;
+            color.nscale8(parameters.baseBrightness);
+            writeLed(stolen, color);
+            bitClear(activeNotes[stolen / 32], stolen % 32);
+            slot = voicePool.allocateVoice(0, note);
+        }
+    }
+    struct CHSV color = midiColorMapper.map(0, note, parameters.ignoreVelocity ? 0x7F : velocity);
+    noteData[slot].color = CHSV(color.h, color.s, 0xFF);
+    noteData[slot].value = color.v;
+    noteData[slot].velocity = velocity;
+    if (velocityGroups) // Velocity sensitive envelopes?
+        adsrEnvelopes.setGroup(slot, velocityGroupOf(velocity));
+    bitSet(activeNotes[note / 32], note % 32);
+    return slot;
+}
+
+// Process a Note Off message that arrived at a given time (us)
+void MidiLeds::noteOff(uint8_t note, unsigned long time) {
+    int16_t slot = slotOf(note);
+    if (slot >= 0) {
+        adsrEnvelopes.noteOff(slot, time);
+        wakeNote(note);
+    }
+}
+
+// Process a batch of Note Off messages (128-bit notes mask, uint32_t[4])
+void MidiLeds::notesOff(const uint32_t *notes) {
+    for (size_t i=0; i<4; i++) {
+        uint32_t bits = notes[i] & activeNotes[i]; // Only active notes need a release
+        while (bits) {
+            noteOff(i * 32 + __builtin_ctz(bits));
+            bits &= bits - 1;
+        }
+    }
+}
+
+// Process a batch of Note Off messages that arrived at a given time (us)
+void MidiLeds::notesOff(const uint32_t *notes, unsigned long time) {
+    for (size_t i=0; i<4; i++) {
+        uint32_t bits = notes[i] & activeNotes[i]; // Only active notes need a release
+        while (bits) {
+            noteOff(i * 32 + __builtin_ctz(bits), time);
+            bits &= bits - 1;
+        }
+    }
 }
 
 // Turn off all Leds
 void MidiLeds::allLedsOff(void) {
-    for (size_t i=0; i<0x7F; i++) {
-        adsrEnvelopes[i].noteOff();
-        hsvData[i] = CHSV(0,0,0);
-    }
+    adsrEnvelopes.allOff();
+    wakeAll();
+}
+
+// Recolor all notes on the next tick (e.g. after a custom mapper state or custom map changed)
+void MidiLeds::updateColors(void) {
+    colorsChanged = true;
 }
 
-// Reset all parameters to their defaults
+// Reset all parameters to their defaults (applied on the next tick)
 void MidiLeds::reset(void) {
     parameters = DEFAULTS;
+    envelopesChanged = true;
+    colorsChanged = true;
 }
 
-// Process a clock tick
-void MidiLeds::tick(unsigned long time) {
-    for (size_t i=noteMin; i<=noteMax; i++) {
-        if (adsrEnvelopes[i].tick(time)) {
-            uint8_t brightness = round(adsrEnvelopes[i].getOutput() * hsvData[i].v);
-            if (brightness < parameters.baseBrightness)
-                brightness = parameters.baseBrightness;
-            leds[i - noteMin] = CHSV(hsvData[i].h, hsvData[i].v, brightness);
+// Apply parameter changes made since the last tick to the color mapper and envelopes
+// Sounding notes are recolored in place (their envelopes continue) and idle notes show the base brightness
+// Returns true if any LED was changed
+bool MidiLeds::applyChanges(void) {
+    bool changed = false;
+    if (envelopesChanged) {
+        bool velocityGroups = adsrEnvelopes.getGroups() == VELOCITY_GROUPS && (parameters.velocityToAttack != 0.0f
+            || parameters.velocityToDecay != 0.0f || parameters.velocityToSustain != 0.0f);
+        if (velocityGroups != this->velocityGroups) { // Move sounding notes to their groups
+            for (uint16_t note=noteMin; note<=noteMax; note++)
+                if (bitRead(activeNotes[note / 32], note % 32))
+                    adsrEnvelopes.setGroup(slotOf(note), velocityGroups ? velocityGroupOf(noteData[slotOf(note)].velocity) : 0);
+            this->velocityGroups = velocityGroups;
         }
+        applyEnvelopes();
     }
+    if (colorsChanged) {
+        midiColorMapper.setMapper(0, parameters.colorMapper);
+        midiColorMapper.setNoteColorMap(0, parameters.noteColorMap);
+        midiColorMapper.setCustomMapper(0, parameters.customColorMapper);
+        midiColorMapper.setFixedHue(0, parameters.fixedHue);
+        midiColorMapper.setIgnoreVelocity(0, parameters.ignoreVelocity);
+        buildBrightnessTable(brightnessTable, parameters.gamma);
+        buildLevelTable(levelTable, brightnessTable);
+        if (brightnessTable16 != NULL)
+            buildBrightnessTable16(brightnessTable16, parameters.gamma);
+        bool background = parameters.baseBrightness > 0 || backgroundBrightness > 0;
+        for (uint16_t note=noteMin; note<=noteMax; note++) {
+            bool active = bitRead(activeNotes[note / 32], note % 32);
+            if (!active && !background)
+                continue;
+            int16_t slot = slotOf(note);
+            struct CHSV color = midiColorMapper.map(0, note, parameters.ignoreVelocity || !active ? 0x7F : noteData[slot].velocity);
+            if (active) { // Rendered on this tick
+                noteData[slot].color = CHSV(color.h, color.s, 0xFF);
+                noteData[slot].value = color.v;
+            }
+            else {
+                struct CRGB led = CHSV(color.h, color.s, 0xFF);
+                led.nscale8(parameters.baseBrightness);
+                changed |= writeLed(note, led);
+            }
+        }
+        backgroundBrightness = parameters.baseBrightness;
+    }
+    envelopesChanged = false;
+    colorsChanged = false;
+    wakeAll();
+    return changed;
+}
+
+// Compute the envelope parameters of the first group, or of all velocity groups while they are in use
+void MidiLeds::applyEnvelopes(void) {
+    uint8_t groups = velocityGroups ? VELOCITY_GROUPS : 1;
+    for (size_t i=0; i<groups; i++) {
+        uint8_t velocity = i * 8 < 0x7F ? i * 8 : 0x7F; // Velocity the group is computed for
+        adsrEnvelopes.setAttackTime(i, velocityGroups ? round(parameters.attackTime * velocityScale(parameters.velocityToAttack, velocity)) : parameters.attackTime);
+        adsrEnvelopes.setSustainLevel(i, velocityGroups ? parameters.sustainLevel * velocityScale(parameters.velocityToSustain, velocity) : parameters.sustainLevel);
+        adsrEnvelopes.setDecayTime(i, velocityGroups ? round(parameters.decayTime * velocityScale(parameters.velocityToDecay, velocity)) : parameters.decayTime);
+        adsrEnvelopes.setReleaseTime(i, parameters.releaseTime);
+        adsrEnvelopes.setAttackCurve(i, parameters.attackCurve);
+        adsrEnvelopes.setDecayCurve(i, parameters.decayCurve);
+        adsrEnvelopes.setReleaseCurve(i, parameters.releaseCurve);
+    }
+}
+
+// Get the envelope parameter group of a velocity (rounded to a multiple of 8)
+uint8_t MidiLeds::velocityGroupOf(uint8_t velocity) {
+    return ((velocity & 0x7F) + 4) >> 3;
+}
+
+// Process a clock tick at a given time (us, only visits notes that are due)
+// Returns true if any LED was changed (LEDs shared with other instances are compared by content)
+bool MidiLeds::tick(unsigned long time) {
+    bool changed = false;
+    if (envelopesChanged || colorsChanged)
+        changed = applyChanges();
+    uint32_t awake = 0x00000000, sleeping = 0x00000000;
+    for (size_t i=0; i<4; i++) {
+        awake |= activeNotes[i] & ~(sleepingNotes[i] | holdingNotes[i]);
+        sleeping |= activeNotes[i] & sleepingNotes[i];
+    }
+    if (!awake && (!sleeping || (int32_t)(time - nextWakeTime) < 0)) // Nothing due?
+        return changed;
+    ditherFrame++;
+    bool asleep = false;
+    for (size_t i=0; i<4; i++) {
+        uint32_t notes = activeNotes[i] & ~holdingNotes[i];
+        while (notes) {
+            uint8_t note = i * 32 + __builtin_ctz(notes);
+            uint8_t slot = slotOf(note);
+            notes &= notes - 1; // Clear lowest set bit
+            if (!bitRead(sleepingNotes[i], note % 32) || (int32_t)(time - noteData[slot].wakeTime) >= 0) { // Due?
+                // Envelopes can also finish inside a timed Note Off (e.g. released again at an earlier time)
+                if (adsrEnvelopes.tick(slot, time) || adsrEnvelopes.isIdle(slot) || brightnessTable16 != NULL) {
+                    struct CRGB color = noteData[slot].color;
+                    if (brightnessTable16 != NULL) { // New dither threshold on every tick (shifted per note) while fading
+                        unsigned long wakeTime;
+                        uint8_t threshold = adsrEnvelopes.getNextChange(slot, 0x0000, 0xFFFF, wakeTime) ? reverse8(ditherFrame + note * 0x4F) : 0x7F;
+                        color = ditherColor(color, brightness16Of(slot, adsrEnvelopes.getLevel(slot)), threshold);
+                    }
+                    else
+                        color.nscale8(brightnessOf(slot, adsrEnvelopes.getLevel(slot)));
+                    changed |= writeLed(note, color);
+                }
+                if (adsrEnvelopes.isIdle(slot)) { // Envelope finished?
+                    bitClear(activeNotes[i], note % 32);
+                    voicePool.freeVoice(slot);
+                    continue;
+                }
+                sleepNote(note, slot);
+            }
+            if (bitRead(sleepingNotes[i], note % 32) && (!asleep || (int32_t)(noteData[slot].wakeTime - nextWakeTime) < 0)) {
+                nextWakeTime = noteData[slot].wakeTime; // Earliest wake time of all sleeping notes
+                asleep = true;
+            }
+        }
+    }
+    return changed;
+}
+
+// Test if all notes are idle (no LEDs will change until the next Note On message)
+bool MidiLeds::isIdle(void) {
+    return !(activeNotes[0] | activeNotes[1] | activeNotes[2] | activeNotes[3]);
+}
+
+// Get the number of notes with an active envelope
+uint8_t MidiLeds::getActiveEnvelopes(void) {
+    return __builtin_popcount(activeNotes[0]) + __builtin_popcount(activeNotes[1])
+        + __builtin_popcount(activeNotes[2]) + __builtin_popcount(activeNotes[3]);
+}
+
+// Test if any LED was changed since the last clearDirty()
+bool MidiLeds::isChanged(void) {
+    return dirtyLeds[0] | dirtyLeds[1] | dirtyLeds[2] | dirtyLeds[3];
+}
+
+// Test if an LED was changed since the last clearDirty()
+bool MidiLeds::isLedDirty(uint8_t index) {
+    return bitRead(dirtyLeds[(index & 0x7F) / 32], (index & 0x7F) % 32);
+}
+
+// Clear all LED changed flags (e.g. after showing the LEDs)
+void MidiLeds::clearDirty(void) {
+    for (size_t i=0; i<4; i++)
+        dirtyLeds[i] = 0x00000000;
+}
+
+// Resize note data to one slot per voice (or per LED without voices), all notes become idle
+void MidiLeds::resizeSlots(void) {
+    uint8_t size = voicePool.getPolyphony() > 0 ? voicePool.getPolyphony() : noteMax - noteMin + 1;
+    if (size != adsrEnvelopes.getSize() || noteData == NULL) {
+        delete[] noteData;
+        noteData = new struct MidiLedsNoteData[size];
+    }
+    adsrEnvelopes.resize(size);
+    voicePool.freeAll();
+    for (size_t i=0; i<4; i++)
+        activeNotes[i] = 0x00000000;
+    wakeAll();
+    clearDirty();
+}
+
+// Get the envelope slot of a sounding note (its voice, or its LED without voices), -1 if not sounding
+int16_t MidiLeds::slotOf(uint8_t note) {
+    if (note < noteMin || note > noteMax)
+        return -1;
+    if (voicePool.getPolyphony() > 0)
+        return voicePool.findVoice(0, note);
+    return note - noteMin;
+}
+
+// Make a note due on the next tick (e.g. after a Note On/Off message)
+void MidiLeds::wakeNote(uint8_t note) {
+    bitClear(sleepingNotes[note / 32], note % 32);
+    bitClear(holdingNotes[note / 32], note % 32);
+}
+
+// Make all notes due on the next tick (e.g. after a parameter change)
+void MidiLeds::wakeAll(void) {
+    for (size_t i=0; i<4; i++) {
+        sleepingNotes[i] = 0x00000000;
+        holdingNotes[i] = 0x00000000;
+    }
+}
+
+// Put a note to sleep until its brightness can next change (levels sharing its brightness are skipped)
+void MidiLeds::sleepNote(uint8_t note, uint8_t slot) {
+    if (brightnessTable16 != NULL) { // Dithered notes stay awake while fading (rounded once at a constant level)
+        unsigned long wakeTime;
+        wakeNote(note);
+        if (!adsrEnvelopes.getNextChange(slot, 0x0000, 0xFFFF, wakeTime))
+            bitSet(holdingNotes[note / 32], note % 32);
+        return;
+    }
+    uint8_t brightness = brightnessOf(slot, adsrEnvelopes.getLevel(slot));
+    uint8_t low = brightness > parameters.baseBrightness ? levelOf(slot, brightness) : 0x00; // Base brightness from level 0
+    uint8_t high = brightness < 0xFF ? levelOf(slot, brightness + 1) - 1 : 0xFF;
+    wakeNote(note);
+    if (adsrEnvelopes.getNextChange(slot, low << 8, (high << 8) | 0xFF, noteData[slot].wakeTime))
+        bitSet(sleepingNotes[note / 32], note % 32);
+    else
+        bitSet(holdingNotes[note / 32], note % 32);
+}
+
+// Write the color of a note to its LED(s), flagging it as changed (returns true if changed)
+bool MidiLeds::writeLed(uint8_t note, const struct CRGB &color) {
+    uint8_t index = note - noteMin;
+    if (outputMap != NULL) {
+        if (!outputMap->write(note, color))
+            return false;
+    }
+    else if (leds != NULL && leds[index] != color)
+        leds[index] = color;
+    else
+        return false;
+    bitSet(dirtyLeds[index / 32], index % 32);
+    return true;
+}
+
+// Get the brightness of a note at an envelope level (never below the base brightness)
+uint8_t MidiLeds::brightnessOf(uint8_t slot, uint16_t level) {
+    uint8_t brightness = scaleBrightness(brightnessTable, level, noteData[slot].value);
+    return brightness < parameters.baseBrightness ? parameters.baseBrightness : brightness;
+}
+
+// Get the lowest envelope level (upper 8 bits) at which a note reaches a brightness, ignoring the base brightness
+// (0x100 if never reached)
+uint16_t MidiLeds::levelOf(uint8_t slot, uint16_t brightness) {
+    uint16_t entry = ((brightness << 8) + noteData[slot].value) / (noteData[slot].value + 1); // Lowest table entry scaled to it
+    return entry > 0xFF ? 0x100 : levelTable[entry];
+}
+
+// Get the factor applied to a velocity sensitive parameter at a velocity (1.0 at velocity 64, never negative)
+float MidiLeds::velocityScale(float amount, uint8_t velocity) {
+    float scale = 1.0f + amount * ((int)velocity - 0x40) / 63.0f;
+    return scale > 0.0f ? scale : 0.0f;
+}
+
+// Get the 16-bit brightness of a note at an envelope level (never below the base brightness)
+uint16_t MidiLeds::brightness16Of(uint8_t slot, uint16_t level) {
+    uint16_t brightness = scaleBrightness16(brightnessTable16, level, noteData[slot].value);
+    return brightness < (parameters.baseBrightness << 8) ? parameters.baseBrightness << 8 : brightness;
+}
+
+// Reverse the bits of a byte (turns a frame counter into a well-spread dither threshold sequence)
+uint8_t MidiLeds::reverse8(uint8_t value) {
+    value = (value >> 4) | (value << 4);
+    value = ((value & 0xCC) >> 2) | ((value & 0x33) << 2);
+    return ((value & 0xAA) >> 1) | ((value & 0x55) << 1);
+}
+
+// Build a table from envelope levels (upper 8 bits) to brightness scales with a gamma curve (1.0 is linear)
+void MidiLeds::buildBrightnessTable(uint8_t *table, float gamma) {
+    for (size_t i=0; i<256; i++)
+        table[i] = gamma == 1.0f ? i : round(powf(i / 255.0f, gamma) * 0xFF);
+}
+
+// Build the inverse of a brightness table (lowest level, upper 8 bits, whose table entry reaches each value)
+void MidiLeds::buildLevelTable(uint8_t *levelTable, const uint8_t *table) {
+    uint8_t level = 0;
+    for (size_t entry=0; entry<256; entry++) {
+        while (level < 0xFF && table[level] < entry)
+            level++;
+        levelTable[entry] = level;
+    }
+}
+
+// Scale an 8-bit value by the brightness of an envelope level (Q16) using a brightness table
+uint8_t MidiLeds::scaleBrightness(const uint8_t *table, uint16_t level, uint8_t value) {
+    return ((uint16_t)table[level >> 8] * (value + 1)) >> 8;
+}
+
+// Build a table from envelope levels (upper 8 bits) to 16-bit brightness scales with a gamma curve (1.0 is linear)
+void MidiLeds::buildBrightnessTable16(uint16_t *table, float gamma) {
+    for (size_t i=0; i<256; i++)
+        table[i] = gamma == 1.0f ? i * 0x0101 : round(powf(i / 255.0f, gamma) * 0xFFFF);
+}
+
+// Scale an 8-bit value by the 16-bit brightness of an envelope level (Q16) using a 16-bit brightness table
+// Levels are interpolated between table entries (entry i is the level i / 255)
+uint16_t MidiLeds::scaleBrightness16(const uint16_t *table, uint16_t level, uint8_t value) {
+    uint16_t position = ((uint32_t)level * 0xFF) >> 8; // Entry index (upper 8 bits, never 0xFF) and fraction
+    uint32_t brightness = table[position >> 8];
+    uint16_t weight = (position & 0xFF) + ((position & 0xFF) >> 7); // 0..256 so the top level is exact
+    brightness += ((uint32_t)(table[(position >> 8) + 1] - table[position >> 8]) * weight) >> 8;
+    return (brightness * (value + 1)) >> 8;
+}
+
+// Scale a full-brightness color by a 16-bit brightness, rounding each component up if its fraction
+// (8 bits) is above a dither threshold (a threshold sequence uniform in 0..255 gives the exact average)
+struct CRGB MidiLeds::ditherColor(struct CRGB color, uint16_t brightness, uint8_t threshold) {
+    uint16_t r = ((uint32_t)color.r * (brightness + 1)) >> 8;
+    uint16_t g = ((uint32_t)color.g * (brightness + 1)) >> 8;
+    uint16_t b = ((uint32_t)color.b * (brightness + 1)) >> 8;
+    return CRGB((r >> 8) + ((r & 0xFF) > threshold), (g >> 8) + ((g & 0xFF) > threshold), (b >> 8) + ((b & 0xFF) > threshold));
 }
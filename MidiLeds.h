@@ -4,81 +4,259 @@
  * MIDI Leds class - Translates MIDI Note On/Off messages into RGB Leds data.
  * Couple this with MIDI Soft/Damper/Sostenuto Pedals and get accurate looking lights.
  *
+ * By default there is one envelope per LED. With useVoices(), notes are instead given envelopes
+ * from a fixed pool of voices (stolen using a MidiVoicePool policy when all are in use), so that
+ * memory depends on the polyphony rather than on the number of LEDs.
+ *
+ * Each sounding note keeps its full-brightness RGB color (converted once at Note On), so rendering
+ * a frame only scales it by a brightness looked up from the envelope level in a 256-entry table
+ * (which also applies the gamma curve).
+ * LEDs are one per note in the LEDs array, or any LEDs of any buffers with useOutputMap().
+ *
+ * With setDithering(), brightness is instead kept with 16 bits (a 16-bit gamma table interpolated
+ * between envelope levels) and the fraction below 8 bits is spread over consecutive ticks using a
+ * deterministic temporal dither, so slow fades do not visibly step at low brightness. Dithered
+ * notes are only rendered on every tick while their envelope is fading: at a constant level (e.g.
+ * sustain) they are rounded once to the nearest color and sleep until their next Note On/Off.
+ *
+ * Notes are evaluated lazily: after each update, a note sleeps until the time its brightness can
+ * next change (a brightness step or a phase boundary), and sustaining notes sleep until their
+ * next Note On/Off. The levels of the neighbouring brightness steps are looked up in an inverse of
+ * the brightness table, rebuilt along with it. Ticks only visit notes that are due, and return early
+ * if none is.
+ * Times are microsecond timestamps (e.g. micros()) that may wrap around, while envelope parameter
+ * times are set in ms. Notes started or released without a time begin their phase on the next tick.
+ *
+ * Envelopes can respond to the Note On velocity with setVelocityToAttack(), setVelocityToDecay() and
+ * setVelocityToSustain(): an amount of 1.0 doubles the parameter at velocity 127 and zeroes it near
+ * velocity 1 (velocity 64 plays it as set, negative amounts invert). While any amount is set, the
+ * envelopes use one parameter group per 8 velocities (17 groups, rounded so that velocities 64 and
+ * 127 are exact), precomputed when parameters change, so a Note On only selects its group. The groups
+ * are allocated by the first setter with a non-zero amount (not by ticks) and kept afterwards.
+ *
+ * Parameter setters only record the new values, so any number of changes between two ticks (e.g. a
+ * controller knob sweep) are applied once on the next tick. Sounding notes are then recolored in
+ * place from their Note On velocity without restarting their envelopes, and LEDs of idle notes are
+ * set to their color at the base brightness. After changing what a custom color mapper or custom
+ * note color map returns, updateColors() recolors the notes the same way.
+ *
  * Hugo Hromic - http://github.com/hhromic
  * MIT license
  */
 
 #include <cinttypes>
-#include <Arduino.h>
+#include <MidiLedsCompat.h>
 #include <pixeltypes.h>
-#include <AdsrEnvelope.h>
+#include <AdsrEnvelopeBank.h>
+#include <MidiVoicePool.h>
 #include <MidiColorMapper.h>
 #include <MidiNoteColors.h>
+#include <MidiLedsOutputMap.h>
 
 class MidiLeds {
     public:
         MidiLeds();
+        ~MidiLeds();
 
         // Configuration
         void useLeds(struct CRGB *leds, uint8_t noteMin, uint8_t noteMax);
+        void useOutputMap(MidiLedsOutputMap *outputMap);
+        void useVoices(uint8_t polyphony);
+        uint8_t getPolyphony(void);
+        MidiVoicePool::StealPolicies getStealPolicy(void);
+        void setStealPolicy(MidiVoicePool::StealPolicies stealPolicy);
+        bool getDithering(void);
+        void setDithering(bool state);
 
         // Parameter getters
         unsigned long getAttackTime(void);
         unsigned long getDecayTime(void);
         float getSustainLevel(void);
         unsigned long getReleaseTime(void);
+        AdsrEnvelopeBank::Curves getAttackCurve(void);
+        AdsrEnvelopeBank::Curves getDecayCurve(void);
+        AdsrEnvelopeBank::Curves getReleaseCurve(void);
         MidiColorMapper::Mappers getColorMapper(void);
         MidiNoteColors::Maps getNoteColorMap(void);
+        MidiColorMapper::CustomMapper getCustomColorMapper(void);
         uint8_t getFixedHue(void);
         bool getIgnoreVelocity(void);
         uint8_t getBaseBrightness(void);
+        float getGamma(void);
+        float getVelocityToAttack(void);
+        float getVelocityToDecay(void);
+        float getVelocityToSustain(void);
 
         // Parameter setters
         void setAttackTime(unsigned long attackTime);
         void setDecayTime(unsigned long decayTime);
         void setSustainLevel(float sustainLevel);
         void setReleaseTime(unsigned long releaseTime);
+        void setAttackCurve(AdsrEnvelopeBank::Curves curve);
+        void setDecayCurve(AdsrEnvelopeBank::Curves curve);
+        void setReleaseCurve(AdsrEnvelopeBank::Curves curve);
         void setColorMapper(MidiColorMapper::Mappers colorMapper);
         void setNoteColorMap(MidiNoteColors::Maps noteColorMap);
+        void setCustomColorMapper(MidiColorMapper::CustomMapper customMapper);
         void setFixedHue(uint8_t hue);
         void setIgnoreVelocity(bool state);
         void setBaseBrightness(uint8_t value);
+        void setGamma(float gamma);
+        void setVelocityToAttack(float amount);
+        void setVelocityToDecay(float amount);
+        void setVelocityToSustain(float amount);
 
         // Event handlers
         void noteOn(uint8_t note, uint8_t velocity);
+        void noteOn(uint8_t note, uint8_t velocity, unsigned long time);
         void noteOff(uint8_t note);
+        void noteOff(uint8_t note, unsigned long time);
+        void notesOff(const uint32_t *notes);
+        void notesOff(const uint32_t *notes, unsigned long time);
         void allLedsOff(void);
+        void updateColors(void);
         void reset(void);
-        void tick(unsigned long time);
+        bool tick(unsigned long time);
+        bool isIdle(void);
+        uint8_t getActiveEnvelopes(void);
+
+        // Change tracking (LED indexes are relative to noteMin, one per note with an output map)
+        bool isChanged(void);
+        bool isLedDirty(uint8_t index);
+        void clearDirty(void);
+
+        // Brightness helpers
+        static void buildBrightnessTable(uint8_t *table, float gamma);
+        static uint8_t scaleBrightness(const uint8_t *table, uint16_t level, uint8_t value);
+        static void buildBrightnessTable16(uint16_t *table, float gamma);
+        static uint16_t scaleBrightness16(const uint16_t *table, uint16_t level, uint8_t value);
+        static struct CRGB ditherColor(struct CRGB color, uint16_t brightness, uint8_t threshold);
+
     private:
         uint8_t noteMin;
         uint8_t noteMax;
         struct CRGB *leds;
-        struct CHSV hsvData[128];
-        AdsrEnvelope adsrEnvelopes[128];
+        MidiLedsOutputMap *outputMap;
+        uint32_t activeNotes[4];
+        uint32_t dirtyLeds[4];
+        uint32_t sleepingNotes[4]; // Active notes not due until their wake time
+        uint32_t holdingNotes[4];  // Active notes not due until their next Note On/Off
+        unsigned long nextWakeTime;
+        struct MidiLedsNoteData {
+            struct CRGB color;      // Full-brightness color
+            uint8_t value;          // Mapped brightness (velocity scaled)
+            uint8_t velocity;       // Note On velocity (to recolor the note)
+            unsigned long wakeTime; // Time its brightness can next change (us)
+        } *noteData;
+        uint8_t brightnessTable[256];
+        uint8_t levelTable[256];     // Inverse of the brightness table (to find brightness steps)
+        uint16_t *brightnessTable16; // Only allocated when dithering
+        uint8_t ditherFrame;
+        AdsrEnvelopeBank adsrEnvelopes;
+        MidiVoicePool voicePool;
+        void resizeSlots(void);
+        int16_t slotOf(uint8_t note);
+        int16_t startNote(uint8_t note, uint8_t velocity);
+        void wakeNote(uint8_t note);
+        void wakeAll(void);
+        void sleepNote(uint8_t note, uint8_t slot);
+        uint8_t brightnessOf(uint8_t slot, uint16_t level);
+        uint16_t levelOf(uint8_t slot, uint16_t brightness);
+        static void buildLevelTable(uint8_t *levelTable, const uint8_t *table);
+        uint16_t brightness16Of(uint8_t slot, uint16_t level);
+        static uint8_t reverse8(uint8_t value);
+        bool writeLed(uint8_t note, const struct CRGB &color);
         MidiColorMapper midiColorMapper;
         struct MidiLedsParameters {
             unsigned long attackTime;
             unsigned long decayTime;
             float sustainLevel;
             unsigned long releaseTime;
+            AdsrEnvelopeBank::Curves attackCurve;
+            AdsrEnvelopeBank::Curves decayCurve;
+            AdsrEnvelopeBank::Curves releaseCurve;
             MidiColorMapper::Mappers colorMapper;
             MidiNoteColors::Maps noteColorMap;
+            MidiColorMapper::CustomMapper customColorMapper;
             uint8_t fixedHue;
             bool ignoreVelocity;
             uint8_t baseBrightness;
+            float gamma;
+            float velocityToAttack;
+            float velocityToDecay;
+            float velocityToSustain;
         } parameters;
+        bool envelopesChanged;        // Envelope parameters changed since the last tick
+        bool colorsChanged;           // Color/brightness parameters changed since the last tick
+        uint8_t backgroundBrightness; // Base brightness of the LEDs of idle notes
+        bool applyChanges(void);
+        void applyEnvelopes(void);
         const struct MidiLedsParameters DEFAULTS = {
             .attackTime = 80U,
             .decayTime = 3000U,
             .sustainLevel = 0.0,
             .releaseTime = 400U,
+            .attackCurve = AdsrEnvelopeBank::LINEAR,
+            .decayCurve = AdsrEnvelopeBank::LINEAR,
+            .releaseCurve = AdsrEnvelopeBank::LINEAR,
             .colorMapper = MidiColorMapper::COLOR_MAP,
             .noteColorMap = MidiNoteColors::NEWTON_1704,
+            .customColorMapper = NULL,
             .fixedHue = 0x00,
             .ignoreVelocity = true,
             .baseBrightness = 0x00,
+            .gamma = 1.0f,
+            .velocityToAttack = 0.0f,
+            .velocityToDecay = 0.0f,
+            .velocityToSustain = 0.0f,
         };
+        static const uint8_t VELOCITY_GROUPS = 17; // Every 8 velocities (so 64 and 127 are exact)
+        bool velocityGroups;                       // Envelopes use one parameter group per velocity group
+        void allocateVelocityGroups(float amount);
+        static uint8_t velocityGroupOf(uint8_t velocity);
+        static float velocityScale(float amount, uint8_t velocity);
+
+        // Non-copyable (owns its note data and brightness table)
+        MidiLeds(const MidiLeds &);
+        MidiLeds &operator=(const MidiLeds &);
+};
+
+// MidiLeds sink for pipelines (sends messages to a MidiLeds instance per MIDI channel at the event time)
+class MidiLedsSink {
+    public:
+        // Class constructor
+        MidiLedsSink() : eventTime(0U) {
+            for (size_t i=0; i<16; i++)
+                midiLeds[i] = NULL;
+        }
+
+        // Set the MidiLeds instance for a MIDI channel (NULL ignores the channel)
+        void setMidiLeds(uint8_t channel, MidiLeds *instance) {
+            midiLeds[channel & 0xF] = instance;
+        }
+
+        // Set the time (us) of the messages being processed
+        void setEventTime(unsigned long time) {
+            eventTime = time;
+        }
+
+        // Process MIDI messages
+        void noteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
+            if (midiLeds[channel & 0xF] != NULL)
+                midiLeds[channel & 0xF]->noteOn(note, velocity, eventTime);
+        }
+        void noteOff(uint8_t channel, uint8_t note, uint8_t velocity) {
+            if (midiLeds[channel & 0xF] != NULL)
+                midiLeds[channel & 0xF]->noteOff(note, eventTime);
+        }
+        void notesOff(uint8_t channel, const uint32_t *notes) {
+            if (midiLeds[channel & 0xF] != NULL)
+                midiLeds[channel & 0xF]->notesOff(notes, eventTime);
+        }
+
+    private:
+        MidiLeds *midiLeds[16];
+        unsigned long eventTime;
 };
 
 #endif
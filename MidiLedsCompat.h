@@ -0,0 +1,33 @@
+#ifndef MIDI_LEDS_COMPAT_H
+#define MIDI_LEDS_COMPAT_H
+/**
+ * MIDI Leds compatibility definitions - Lets the library classes build outside of the Arduino IDE.
+ * On Arduino this simply includes <Arduino.h>, elsewhere (e.g. host-side testing and profiling)
+ * it provides the few Arduino definitions the library uses. Classes using CHSV/CRGB still need
+ * FastLED's <pixeltypes.h> in the include path.
+ *
+ * Hugo Hromic - http://github.com/hhromic
+ * MIT license
+ */
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <cinttypes>
+#include <cstddef>
+#include <cmath>
+
+using std::round;
+
+#ifndef bitRead
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#endif
+#ifndef bitSet
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#endif
+#ifndef bitClear
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+#endif
+#endif
+
+#endif
@@ -0,0 +1,498 @@
+#include <MidiLedsMultiChannel.h>
+
+// Class constructor
+MidiLedsMultiChannel::MidiLedsMultiChannel() {
+    leds = NULL;
+    outputMap = NULL;
+    voiceData = NULL;
+    frame = NULL;
+    backgroundFrame = NULL;
+    setGamma(1.0f);
+    useLeds(NULL, 0x00, 0x7F, 0);
+}
+
+// Class destructor
+MidiLedsMultiChannel::~MidiLedsMultiChannel() {
+    delete[] voiceData;
+    delete[] frame;
+    delete[] backgroundFrame;
+}
+
+// Use LEDs array with given noteMin and noteMax limits and a maximum number of sounding notes (up to 128)
+void MidiLedsMultiChannel::useLeds(struct CRGB *leds, uint8_t noteMin, uint8_t noteMax, uint8_t polyphony) {
+    if (polyphony > 128)
+        polyphony = 128;
+    if (polyphony != voicePool.getPolyphony()) {
+        delete[] voiceData;
+        voiceData = polyphony ? new struct MidiLedsVoiceData[polyphony] : NULL;
+    }
+    voicePool.resize(polyphony);
+    delete[] frame;
+    frame = leds != NULL || outputMap != NULL ? new CRGB[noteMax - noteMin + 1] : NULL;
+    this->leds = leds;
+    this->noteMin = noteMin;
+    this->noteMax = noteMax;
+    adsrEnvelopes.resize(polyphony);
+    adsrEnvelopes.setGroups(16);
+    for (size_t i=0; i<16; i++) {
+        midiColorMapper.setNoteMin(i, noteMin);
+        midiColorMapper.setNoteMax(i, noteMax);
+    }
+    for (size_t i=0; i<4; i++)
+        pendingLeds[i] = 0x00000000;
+    delete[] backgroundFrame; // Rebuilt for the new LEDs by reset()
+    backgroundFrame = NULL;
+    backgroundChannels = 0x0000;
+    recolorChannels = 0x0000;
+    clearDirty();
+    reset();
+}
+
+// Write LEDs through an output map instead of the LEDs array (NULL goes back to the LEDs array)
+void MidiLedsMultiChannel::useOutputMap(MidiLedsOutputMap *outputMap) {
+    this->outputMap = outputMap;
+    if (frame == NULL && outputMap != NULL)
+        frame = new CRGB[noteMax - noteMin + 1];
+}
+
+// Get the maximum number of sounding notes
+uint8_t MidiLedsMultiChannel::getPolyphony(void) {
+    return voicePool.getPolyphony();
+}
+
+// Get the number of voices in use
+uint8_t MidiLedsMultiChannel::getVoicesUsed(void) {
+    return voicePool.getVoicesUsed();
+}
+
+// Get the number of voices in use by a channel
+uint8_t MidiLedsMultiChannel::getVoicesUsed(uint8_t channel) {
+    uint8_t count = 0;
+    for (size_t i=0; i<4; i++) {
+        uint32_t voices = voicePool.getActiveVoices()[i];
+        while (voices) {
+            uint8_t voice = i * 32 + __builtin_ctz(voices);
+            voices &= voices - 1;
+            if (voicePool.getChannel(voice) == (channel & 0xF))
+                count++;
+        }
+    }
+    return count;
+}
+
+// Get the voice stealing policy
+MidiVoicePool::StealPolicies MidiLedsMultiChannel::getStealPolicy(void) {
+    return voicePool.getStealPolicy();
+}
+
+// Set the voice stealing policy (used when a Note On message arrives and all voices are in use)
+void MidiLedsMultiChannel::setStealPolicy(MidiVoicePool::StealPolicies stealPolicy) {
+    voicePool.setStealPolicy(stealPolicy);
+}
+
+// Get the gamma curve of LED brightness (shared by all channels)
+float MidiLedsMultiChannel::getGamma(void) {
+    return gamma;
+}
+
+// Set the gamma curve of LED brightness (shared by all channels, 1.0 is linear)
+void MidiLedsMultiChannel::setGamma(float gamma) {
+    this->gamma = gamma;
+    MidiLeds::buildBrightnessTable(brightnessTable, gamma);
+}
+
+// Parameter getters
+unsigned long MidiLedsMultiChannel::getAttackTime(uint8_t channel) { return parameters[channel & 0xF].attackTime; }
+unsigned long MidiLedsMultiChannel::getDecayTime(uint8_t channel) { return parameters[channel & 0xF].decayTime; }
+float MidiLedsMultiChannel::getSustainLevel(uint8_t channel) { return parameters[channel & 0xF].sustainLevel; }
+unsigned long MidiLedsMultiChannel::getReleaseTime(uint8_t channel) { return parameters[channel & 0xF].releaseTime; }
+AdsrEnvelopeBank::Curves MidiLedsMultiChannel::getAttackCurve(uint8_t channel) { return parameters[channel & 0xF].attackCurve; }
+AdsrEnvelopeBank::Curves MidiLedsMultiChannel::getDecayCurve(uint8_t channel) { return parameters[channel & 0xF].decayCurve; }
+AdsrEnvelopeBank::Curves MidiLedsMultiChannel::getReleaseCurve(uint8_t channel) { return parameters[channel & 0xF].releaseCurve; }
+MidiColorMapper::Mappers MidiLedsMultiChannel::getColorMapper(uint8_t channel) { return parameters[channel & 0xF].colorMapper; }
+MidiNoteColors::Maps MidiLedsMultiChannel::getNoteColorMap(uint8_t channel) { return parameters[channel & 0xF].noteColorMap; }
+MidiColorMapper::CustomMapper MidiLedsMultiChannel::getCustomColorMapper(uint8_t channel) { return parameters[channel & 0xF].customColorMapper; }
+uint8_t MidiLedsMultiChannel::getFixedHue(uint8_t channel) { return parameters[channel & 0xF].fixedHue; }
+bool MidiLedsMultiChannel::getIgnoreVelocity(uint8_t channel) { return parameters[channel & 0xF].ignoreVelocity; }
+uint8_t MidiLedsMultiChannel::getBaseBrightness(uint8_t channel) { return parameters[channel & 0xF].baseBrightness; }
+MidiLedsMultiChannel::BlendModes MidiLedsMultiChannel::getBlendMode(uint8_t channel) { return parameters[channel & 0xF].blendMode; }
+
+// Parameter setters
+void MidiLedsMultiChannel::setAttackTime(uint8_t channel, unsigned long attackTime) {
+    parameters[channel & 0xF].attackTime = attackTime;
+    adsrEnvelopes.setAttackTime(channel & 0xF, attackTime);
+}
+void MidiLedsMultiChannel::setDecayTime(uint8_t channel, unsigned long decayTime) {
+    parameters[channel & 0xF].decayTime = decayTime;
+    adsrEnvelopes.setDecayTime(channel & 0xF, decayTime);
+}
+void MidiLedsMultiChannel::setSustainLevel(uint8_t channel, float sustainLevel) {
+    parameters[channel & 0xF].sustainLevel = sustainLevel;
+    adsrEnvelopes.setSustainLevel(channel & 0xF, sustainLevel);
+}
+void MidiLedsMultiChannel::setReleaseTime(uint8_t channel, unsigned long releaseTime) {
+    parameters[channel & 0xF].releaseTime = releaseTime;
+    adsrEnvelopes.setReleaseTime(channel & 0xF, releaseTime);
+}
+void MidiLedsMultiChannel::setAttackCurve(uint8_t channel, AdsrEnvelopeBank::Curves curve) {
+    parameters[channel & 0xF].attackCurve = curve;
+    adsrEnvelopes.setAttackCurve(channel & 0xF, curve);
+}
+void MidiLedsMultiChannel::setDecayCurve(uint8_t channel, AdsrEnvelopeBank::Curves curve) {
+    parameters[channel & 0xF].decayCurve = curve;
+    adsrEnvelopes.setDecayCurve(channel & 0xF, curve);
+}
+void MidiLedsMultiChannel::setReleaseCurve(uint8_t channel, AdsrEnvelopeBank::Curves curve) {
+    parameters[channel & 0xF].releaseCurve = curve;
+    adsrEnvelopes.setReleaseCurve(channel & 0xF, curve);
+}
+void MidiLedsMultiChannel::setColorMapper(uint8_t channel, MidiColorMapper::Mappers colorMapper) {
+    parameters[channel & 0xF].colorMapper = colorMapper;
+    midiColorMapper.setMapper(channel & 0xF, colorMapper);
+    bitSet(recolorChannels, channel & 0xF);
+    updateBackground(channel);
+}
+void MidiLedsMultiChannel::setNoteColorMap(uint8_t channel, MidiNoteColors::Maps noteColorMap) {
+    parameters[channel & 0xF].noteColorMap = noteColorMap;
+    midiColorMapper.setNoteColorMap(channel & 0xF, noteColorMap);
+    bitSet(recolorChannels, channel & 0xF);
+    updateBackground(channel);
+}
+void MidiLedsMultiChannel::setCustomColorMapper(uint8_t channel, MidiColorMapper::CustomMapper customMapper) {
+    parameters[channel & 0xF].customColorMapper = customMapper;
+    midiColorMapper.setCustomMapper(channel & 0xF, customMapper);
+    bitSet(recolorChannels, channel & 0xF);
+    updateBackground(channel);
+}
+void MidiLedsMultiChannel::setFixedHue(uint8_t channel, uint8_t hue) {
+    parameters[channel & 0xF].fixedHue = hue;
+    midiColorMapper.setFixedHue(channel & 0xF, hue);
+    bitSet(recolorChannels, channel & 0xF);
+    updateBackground(channel);
+}
+void MidiLedsMultiChannel::setIgnoreVelocity(uint8_t channel, bool state) {
+    parameters[channel & 0xF].ignoreVelocity = state;
+    midiColorMapper.setIgnoreVelocity(channel & 0xF, state);
+    bitSet(recolorChannels, channel & 0xF);
+}
+void MidiLedsMultiChannel::setBaseBrightness(uint8_t channel, uint8_t value) {
+    parameters[channel & 0xF].baseBrightness = value;
+    updateBackground(channel);
+}
+void MidiLedsMultiChannel::setBlendMode(uint8_t channel, BlendModes blendMode) {
+    parameters[channel & 0xF].blendMode = blendMode;
+    updateBackground(channel);
+}
+
+// Process a Note On message (its envelope starts on the next tick)
+void MidiLedsMultiChannel::noteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
+    int16_t voice = startVoice(channel, note, velocity);
+    if (voice >= 0)
+        adsrEnvelopes.noteOn(voice);
+}
+
+// Process a Note On message that arrived at a given time (us)
+void MidiLedsMultiChannel::noteOn(uint8_t channel, uint8_t note, uint8_t velocity, unsigned long time) {
+    int16_t voice = startVoice(channel, note, velocity);
+    if (voice >= 0)
+        adsrEnvelopes.noteOn(voice, time);
+}
+
+// Allocate and color the voice of a Note On message (returns -1 for notes out of range)
+int16_t MidiLedsMultiChannel::startVoice(uint8_t channel, uint8_t note, uint8_t velocity) {
+    if (voicePool.getPolyphony() == 0 || note < noteMin || note > noteMax)
+        return -1;
+    int16_t voice = voicePool.allocateVoice(channel, note);
+    if (voice < 0) { // All voices in use, steal one
+        freeVoice(voicePool.stealVoice(adsrEnvelopes));
+        voice = voicePool.allocateVoice(channel, note);
+    }
+    struct CHSV color = midiColorMapper.map(channel & 0xF, note, velocity);
+    voiceData[voice].color = CHSV(color.h, color.s, 0xFF);
+    voiceData[voice].value = color.v;
+    voiceData[voice].velocity = velocity;
+    adsrEnvelopes.setGroup(voice, channel & 0xF);
+    return voice;
+}
+
+// Process a Note Off message
+void MidiLedsMultiChannel::noteOff(uint8_t channel, uint8_t note) {
+    int16_t voice = voicePool.findVoice(channel, note);
+    if (voice >= 0)
+        adsrEnvelopes.noteOff(voice);
+}
+
+// Process a Note Off message that arrived at a given time (us)
+void MidiLedsMultiChannel::noteOff(uint8_t channel, uint8_t note, unsigned long time) {
+    int16_t voice = voicePool.findVoice(channel, note);
+    if (voice >= 0)
+        adsrEnvelopes.noteOff(voice, time);
+}
+
+// Process a batch of Note Off messages (128-bit notes mask, uint32_t[4])
+void MidiLedsMultiChannel::notesOff(uint8_t channel, const uint32_t *notes) {
+    for (size_t i=0; i<4; i++) {
+        uint32_t voices = voicePool.getActiveVoices()[i];
+        while (voices) { // Only sounding voices need a release
+            uint8_t voice = i * 32 + __builtin_ctz(voices);
+            voices &= voices - 1;
+            if (voicePool.getChannel(voice) == (channel & 0xF) && bitRead(notes[voicePool.getNote(voice) / 32], voicePool.getNote(voice) % 32))
+                adsrEnvelopes.noteOff(voice);
+        }
+    }
+}
+
+// Process a batch of Note Off messages that arrived at a given time (us)
+void MidiLedsMultiChannel::notesOff(uint8_t channel, const uint32_t *notes, unsigned long time) {
+    for (size_t i=0; i<4; i++) {
+        uint32_t voices = voicePool.getActiveVoices()[i];
+        while (voices) { // Only sounding voices need a release
+            uint8_t voice = i * 32 + __builtin_ctz(voices);
+            voices &= voices - 1;
+            if (voicePool.getChannel(voice) == (channel & 0xF) && bitRead(notes[voicePool.getNote(voice) / 32], voicePool.getNote(voice) % 32))
+                adsrEnvelopes.noteOff(voice, time);
+        }
+    }
+}
+
+// Turn off all Leds of all channels
+void MidiLedsMultiChannel::allLedsOff(void) {
+    adsrEnvelopes.allOff();
+}
+
+// Turn off all Leds of a channel
+void MidiLedsMultiChannel::allLedsOff(uint8_t channel) {
+    for (size_t i=0; i<4; i++) {
+        uint32_t voices = voicePool.getActiveVoices()[i];
+        while (voices) {
+            uint8_t voice = i * 32 + __builtin_ctz(voices);
+            voices &= voices - 1;
+            if (voicePool.getChannel(voice) == (channel & 0xF))
+                adsrEnvelopes.noteOff(voice);
+        }
+    }
+}
+
+// Recolor the voices and background of a channel (e.g. after a custom mapper state or custom map changed)
+void MidiLedsMultiChannel::updateColors(uint8_t channel) {
+    midiColorMapper.refresh(channel & 0xF);
+    bitSet(recolorChannels, channel & 0xF);
+    updateBackground(channel);
+}
+
+// Reset all parameters of all channels to their defaults
+void MidiLedsMultiChannel::reset(void) {
+    for (size_t i=0; i<16; i++)
+        reset(i);
+}
+
+// Reset all parameters of a channel to their defaults
+void MidiLedsMultiChannel::reset(uint8_t channel) {
+    parameters[channel & 0xF] = DEFAULTS;
+    applyParameters(channel & 0xF);
+}
+
+// Apply current parameters of a channel to the color mapper and envelopes
+void MidiLedsMultiChannel::applyParameters(uint8_t channel) {
+    midiColorMapper.setMapper(channel, parameters[channel].colorMapper);
+    midiColorMapper.setNoteColorMap(channel, parameters[channel].noteColorMap);
+    midiColorMapper.setCustomMapper(channel, parameters[channel].customColorMapper);
+    midiColorMapper.setFixedHue(channel, parameters[channel].fixedHue);
+    midiColorMapper.setIgnoreVelocity(channel, parameters[channel].ignoreVelocity);
+    bitSet(recolorChannels, channel);
+    adsrEnvelopes.setAttackTime(channel, parameters[channel].attackTime);
+    adsrEnvelopes.setSustainLevel(channel, parameters[channel].sustainLevel);
+    adsrEnvelopes.setDecayTime(channel, parameters[channel].decayTime);
+    adsrEnvelopes.setReleaseTime(channel, parameters[channel].releaseTime);
+    adsrEnvelopes.setAttackCurve(channel, parameters[channel].attackCurve);
+    adsrEnvelopes.setDecayCurve(channel, parameters[channel].decayCurve);
+    adsrEnvelopes.setReleaseCurve(channel, parameters[channel].releaseCurve);
+    updateBackground(channel);
+}
+
+// Process a clock tick (renders all channels in a single pass, only visits sounding voices)
+// Returns true if any LED was changed
+bool MidiLedsMultiChannel::tick(unsigned long time) {
+    if (recolorChannels != 0x0000) { // Colors changed since the last tick?
+        recolorVoices(recolorChannels);
+        recolorChannels = 0x0000;
+    }
+    if (frame == NULL || isIdle()) // Nothing to do?
+        return false;
+
+    // Start with the LEDs that need to be rendered again regardless of voices
+    uint32_t touched[4];
+    for (size_t i=0; i<4; i++) {
+        touched[i] = pendingLeds[i];
+        pendingLeds[i] = 0x00000000;
+        uint32_t indexes = touched[i];
+        while (indexes) {
+            uint8_t index = i * 32 + __builtin_ctz(indexes);
+            indexes &= indexes - 1;
+            frame[index] = background(index);
+        }
+    }
+
+    // Bucket the sounding voices by channel in a single pass (lists keep ascending voice order)
+    uint8_t firstVoice[16], nextVoice[128];
+    for (size_t c=0; c<16; c++)
+        firstVoice[c] = NO_VOICE;
+    for (size_t i=4; i--;) {
+        uint32_t voices = voicePool.getActiveVoices()[i];
+        while (voices) { // Highest voices first, as they are pushed to the front
+            uint8_t voice = i * 32 + 31 - __builtin_clz(voices);
+            bitClear(voices, voice % 32);
+            uint8_t channel = voicePool.getChannel(voice);
+            nextVoice[voice] = firstVoice[channel];
+            firstVoice[channel] = voice;
+        }
+    }
+
+    // Composite all sounding voices in reverse channel order
+    for (size_t c=0; c<16; c++) {
+        uint8_t channel = 15 - c;
+        for (uint8_t voice=firstVoice[channel]; voice!=NO_VOICE; voice=nextVoice[voice]) {
+            uint8_t index = voicePool.getNote(voice) - noteMin;
+            if (!bitRead(touched[index / 32], index % 32)) { // First voice on this LED?
+                bitSet(touched[index / 32], index % 32);
+                frame[index] = background(index);
+            }
+            if (adsrEnvelopes.tick(voice, time)) {
+                if (adsrEnvelopes.isIdle(voice)) { // Envelope finished? (leaves the LED to other channels)
+                    freeVoice(voice);
+                    continue;
+                }
+                uint8_t brightness = MidiLeds::scaleBrightness(brightnessTable, adsrEnvelopes.getLevel(voice), voiceData[voice].value);
+                if (brightness < parameters[channel].baseBrightness)
+                    brightness = parameters[channel].baseBrightness;
+                struct CRGB color = voiceData[voice].color;
+                color.nscale8(brightness);
+                blend(frame[index], color, parameters[channel].blendMode);
+            }
+            else // Envelope already idle
+                freeVoice(voice);
+        }
+    }
+
+    // Write all rendered LEDs
+    bool changed = false;
+    for (size_t i=0; i<4; i++) {
+        uint32_t indexes = touched[i];
+        while (indexes) {
+            uint8_t index = i * 32 + __builtin_ctz(indexes);
+            indexes &= indexes - 1;
+            if (outputMap != NULL) {
+                if (!outputMap->write(noteMin + index, frame[index]))
+                    continue;
+            }
+            else if (leds != NULL && leds[index] != frame[index])
+                leds[index] = frame[index];
+            else
+                continue;
+            bitSet(dirtyLeds[i], index % 32);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// Test if no voices are sounding (no LEDs will change until the next Note On message or parameter change)
+bool MidiLedsMultiChannel::isIdle(void) {
+    return !(voicePool.getVoicesUsed() | pendingLeds[0] | pendingLeds[1] | pendingLeds[2] | pendingLeds[3]);
+}
+
+// Test if any LED was changed since the last clearDirty()
+bool MidiLedsMultiChannel::isChanged(void) {
+    return dirtyLeds[0] | dirtyLeds[1] | dirtyLeds[2] | dirtyLeds[3];
+}
+
+// Test if an LED was changed since the last clearDirty()
+bool MidiLedsMultiChannel::isLedDirty(uint8_t index) {
+    return bitRead(dirtyLeds[(index & 0x7F) / 32], (index & 0x7F) % 32);
+}
+
+// Clear all LED changed flags (e.g. after showing the LEDs)
+void MidiLedsMultiChannel::clearDirty(void) {
+    for (size_t i=0; i<4; i++)
+        dirtyLeds[i] = 0x00000000;
+}
+
+// Return a voice to the pool (if stolen while sounding, its LED is rendered again on the next tick)
+void MidiLedsMultiChannel::freeVoice(uint8_t voice) {
+    uint8_t index = voicePool.getNote(voice) - noteMin;
+    voicePool.freeVoice(voice);
+    if (!adsrEnvelopes.isIdle(voice))
+        bitSet(pendingLeds[index / 32], index % 32);
+}
+
+// Recolor the sounding voices of some channels in place (16-bit channels mask, envelopes continue)
+void MidiLedsMultiChannel::recolorVoices(uint16_t channels) {
+    for (size_t i=0; i<4; i++) {
+        uint32_t voices = voicePool.getActiveVoices()[i];
+        while (voices) {
+            uint8_t voice = i * 32 + __builtin_ctz(voices);
+            voices &= voices - 1;
+            uint8_t channel = voicePool.getChannel(voice);
+            if (!bitRead(channels, channel))
+                continue;
+            struct CHSV color = midiColorMapper.map(channel, voicePool.getNote(voice), voiceData[voice].velocity);
+            voiceData[voice].color = CHSV(color.h, color.s, 0xFF);
+            voiceData[voice].value = color.v;
+        }
+    }
+}
+
+// Rebuild the background colors and render all LEDs again on the next tick if a channel background layer changed
+void MidiLedsMultiChannel::updateBackground(uint8_t channel) {
+    bool visible = parameters[channel & 0xF].baseBrightness > 0;
+    if (!visible && !bitRead(backgroundChannels, channel & 0xF))
+        return;
+    if (visible)
+        bitSet(backgroundChannels, channel & 0xF);
+    else
+        bitClear(backgroundChannels, channel & 0xF);
+    if (backgroundChannels == 0x0000) { // No background layers left?
+        delete[] backgroundFrame;
+        backgroundFrame = NULL;
+    }
+    else {
+        if (backgroundFrame == NULL)
+            backgroundFrame = new CRGB[noteMax - noteMin + 1];
+        for (size_t i=0; i<=(size_t)(noteMax - noteMin); i++) { // Composite all channel background layers
+            backgroundFrame[i] = CRGB(0, 0, 0);
+            for (size_t c=0; c<16; c++) {
+                uint8_t layer = 15 - c;
+                if (!bitRead(backgroundChannels, layer))
+                    continue;
+                struct CHSV noteColor = midiColorMapper.map(layer, noteMin + i, 0x7F);
+                struct CRGB color = CHSV(noteColor.h, noteColor.s, 0xFF);
+                color.nscale8(parameters[layer].baseBrightness);
+                blend(backgroundFrame[i], color, parameters[layer].blendMode);
+            }
+        }
+    }
+    for (size_t i=0; i<=(size_t)(noteMax - noteMin); i++)
+        bitSet(pendingLeds[i / 32], i % 32);
+}
+
+// Get the background color of an LED (composite of all channel background layers)
+struct CRGB MidiLedsMultiChannel::background(uint8_t index) {
+    return backgroundFrame != NULL ? backgroundFrame[index] : CRGB(0, 0, 0);
+}
+
+// Blend a color into a target color using a blend mode
+void MidiLedsMultiChannel::blend(struct CRGB &target, const struct CRGB &color, BlendModes blendMode) {
+    switch (blendMode) {
+        case PRIORITY:
+            target = color;
+            break;
+        case ADD:
+            target += color;
+            break;
+        case MAX:
+            if (color.r > target.r) target.r = color.r;
+            if (color.g > target.g) target.g = color.g;
+            if (color.b > target.b) target.b = color.b;
+            break;
+    }
+}
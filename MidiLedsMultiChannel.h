@@ -0,0 +1,211 @@
+#ifndef MIDILEDS_MULTI_CHANNEL_H
+#define MIDILEDS_MULTI_CHANNEL_H
+/**
+ * MIDI Leds Multi Channel class - Translates MIDI Note On/Off messages of all 16 MIDI channels into RGB Leds data.
+ * Couple this with MIDI Soft/Damper/Sostenuto Pedals and get accurate looking lights.
+ *
+ * Instead of keeping state for every possible note of every channel, sounding notes are held in a
+ * fixed pool of voices (the polyphony, set in useLeds()). When all voices are in use, a voice is
+ * stolen using the configured MidiVoicePool stealing policy. All channels are rendered in a single tick pass and composited per LED in
+ * reverse channel order using each channel blend mode:
+ *   PRIORITY: replaces what higher channels rendered (lower channels take precedence)
+ *   ADD: adds to what higher channels rendered (saturating)
+ *   MAX: keeps the brightest of each color component
+ * Sounding voices are bucketed by channel once per tick, and voices whose envelope just finished are
+ * not composited (so they never cover higher channels with black).
+ * Channels with a base brightness also render a background layer on all LEDs, composited into a
+ * background frame whenever a background parameter or color changes.
+ * Like MidiLeds, voices keep their full-brightness RGB color and are scaled through a brightness table.
+ * Color parameter changes recolor the sounding voices of their channel once on the next tick.
+ * Times are microsecond timestamps (e.g. micros()) and envelope parameter times are in ms.
+ * MIDI channels are in 0..15 range.
+ *
+ * Hugo Hromic - http://github.com/hhromic
+ * MIT license
+ */
+
+#include <cinttypes>
+#include <MidiLedsCompat.h>
+#include <pixeltypes.h>
+#include <AdsrEnvelopeBank.h>
+#include <MidiVoicePool.h>
+#include <MidiColorMapper.h>
+#include <MidiNoteColors.h>
+#include <MidiLeds.h>
+#include <MidiLedsOutputMap.h>
+
+class MidiLedsMultiChannel {
+    public:
+        // Available blend modes
+        enum BlendModes { PRIORITY, ADD, MAX };
+
+        // Class constructor/destructor
+        MidiLedsMultiChannel();
+        ~MidiLedsMultiChannel();
+
+        // Configuration
+        void useLeds(struct CRGB *leds, uint8_t noteMin, uint8_t noteMax, uint8_t polyphony);
+        void useOutputMap(MidiLedsOutputMap *outputMap);
+        uint8_t getPolyphony(void);
+        uint8_t getVoicesUsed(void);
+        uint8_t getVoicesUsed(uint8_t channel);
+        MidiVoicePool::StealPolicies getStealPolicy(void);
+        void setStealPolicy(MidiVoicePool::StealPolicies stealPolicy);
+        float getGamma(void);
+        void setGamma(float gamma);
+
+        // Parameter getters
+        unsigned long getAttackTime(uint8_t channel);
+        unsigned long getDecayTime(uint8_t channel);
+        float getSustainLevel(uint8_t channel);
+        unsigned long getReleaseTime(uint8_t channel);
+        AdsrEnvelopeBank::Curves getAttackCurve(uint8_t channel);
+        AdsrEnvelopeBank::Curves getDecayCurve(uint8_t channel);
+        AdsrEnvelopeBank::Curves getReleaseCurve(uint8_t channel);
+        MidiColorMapper::Mappers getColorMapper(uint8_t channel);
+        MidiNoteColors::Maps getNoteColorMap(uint8_t channel);
+        MidiColorMapper::CustomMapper getCustomColorMapper(uint8_t channel);
+        uint8_t getFixedHue(uint8_t channel);
+        bool getIgnoreVelocity(uint8_t channel);
+        uint8_t getBaseBrightness(uint8_t channel);
+        BlendModes getBlendMode(uint8_t channel);
+
+        // Parameter setters
+        void setAttackTime(uint8_t channel, unsigned long attackTime);
+        void setDecayTime(uint8_t channel, unsigned long decayTime);
+        void setSustainLevel(uint8_t channel, float sustainLevel);
+        void setReleaseTime(uint8_t channel, unsigned long releaseTime);
+        void setAttackCurve(uint8_t channel, AdsrEnvelopeBank::Curves curve);
+        void setDecayCurve(uint8_t channel, AdsrEnvelopeBank::Curves curve);
+        void setReleaseCurve(uint8_t channel, AdsrEnvelopeBank::Curves curve);
+        void setColorMapper(uint8_t channel, MidiColorMapper::Mappers colorMapper);
+        void setNoteColorMap(uint8_t channel, MidiNoteColors::Maps noteColorMap);
+        void setCustomColorMapper(uint8_t channel, MidiColorMapper::CustomMapper customMapper);
+        void setFixedHue(uint8_t channel, uint8_t hue);
+        void setIgnoreVelocity(uint8_t channel, bool state);
+        void setBaseBrightness(uint8_t channel, uint8_t value);
+        void setBlendMode(uint8_t channel, BlendModes blendMode);
+
+        // Event handlers
+        void noteOn(uint8_t channel, uint8_t note, uint8_t velocity);
+        void noteOn(uint8_t channel, uint8_t note, uint8_t velocity, unsigned long time);
+        void noteOff(uint8_t channel, uint8_t note);
+        void noteOff(uint8_t channel, uint8_t note, unsigned long time);
+        void notesOff(uint8_t channel, const uint32_t *notes);
+        void notesOff(uint8_t channel, const uint32_t *notes, unsigned long time);
+        void allLedsOff(void);
+        void allLedsOff(uint8_t channel);
+        void updateColors(uint8_t channel);
+        void reset(void);
+        void reset(uint8_t channel);
+        bool tick(unsigned long time);
+        bool isIdle(void);
+
+        // Change tracking (LED indexes are relative to noteMin, one per note with an output map)
+        bool isChanged(void);
+        bool isLedDirty(uint8_t index);
+        void clearDirty(void);
+
+    private:
+        uint8_t noteMin;
+        uint8_t noteMax;
+        struct CRGB *leds;
+        MidiLedsOutputMap *outputMap;
+        uint32_t dirtyLeds[4];
+        uint32_t pendingLeds[4];
+
+        // Voices (voice data arrays are sized to the polyphony)
+        static const uint8_t NO_VOICE = 0xFF;
+        MidiVoicePool voicePool;
+        struct MidiLedsVoiceData {
+            struct CRGB color; // Full-brightness color
+            uint8_t value;     // Mapped brightness (velocity scaled)
+            uint8_t velocity;  // Note On velocity (to recolor the voice)
+        } *voiceData;
+        float gamma;
+        uint8_t brightnessTable[256];
+        AdsrEnvelopeBank adsrEnvelopes;
+
+        // Rendering buffers (one entry per LED, background colors only while a channel has a background layer)
+        struct CRGB *frame;
+        struct CRGB *backgroundFrame;
+
+        // Parameters per MIDI channel (colors are handled by the shared color mapper)
+        MidiColorMapper midiColorMapper;
+        uint16_t backgroundChannels;
+        uint16_t recolorChannels; // Channels with color changes since the last tick
+        struct MidiLedsMultiChannelParameters {
+            unsigned long attackTime;
+            unsigned long decayTime;
+            float sustainLevel;
+            unsigned long releaseTime;
+            AdsrEnvelopeBank::Curves attackCurve;
+            AdsrEnvelopeBank::Curves decayCurve;
+            AdsrEnvelopeBank::Curves releaseCurve;
+            MidiColorMapper::Mappers colorMapper;
+            MidiNoteColors::Maps noteColorMap;
+            MidiColorMapper::CustomMapper customColorMapper;
+            uint8_t fixedHue;
+            bool ignoreVelocity;
+            uint8_t baseBrightness;
+            BlendModes blendMode;
+        } parameters[16];
+        void applyParameters(uint8_t channel);
+        const struct MidiLedsMultiChannelParameters DEFAULTS = {
+            .attackTime = 80U,
+            .decayTime = 3000U,
+            .sustainLevel = 0.0,
+            .releaseTime = 400U,
+            .attackCurve = AdsrEnvelopeBank::LINEAR,
+            .decayCurve = AdsrEnvelopeBank::LINEAR,
+            .releaseCurve = AdsrEnvelopeBank::LINEAR,
+            .colorMapper = MidiColorMapper::COLOR_MAP,
+            .noteColorMap = MidiNoteColors::NEWTON_1704,
+            .customColorMapper = NULL,
+            .fixedHue = 0x00,
+            .ignoreVelocity = true,
+            .baseBrightness = 0x00,
+            .blendMode = PRIORITY,
+        };
+
+        // Internal helpers
+        int16_t startVoice(uint8_t channel, uint8_t note, uint8_t velocity);
+        void freeVoice(uint8_t voice);
+        void recolorVoices(uint16_t channels);
+        void updateBackground(uint8_t channel);
+        struct CRGB background(uint8_t index);
+        static void blend(struct CRGB &target, const struct CRGB &color, BlendModes blendMode);
+
+        // Non-copyable (owns its voice data)
+        MidiLedsMultiChannel(const MidiLedsMultiChannel &);
+        MidiLedsMultiChannel &operator=(const MidiLedsMultiChannel &);
+};
+
+// MidiLedsMultiChannel sink for pipelines (sends messages of all MIDI channels at the event time)
+class MidiLedsMultiChannelSink {
+    public:
+        // Class constructor
+        MidiLedsMultiChannelSink(MidiLedsMultiChannel &midiLeds) : midiLeds(midiLeds), eventTime(0U) {}
+
+        // Set the time (us) of the messages being processed
+        void setEventTime(unsigned long time) {
+            eventTime = time;
+        }
+
+        // Process MIDI messages
+        void noteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
+            midiLeds.noteOn(channel, note, velocity, eventTime);
+        }
+        void noteOff(uint8_t channel, uint8_t note, uint8_t velocity) {
+            midiLeds.noteOff(channel, note, eventTime);
+        }
+        void notesOff(uint8_t channel, const uint32_t *notes) {
+            midiLeds.notesOff(channel, notes, eventTime);
+        }
+
+    private:
+        MidiLedsMultiChannel &midiLeds;
+        unsigned long eventTime;
+};
+
+#endif
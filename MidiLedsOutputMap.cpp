@@ -0,0 +1,82 @@
+#include <MidiLedsOutputMap.h>
+
+// Class constructor
+MidiLedsOutputMap::MidiLedsOutputMap() {
+    spans = NULL;
+    maxSpans = 0;
+    clear();
+}
+
+// Class destructor
+MidiLedsOutputMap::~MidiLedsOutputMap() {
+    delete[] spans;
+}
+
+// Allocate room for up to the given number of spans (the map becomes empty)
+void MidiLedsOutputMap::begin(uint16_t maxSpans) {
+    if (maxSpans != this->maxSpans) {
+        delete[] spans;
+        spans = maxSpans ? new struct MidiLedsOutputSpan[maxSpans] : NULL;
+        this->maxSpans = maxSpans;
+    }
+    clear();
+}
+
+// Remove all spans
+void MidiLedsOutputMap::clear(void) {
+    for (size_t i=0; i<=128; i++)
+        firstSpans[i] = 0;
+}
+
+// Add a span of LEDs of a buffer to a note (returns false if there is no room left)
+bool MidiLedsOutputMap::addSpan(uint8_t note, struct CRGB *buffer, uint16_t offset, uint8_t length) {
+    note &= 0x7F;
+    if (getSpans() >= maxSpans || buffer == NULL || length == 0)
+        return false;
+    uint16_t position = firstSpans[note + 1]; // After the last span of the note
+    for (uint16_t i=getSpans(); i>position; i--)
+        spans[i] = spans[i - 1];
+    spans[position] = {.buffer = buffer, .offset = offset, .length = length};
+    for (size_t i=note+1; i<=128; i++)
+        firstSpans[i]++;
+    return true;
+}
+
+// Add a segment of LEDs of a buffer lighting a range of notes with a number of LEDs per note
+// Notes are laid out from the segment offset upwards, or downwards (from the last LED) if reversed
+// Returns false if there is not enough room left for all its spans
+bool MidiLedsOutputMap::addSegment(struct CRGB *buffer, uint16_t offset, uint8_t noteMin, uint8_t noteMax, uint8_t ledsPerNote, bool reversed) {
+    if (noteMin > noteMax || getSpans() + (noteMax - noteMin + 1) > maxSpans)
+        return false;
+    for (uint16_t note=noteMin; note<=noteMax; note++) {
+        uint16_t position = reversed ? noteMax - note : note - noteMin;
+        if (!addSpan(note, buffer, offset + position * ledsPerNote, ledsPerNote))
+            return false;
+    }
+    return true;
+}
+
+// Get the number of spans in the map
+uint16_t MidiLedsOutputMap::getSpans(void) {
+    return firstSpans[128];
+}
+
+// Write the color of a note to all its LEDs (returns true if any LED changed)
+bool MidiLedsOutputMap::write(uint8_t note, const struct CRGB &color) {
+    bool changed = false;
+    for (uint16_t i=firstSpans[note & 0x7F]; i<firstSpans[(note & 0x7F) + 1]; i++) {
+        struct CRGB *led = spans[i].buffer + spans[i].offset;
+        for (size_t j=0; j<spans[i].length; j++, led++) {
+            if (*led != color) {
+                *led = color;
+                changed = true;
+            }
+        }
+    }
+    return changed;
+}
+
+// Test if a note has any LEDs mapped
+bool MidiLedsOutputMap::isMapped(uint8_t note) {
+    return firstSpans[note & 0x7F] != firstSpans[(note & 0x7F) + 1];
+}
@@ -0,0 +1,52 @@
+#ifndef MIDILEDS_OUTPUT_MAP_H
+#define MIDILEDS_OUTPUT_MAP_H
+/**
+ * MIDI Leds Output Map class - Maps each MIDI note to one or more spans of LEDs in any number of
+ * CRGB buffers (e.g. one per parallel output strip), so that MidiLeds and MidiLedsMultiChannel can
+ * write rendered notes straight into the final LED buffers without a remapping pass.
+ *
+ * A span is a run of consecutive LEDs of a buffer lit with the color of its note. Spans can be added
+ * one by one, or for a whole segment of notes with a number of LEDs per note, laid out in note order
+ * or reversed (e.g. for strips running right-to-left). Spans are kept sorted by note in a single
+ * array sized at begin(), so that writing a note only visits its own spans.
+ *
+ * Hugo Hromic - http://github.com/hhromic
+ * MIT license
+ */
+
+#include <cinttypes>
+#include <MidiLedsCompat.h>
+#include <pixeltypes.h>
+
+class MidiLedsOutputMap {
+    public:
+        // Class constructor/destructor
+        MidiLedsOutputMap();
+        ~MidiLedsOutputMap();
+
+        // Configuration
+        void begin(uint16_t maxSpans);
+        void clear(void);
+        bool addSpan(uint8_t note, struct CRGB *buffer, uint16_t offset, uint8_t length);
+        bool addSegment(struct CRGB *buffer, uint16_t offset, uint8_t noteMin, uint8_t noteMax, uint8_t ledsPerNote, bool reversed);
+        uint16_t getSpans(void);
+
+        // Public methods
+        bool write(uint8_t note, const struct CRGB &color);
+        bool isMapped(uint8_t note);
+
+    private:
+        struct MidiLedsOutputSpan {
+            struct CRGB *buffer;
+            uint16_t offset;
+            uint8_t length;
+        } *spans;
+        uint16_t maxSpans;
+        uint16_t firstSpans[129]; // Spans of a note are firstSpans[note] up to firstSpans[note + 1]
+
+        // Non-copyable (owns its spans)
+        MidiLedsOutputMap(const MidiLedsOutputMap &);
+        MidiLedsOutputMap &operator=(const MidiLedsOutputMap &);
+};
+
+#endif
@@ -0,0 +1,148 @@
+#include <MidiLedsStats.h>
+
+// Class constructor
+MidiLedsStats::MidiLedsStats() {
+    reset();
+}
+
+// Count a MIDI event of a channel (0..15) arrived at a given time (ms)
+void MidiLedsStats::countEvent(uint8_t channel, unsigned long time) {
+    updateWindow(time);
+    if (eventCounts[channel & 0xF] < 0xFFFF)
+        eventCounts[channel & 0xF]++;
+}
+
+// Mark the start of a tick (us)
+void MidiLedsStats::beginTick(unsigned long time) {
+    begin(tickTimer, time);
+}
+
+// Mark the end of a tick (us)
+void MidiLedsStats::endTick(unsigned long time) {
+    end(tickTimer, time);
+}
+
+// Mark the start of an LED show (us)
+void MidiLedsStats::beginShow(unsigned long time) {
+    begin(showTimer, time);
+}
+
+// Mark the end of an LED show (us)
+void MidiLedsStats::endShow(unsigned long time) {
+    end(showTimer, time);
+}
+
+// Set the number of notes held by a pedal
+void MidiLedsStats::setHeldNotes(Pedals pedal, uint16_t count) {
+    heldNotes[pedal] = count;
+}
+
+// Set the number of active envelopes of an instance (0..15)
+void MidiLedsStats::setActiveEnvelopes(uint8_t instance, uint16_t count) {
+    activeEnvelopes[instance & 0xF] = count;
+}
+
+// Set the number of skipped frames
+void MidiLedsStats::setSkippedFrames(unsigned long count) {
+    skippedFrames = count;
+}
+
+// Reset all counters
+void MidiLedsStats::reset(void) {
+    windowStart = 0U;
+    for (size_t i=0; i<16; i++) {
+        eventCounts[i] = 0;
+        eventRates[i] = 0;
+        activeEnvelopes[i] = 0;
+    }
+    tickTimer = showTimer = {.start = 0U, .count = 0U, .max = 0U, .total = 0U};
+    heldNotes[DAMPER] = heldNotes[SOSTENUTO] = 0;
+    skippedFrames = 0U;
+}
+
+// Get the events per second of a channel (0..15) in the last complete second before a given time (ms)
+uint16_t MidiLedsStats::getEventRate(uint8_t channel, unsigned long time) {
+    updateWindow(time);
+    return eventRates[channel & 0xF];
+}
+
+// Getters
+uint16_t MidiLedsStats::getHeldNotes(Pedals pedal) { return heldNotes[pedal]; }
+uint16_t MidiLedsStats::getActiveEnvelopes(uint8_t instance) { return activeEnvelopes[instance & 0xF]; }
+unsigned long MidiLedsStats::getTickCount(void) { return tickTimer.count; }
+unsigned long MidiLedsStats::getMaxTickTime(void) { return tickTimer.max; }
+unsigned long MidiLedsStats::getAverageTickTime(void) { return average(tickTimer); }
+unsigned long MidiLedsStats::getShowCount(void) { return showTimer.count; }
+unsigned long MidiLedsStats::getMaxShowTime(void) { return showTimer.max; }
+unsigned long MidiLedsStats::getAverageShowTime(void) { return average(showTimer); }
+unsigned long MidiLedsStats::getSkippedFrames(void) { return skippedFrames; }
+
+// Write a SysEx dump of all counters at a given time (ms) into a buffer
+// Returns the size of the dump (SYSEX_SIZE), or 0 if the buffer is too small
+size_t MidiLedsStats::getSysEx(uint8_t *buffer, size_t length, unsigned long time) {
+    if (length < SYSEX_SIZE)
+        return 0;
+    updateWindow(time);
+    uint8_t *data = buffer;
+    *data++ = 0xF0;
+    *data++ = 0x7D; // Non-commercial manufacturer ID
+    *data++ = 'M';
+    *data++ = 'L';
+    *data++ = 'S';
+    *data++ = 0x02; // Dump version
+    for (size_t i=0; i<16; i++)
+        data = encode(data, eventRates[i], 3);
+    data = encode(data, heldNotes[DAMPER], 3);
+    data = encode(data, heldNotes[SOSTENUTO], 3);
+    for (size_t i=0; i<16; i++)
+        data = encode(data, activeEnvelopes[i], 3);
+    data = encode(data, tickTimer.count, 5);
+    data = encode(data, tickTimer.max, 5);
+    data = encode(data, average(tickTimer), 5);
+    data = encode(data, showTimer.count, 5);
+    data = encode(data, showTimer.max, 5);
+    data = encode(data, average(showTimer), 5);
+    data = encode(data, skippedFrames, 5);
+    *data++ = 0xF7;
+    return data - buffer;
+}
+
+// Close the events window(s) ended before a given time (ms)
+void MidiLedsStats::updateWindow(unsigned long time) {
+    unsigned long elapsed = time - windowStart;
+    if (elapsed < 1000U)
+        return;
+    for (size_t i=0; i<16; i++) {
+        eventRates[i] = elapsed < 2000U ? eventCounts[i] : 0; // No events in the last complete window?
+        eventCounts[i] = 0;
+    }
+    windowStart = time - elapsed % 1000U;
+}
+
+// Mark the start of a timed section
+void MidiLedsStats::begin(struct MidiLedsStatsTimer &timer, unsigned long time) {
+    timer.start = time;
+}
+
+// Mark the end of a timed section and account its duration
+void MidiLedsStats::end(struct MidiLedsStatsTimer &timer, unsigned long time) {
+    unsigned long duration = time - timer.start;
+    if (duration > timer.max)
+        timer.max = duration;
+    timer.total += duration;
+    timer.count++;
+}
+
+// Get the average duration of a timed section
+unsigned long MidiLedsStats::average(const struct MidiLedsStatsTimer &timer) {
+    return timer.count ? timer.total / timer.count : 0U;
+}
+
+// Encode a value into a number of 7-bit bytes (little-endian)
+uint8_t *MidiLedsStats::encode(uint8_t *buffer, unsigned long value, size_t bytes) {
+    for (size_t i=0; i<bytes; i++) {
+        *buffer++ = value & 0x7F;
+        value >>= 7;
+    }
+    return buffer;
+}
@@ -0,0 +1,103 @@
+#ifndef MIDILEDS_STATS_H
+#define MIDILEDS_STATS_H
+/**
+ * MIDI Leds Stats class - Runtime instrumentation counters with a fixed memory cost.
+ * Counts MIDI events per second per channel and the duration of ticks and LED shows, and keeps
+ * snapshots of held pedal notes, active envelopes and skipped frames taken by the caller.
+ * Active envelopes are kept per instance (up to 16, e.g. one MidiLeds per channel, or the voices of
+ * each channel of a MidiLedsMultiChannel), so that a busy channel stands out in the dump.
+ * Counters are read with the getters (e.g. in host tests) or as a SysEx dump (see getSysEx()).
+ *
+ * Instrumentation is compiled out by default: wrap instrumentation statements in MIDI_LEDS_STATS()
+ * and uncomment MIDI_LEDS_INSTRUMENTATION below to compile them in. Durations are in us, and are
+ * totalled with 64 bits so that averages stay valid however long the sketch runs.
+ *
+ * SysEx dump layout (all values little-endian, 7 bits per byte):
+ *   F0 7D 'M' 'L' 'S' version(2)
+ *   events per second per channel (16 x 3 bytes)
+ *   held notes of the damper and sostenuto pedals (2 x 3 bytes)
+ *   active envelopes per instance (16 x 3 bytes)
+ *   tick count, maximum and average duration (3 x 5 bytes)
+ *   show count, maximum and average duration (3 x 5 bytes)
+ *   skipped frames (5 bytes)
+ *   F7
+ *
+ * Hugo Hromic - http://github.com/hhromic
+ * MIT license
+ */
+
+#include <cinttypes>
+#include <MidiLedsCompat.h>
+
+// Uncomment to compile instrumentation statements in
+//#define MIDI_LEDS_INSTRUMENTATION
+
+#ifdef MIDI_LEDS_INSTRUMENTATION
+#define MIDI_LEDS_STATS(statement) statement
+#else
+#define MIDI_LEDS_STATS(statement)
+#endif
+
+class MidiLedsStats {
+    public:
+        // Pedals with held notes
+        enum Pedals { DAMPER, SOSTENUTO };
+
+        // Size of a SysEx dump
+        static const size_t SYSEX_SIZE = 6 + 16 * 3 + 2 * 3 + 16 * 3 + 7 * 5 + 1;
+
+        // Class constructor
+        MidiLedsStats();
+
+        // Counters
+        void countEvent(uint8_t channel, unsigned long time);
+        void beginTick(unsigned long time);
+        void endTick(unsigned long time);
+        void beginShow(unsigned long time);
+        void endShow(unsigned long time);
+        void setHeldNotes(Pedals pedal, uint16_t count);
+        void setActiveEnvelopes(uint8_t instance, uint16_t count);
+        void setSkippedFrames(unsigned long count);
+        void reset(void);
+
+        // Getters
+        uint16_t getEventRate(uint8_t channel, unsigned long time);
+        uint16_t getHeldNotes(Pedals pedal);
+        uint16_t getActiveEnvelopes(uint8_t instance);
+        unsigned long getTickCount(void);
+        unsigned long getMaxTickTime(void);
+        unsigned long getAverageTickTime(void);
+        unsigned long getShowCount(void);
+        unsigned long getMaxShowTime(void);
+        unsigned long getAverageShowTime(void);
+        unsigned long getSkippedFrames(void);
+        size_t getSysEx(uint8_t *buffer, size_t length, unsigned long time);
+
+    private:
+        // Events per second (counted in 1000 ms windows, rates are of the last complete window)
+        unsigned long windowStart;
+        uint16_t eventCounts[16];
+        uint16_t eventRates[16];
+        void updateWindow(unsigned long time);
+
+        // Durations
+        struct MidiLedsStatsTimer {
+            unsigned long start;
+            unsigned long count;
+            unsigned long max;
+            uint64_t total;
+        } tickTimer, showTimer;
+        static void begin(struct MidiLedsStatsTimer &timer, unsigned long time);
+        static void end(struct MidiLedsStatsTimer &timer, unsigned long time);
+        static unsigned long average(const struct MidiLedsStatsTimer &timer);
+
+        // Snapshots
+        uint16_t heldNotes[2];
+        uint16_t activeEnvelopes[16];
+        unsigned long skippedFrames;
+
+        // SysEx encoding helper
+        static uint8_t *encode(uint8_t *buffer, unsigned long value, size_t bytes);
+};
+
+#endif
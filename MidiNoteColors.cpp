@@ -18,7 +18,21 @@ const struct CHSV MidiNoteColors::colorData[13][12] = {
     {CHSV(71, 192, 232), CHSV(104, 224, 144), CHSV(124, 208, 144), CHSV(164, 232, 128), CHSV(193, 240, 128), CHSV(208, 240, 216), CHSV(209, 232, 112), CHSV(1, 248, 160), CHSV(0, 248, 255), CHSV(31, 240, 255), CHSV(65, 112, 248), CHSV(64, 192, 248), }, // ZIEVERINK_2004
 };
 
+// Color data for (4 custom color maps x 12 notes), uploaded at runtime
+struct CHSV MidiNoteColors::customData[4][12];
+
 // Get a MIDI note color using specified color map
 struct CHSV MidiNoteColors::get(Maps map, uint8_t note) {
+    if (map >= CUSTOM_1)
+        return MidiNoteColors::customData[map - CUSTOM_1][note % 12];
     return MidiNoteColors::colorData[map][note % 12];
 }
+
+// Set the 12 note colors (C to B) of a custom color map (returns false if the map is not a custom one)
+bool MidiNoteColors::setCustomMap(Maps map, const struct CHSV *colors) {
+    if (map < CUSTOM_1 || map > CUSTOM_4)
+        return false;
+    for (size_t i=0; i<12; i++)
+        MidiNoteColors::customData[map - CUSTOM_1][i] = colors[i];
+    return true;
+}
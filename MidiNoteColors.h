@@ -2,13 +2,17 @@
 #define MIDI_NOTE_COLORS_H
 /**
  * Note Color Maps - Different color mappings for MIDI notes.
+ * Besides the built-in maps, CUSTOM_1 to CUSTOM_4 are palettes that can be uploaded at runtime
+ * (e.g. received via SysEx) with setCustomMap(), stored in the same 12 colors per map layout.
+ * Custom maps are shared by all mappers and are black until set (set the map again on any
+ * MidiLeds/MidiColorMapper using it to apply an upload).
  *
  * Hugo Hromic - http://github.com/hhromic
  * MIT license
  */
 
 #include <cinttypes>
-#include <Arduino.h>
+#include <MidiLedsCompat.h>
 #include <pixeltypes.h>
 
 class MidiNoteColors {
@@ -28,17 +32,23 @@ class MidiNoteColors {
             SCRIABIN_1911,
             SEEMANN_1881,
             ZIEVERINK_2004,
+            CUSTOM_1,
+            CUSTOM_2,
+            CUSTOM_3,
+            CUSTOM_4,
         };
 
         // Public methods
         static struct CHSV get(Maps map, uint8_t note);
+        static bool setCustomMap(Maps map, const struct CHSV *colors);
 
     private:
         // Class constructor -- no need to instantiate this class
         MidiNoteColors();
 
-        // Color data
+        // Color data (built-in and custom maps)
         const static struct CHSV colorData[13][12];
+        static struct CHSV customData[4][12];
 };
 
 #endif
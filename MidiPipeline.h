@@ -0,0 +1,94 @@
+#ifndef MIDI_PIPELINE_H
+#define MIDI_PIPELINE_H
+/**
+ * MIDI Pipeline class - Composes pedals and a final sink into a MIDI message chain at compile time.
+ * Each stage forwards its processed messages directly to the next stage (no function pointers), so
+ * the compiler can inline the whole chain into a single path. Stages are given by reference, in order:
+ *   MidiPipeline<MidiDamperPedal, MidiSoftPedal, MidiSostenutoPedal, MidiLedsSink>
+ *       pipeline(damperPedal, softPedal, sostenutoPedal, midiLedsSink);
+ * The last stage is the sink and only needs noteOn(), noteOff() and notesOff() methods (MidiLedsSink
+ * and MidiLedsMultiChannelSink are declared next to their engines, in MidiLeds.h and MidiLedsMultiChannel.h).
+ * MIDI channels are in 0..15 range. Pedal press/release must go through the pipeline so that
+ * released notes continue down the chain.
+ *
+ * Hugo Hromic - http://github.com/hhromic
+ * MIT license
+ */
+
+#include <cinttypes>
+#include <type_traits>
+#include <MidiLedsCompat.h>
+
+template <typename... Stages> class MidiPipeline;
+
+// Last stage of a pipeline (the sink)
+template <typename Sink>
+class MidiPipeline<Sink> {
+    public:
+        // Class constructor
+        MidiPipeline(Sink &sink) : sink(sink) {}
+
+        // Process MIDI messages
+        void noteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
+            sink.noteOn(channel, note, velocity);
+        }
+        void noteOff(uint8_t channel, uint8_t note, uint8_t velocity) {
+            sink.noteOff(channel, note, velocity);
+        }
+        void notesOff(uint8_t channel, const uint32_t *notes) {
+            sink.notesOff(channel, notes);
+        }
+
+        // Pedals are never sinks (nothing to do)
+        template <typename Pedal> void press(Pedal &pedal, uint8_t channel) {}
+        template <typename Pedal> void release(Pedal &pedal, uint8_t channel) {}
+
+    private:
+        Sink &sink;
+};
+
+// Intermediate stage of a pipeline (a pedal)
+template <typename Stage, typename... Rest>
+class MidiPipeline<Stage, Rest...> {
+    public:
+        // Class constructor
+        MidiPipeline(Stage &stage, Rest &... rest) : stage(stage), next(rest...) {}
+
+        // Process MIDI messages
+        void noteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
+            stage.noteOn(channel, note, velocity, next);
+        }
+        void noteOff(uint8_t channel, uint8_t note, uint8_t velocity) {
+            stage.noteOff(channel, note, velocity, next);
+        }
+        void notesOff(uint8_t channel, const uint32_t *notes) {
+            stage.notesOff(channel, notes, next);
+        }
+
+        // Emulate a pedal of the pipeline being pressed
+        template <typename Pedal> void press(Pedal &pedal, uint8_t channel) {
+            pedal.press(channel);
+        }
+
+        // Emulate a pedal of the pipeline being released (notes released go to the stage after it)
+        template <typename Pedal> void release(Pedal &pedal, uint8_t channel) {
+            release(pedal, channel, std::is_same<Pedal, Stage>());
+        }
+
+    private:
+        Stage &stage;
+        MidiPipeline<Rest...> next;
+
+        // Find the stage of a pedal by type and then by address
+        template <typename Pedal> void release(Pedal &pedal, uint8_t channel, std::true_type) {
+            if (&pedal == &stage)
+                stage.release(channel, next);
+            else
+                next.release(pedal, channel);
+        }
+        template <typename Pedal> void release(Pedal &pedal, uint8_t channel, std::false_type) {
+            next.release(pedal, channel);
+        }
+};
+
+#endif
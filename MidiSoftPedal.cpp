@@ -5,7 +5,6 @@
 MidiSoftPedal::MidiSoftPedal() {
     softenFactor = 2.0f / 3.0f;
     pressed = 0x0000;
-    handleNoteOn = NULL;
 }
 
 // Get the soften factor to apply to the note velocities
@@ -31,13 +30,10 @@ void MidiSoftPedal::release(uint8_t channel) {
 
 // Process a MIDI Note On message
 void MidiSoftPedal::noteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
-    if (bitRead(pressed, channel & 0xF))
-        handleNoteOn(channel, note, round(velocity * softenFactor));
-    else
-        handleNoteOn(channel, note, velocity);
+    noteOn(channel, note, velocity, handlers);
 }
 
 // Set a handler for processed Note On messages
 void MidiSoftPedal::setHandleNoteOn(void (*fptr)(uint8_t channel, uint8_t note, uint8_t velocity)) {
-    handleNoteOn = fptr;
+    handlers.handleNoteOn = fptr;
 }
@@ -2,13 +2,16 @@
 #define MIDI_SOFT_PEDAL_H
 /**
  * MIDI Soft Pedal class - Emulates a Soft Pedal using Note On messages.
+ * Processed messages go to the runtime handler, or to a next stage when used in a MidiPipeline
+ * (Note Off messages are passed through unchanged).
  *
  * Hugo Hromic - http://github.com/hhromic
  * MIT license
  */
 
 #include <cinttypes>
-#include <Arduino.h>
+#include <MidiLedsCompat.h>
+#include <MidiHandlers.h>
 
 class MidiSoftPedal {
     public:
@@ -25,13 +28,46 @@ class MidiSoftPedal {
         void noteOn(uint8_t channel, uint8_t note, uint8_t velocity);
         void setHandleNoteOn(void (*fptr)(uint8_t channel, uint8_t note, uint8_t velocity));
 
+        // Pipeline stage methods (processed messages go to the next stage)
+        template <typename Next> void release(uint8_t channel, Next &next);
+        template <typename Next> void noteOn(uint8_t channel, uint8_t note, uint8_t velocity, Next &next);
+        template <typename Next> void noteOff(uint8_t channel, uint8_t note, uint8_t velocity, Next &next);
+        template <typename Next> void notesOff(uint8_t channel, const uint32_t *notes, Next &next);
+
     private:
         // Internal bit-wise states and parameters
         float softenFactor;
         uint16_t pressed;
 
         // MIDI message handlers
-        void (*handleNoteOn)(uint8_t channel, uint8_t note, uint8_t velocity);
+        struct MidiHandlers handlers;
 };
 
+// Emulate the pedal being released (nothing to send)
+template <typename Next>
+void MidiSoftPedal::release(uint8_t channel, Next &next) {
+    release(channel);
+}
+
+// Process a MIDI Note On message
+template <typename Next>
+void MidiSoftPedal::noteOn(uint8_t channel, uint8_t note, uint8_t velocity, Next &next) {
+    if (bitRead(pressed, channel & 0xF))
+        next.noteOn(channel, note, round(velocity * softenFactor));
+    else
+        next.noteOn(channel, note, velocity);
+}
+
+// Process a MIDI Note Off message (passed through)
+template <typename Next>
+void MidiSoftPedal::noteOff(uint8_t channel, uint8_t note, uint8_t velocity, Next &next) {
+    next.noteOff(channel, note, velocity);
+}
+
+// Process a batch of MIDI Note Off messages (passed through)
+template <typename Next>
+void MidiSoftPedal::notesOff(uint8_t channel, const uint32_t *notes, Next &next) {
+    next.notesOff(channel, notes);
+}
+
 #endif
@@ -9,8 +9,6 @@ MidiSostenutoPedal::MidiSostenutoPedal() {
             pedalNotes[i][j] = 0x00000000;
             heldNotes[i][j] = 0x00000000;
         }
-    handleNoteOn = NULL;
-    handleNoteOff = NULL;
 }
 
 // Emulate the pedal being pressed
@@ -22,39 +20,45 @@ void MidiSostenutoPedal::press(uint8_t channel) {
 
 // Emulate the pedal being released
 void MidiSostenutoPedal::release(uint8_t channel) {
-    bitClear(pressed, channel & 0xF);
-    for (size_t i=0; i<128; i++) { // Send Note Off messages for all channel held notes
-        bitClear(pedalNotes[channel & 0xF][i / 32], i % 32); // Reset channel pedal notes
-        if (bitRead(heldNotes[channel & 0xF][i / 32], i % 32)) {
-            bitClear(heldNotes[channel & 0xF][i / 32], i % 32);
-            handleNoteOff(channel, i, 0x00);
-        }
-    }
+    release(channel, handlers);
 }
 
 // Process a MIDI Note On message
 void MidiSostenutoPedal::noteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
-    bitSet(prePedalNotes[channel & 0xF][(note & 0x7F) / 32], (note & 0x7F) % 32); // Remember as channel pre-pedal note
-    if (bitRead(pressed, channel & 0xF)) // If pedal pressed, reset channel held note
-        bitClear(heldNotes[channel & 0xF][(note & 0x7F) / 32], (note & 0x7F) % 32);
-    handleNoteOn(channel, note, velocity);
+    noteOn(channel, note, velocity, handlers);
 }
 
 // Process a MIDI Note Off message
 void MidiSostenutoPedal::noteOff(uint8_t channel, uint8_t note, uint8_t velocity) {
-    bitClear(prePedalNotes[channel & 0xF][(note & 0x7F) / 32], (note & 0x7F) % 32); // Reset channel pre-pedal note
-    if (bitRead(pressed, channel & 0xF) && bitRead(pedalNotes[channel & 0xF][(note & 0x7F) / 32], (note & 0x7F) % 32))
-        bitSet(heldNotes[channel & 0xF][(note & 0x7F) / 32], (note & 0x7F) % 32);
-    else
-        handleNoteOff(channel, note, velocity);
+    noteOff(channel, note, velocity, handlers);
+}
+
+// Process a batch of MIDI Note Off messages (128-bit notes mask, uint32_t[4])
+void MidiSostenutoPedal::notesOff(uint8_t channel, const uint32_t *notes) {
+    notesOff(channel, notes, handlers);
+}
+
+// Get the number of notes held by the pedal (all MIDI channels)
+uint16_t MidiSostenutoPedal::getHeldNotes(void) {
+    uint16_t count = 0;
+    for (size_t i=0; i<16; i++)
+        for (size_t j=0; j<4; j++)
+            count += __builtin_popcount(heldNotes[i][j]);
+    return count;
 }
 
 // Set a handler for processed Note On messages
 void MidiSostenutoPedal::setHandleNoteOn(void (*fptr)(uint8_t channel, uint8_t note, uint8_t velocity)) {
-    handleNoteOn = fptr;
+    handlers.handleNoteOn = fptr;
 }
 
 // Set a handler for processed Note Off messages
 void MidiSostenutoPedal::setHandleNoteOff(void (*fptr)(uint8_t channel, uint8_t note, uint8_t velocity)) {
-    handleNoteOff = fptr;
+    handlers.handleNoteOff = fptr;
+}
+
+// Set a handler for batches of processed Note Off messages (128-bit notes mask, uint32_t[4])
+// If set, it is used instead of the Note Off handler when releasing the pedal or processing batches
+void MidiSostenutoPedal::setHandleNotesOff(void (*fptr)(uint8_t channel, const uint32_t *notes)) {
+    handlers.handleNotesOff = fptr;
 }
@@ -2,13 +2,15 @@
 #define MIDI_SOSTENUTO_PEDAL_H
 /**
  * MIDI Sostenuto Pedal class - Emulates a Sostenuto Pedal using Note On/Off messages.
+ * Processed messages go to the runtime handlers, or to a next stage when used in a MidiPipeline.
  *
  * Hugo Hromic - http://github.com/hhromic
  * MIT license
  */
 
 #include <cinttypes>
-#include <Arduino.h>
+#include <MidiLedsCompat.h>
+#include <MidiHandlers.h>
 
 class MidiSostenutoPedal {
     public:
@@ -20,8 +22,17 @@ class MidiSostenutoPedal {
         void release(uint8_t channel);
         void noteOn(uint8_t channel, uint8_t note, uint8_t velocity);
         void noteOff(uint8_t channel, uint8_t note, uint8_t velocity);
+        void notesOff(uint8_t channel, const uint32_t *notes);
+        uint16_t getHeldNotes(void);
         void setHandleNoteOn(void (*fptr)(uint8_t channel, uint8_t note, uint8_t velocity));
         void setHandleNoteOff(void (*fptr)(uint8_t channel, uint8_t note, uint8_t velocity));
+        void setHandleNotesOff(void (*fptr)(uint8_t channel, const uint32_t *notes));
+
+        // Pipeline stage methods (processed messages go to the next stage)
+        template <typename Next> void release(uint8_t channel, Next &next);
+        template <typename Next> void noteOn(uint8_t channel, uint8_t note, uint8_t velocity, Next &next);
+        template <typename Next> void noteOff(uint8_t channel, uint8_t note, uint8_t velocity, Next &next);
+        template <typename Next> void notesOff(uint8_t channel, const uint32_t *notes, Next &next);
 
     private:
         // Internal bit-wise states
@@ -31,8 +42,57 @@ class MidiSostenutoPedal {
         uint32_t heldNotes[16][4];
 
         // MIDI message handlers
-        void (*handleNoteOn)(uint8_t channel, uint8_t note, uint8_t velocity);
-        void (*handleNoteOff)(uint8_t channel, uint8_t note, uint8_t velocity);
+        struct MidiHandlers handlers;
 };
 
+// Emulate the pedal being released (sends a batch of Note Off messages for all channel held notes)
+template <typename Next>
+void MidiSostenutoPedal::release(uint8_t channel, Next &next) {
+    uint32_t notes[4];
+    bitClear(pressed, channel & 0xF);
+    for (size_t i=0; i<4; i++) { // Reset channel pedal notes, take and reset all channel held notes
+        pedalNotes[channel & 0xF][i] = 0x00000000;
+        notes[i] = heldNotes[channel & 0xF][i];
+        heldNotes[channel & 0xF][i] = 0x00000000;
+    }
+    if (notes[0] | notes[1] | notes[2] | notes[3])
+        next.notesOff(channel, notes);
+}
+
+// Process a MIDI Note On message
+template <typename Next>
+void MidiSostenutoPedal::noteOn(uint8_t channel, uint8_t note, uint8_t velocity, Next &next) {
+    bitSet(prePedalNotes[channel & 0xF][(note & 0x7F) / 32], (note & 0x7F) % 32); // Remember as channel pre-pedal note
+    if (bitRead(pressed, channel & 0xF)) // If pedal pressed, reset channel held note
+        bitClear(heldNotes[channel & 0xF][(note & 0x7F) / 32], (note & 0x7F) % 32);
+    next.noteOn(channel, note, velocity);
+}
+
+// Process a MIDI Note Off message
+template <typename Next>
+void MidiSostenutoPedal::noteOff(uint8_t channel, uint8_t note, uint8_t velocity, Next &next) {
+    bitClear(prePedalNotes[channel & 0xF][(note & 0x7F) / 32], (note & 0x7F) % 32); // Reset channel pre-pedal note
+    if (bitRead(pressed, channel & 0xF) && bitRead(pedalNotes[channel & 0xF][(note & 0x7F) / 32], (note & 0x7F) % 32))
+        bitSet(heldNotes[channel & 0xF][(note & 0x7F) / 32], (note & 0x7F) % 32);
+    else
+        next.noteOff(channel, note, velocity);
+}
+
+// Process a batch of MIDI Note Off messages (128-bit notes mask, uint32_t[4])
+template <typename Next>
+void MidiSostenutoPedal::notesOff(uint8_t channel, const uint32_t *notes, Next &next) {
+    uint32_t passed[4];
+    for (size_t i=0; i<4; i++) {
+        prePedalNotes[channel & 0xF][i] &= ~notes[i]; // Reset channel pre-pedal notes
+        if (bitRead(pressed, channel & 0xF)) { // If pedal pressed, hold channel pedal notes
+            heldNotes[channel & 0xF][i] |= notes[i] & pedalNotes[channel & 0xF][i];
+            passed[i] = notes[i] & ~pedalNotes[channel & 0xF][i];
+        }
+        else
+            passed[i] = notes[i];
+    }
+    if (passed[0] | passed[1] | passed[2] | passed[3])
+        next.notesOff(channel, passed);
+}
+
 #endif
@@ -0,0 +1,212 @@
+#include <MidiVoicePool.h>
+
+// Class constructor
+MidiVoicePool::MidiVoicePool() {
+    polyphony = 0;
+    channels = NULL;
+    notes = NULL;
+    serials = NULL;
+    slots = NULL;
+    slotMask = 0;
+    stealPolicy = OLDEST;
+    resize(0);
+}
+
+// Class destructor
+MidiVoicePool::~MidiVoicePool() {
+    resize(0);
+}
+
+// Resize the pool to hold the given number of voices (up to 128, all voices become free)
+void MidiVoicePool::resize(uint8_t polyphony) {
+    if (polyphony > 128)
+        polyphony = 128;
+    if (polyphony != this->polyphony) {
+        delete[] channels;
+        delete[] notes;
+        delete[] serials;
+        delete[] slots;
+        size_t numSlots = 1;
+        while (numSlots < 2 * (size_t)polyphony)
+            numSlots <<= 1;
+        channels = polyphony ? new uint8_t[polyphony] : NULL;
+        notes = polyphony ? new uint8_t[polyphony] : NULL;
+        serials = polyphony ? new uint32_t[polyphony] : NULL;
+        slots = polyphony ? new uint8_t[numSlots] : NULL;
+        slotMask = polyphony ? numSlots - 1 : 0;
+        this->polyphony = polyphony;
+    }
+    freeAll();
+}
+
+// Get the number of voices in the pool
+uint8_t MidiVoicePool::getPolyphony(void) {
+    return polyphony;
+}
+
+// Get the voice stealing policy
+MidiVoicePool::StealPolicies MidiVoicePool::getStealPolicy(void) {
+    return stealPolicy;
+}
+
+// Set the voice stealing policy
+void MidiVoicePool::setStealPolicy(StealPolicies stealPolicy) {
+    this->stealPolicy = stealPolicy;
+}
+
+// Find the voice sounding a channel note (returns -1 if not sounding)
+int16_t MidiVoicePool::findVoice(uint8_t channel, uint8_t note) {
+    if (!bitRead(activeChannels, channel & 0xF))
+        return -1;
+    for (uint16_t slot=slotOf(channel, note); slots[slot]; slot=(slot + 1) & slotMask) {
+        uint8_t voice = slots[slot] - 1;
+        if (channels[voice] == (channel & 0xF) && notes[voice] == (note & 0x7F))
+            return voice;
+    }
+    return -1;
+}
+
+// Allocate a voice for a channel note (the sounding voice if any, else a free voice)
+// Returns -1 if all voices are in use (see stealVoice())
+int16_t MidiVoicePool::allocateVoice(uint8_t channel, uint8_t note) {
+    int16_t voice = findVoice(channel, note);
+    if (voice < 0) {
+        if (used == polyphony)
+            return -1;
+        for (size_t i=0; i<4; i++) // The lowest free voice is always below the polyphony
+            if (~activeVoices[i]) {
+                voice = i * 32 + __builtin_ctz(~activeVoices[i]);
+                break;
+            }
+        channels[voice] = channel & 0xF;
+        notes[voice] = note & 0x7F;
+        bitSet(activeVoices[voice / 32], voice % 32);
+        used++;
+        if (channelVoices[channel & 0xF]++ == 0)
+            bitSet(activeChannels, channel & 0xF);
+        uint16_t slot = slotOf(channel, note);
+        while (slots[slot])
+            slot = (slot + 1) & slotMask;
+        slots[slot] = voice + 1;
+    }
+    serials[voice] = nextSerial++;
+    return voice;
+}
+
+// Choose a voice to steal using the stealing policy and free it (returns the freed voice)
+// The channel and note of the freed voice remain readable until it is allocated again
+uint8_t MidiVoicePool::stealVoice(AdsrEnvelopeBank &envelopes) {
+    int16_t victim = -1;
+    for (size_t i=0; i<4; i++) {
+        uint32_t voices = activeVoices[i];
+        while (voices) {
+            uint8_t voice = i * 32 + __builtin_ctz(voices);
+            voices &= voices - 1;
+            if (victim < 0) {
+                victim = voice;
+                continue;
+            }
+            bool older = nextSerial - serials[voice] > nextSerial - serials[victim];
+            switch (stealPolicy) {
+                case OLDEST:
+                    if (older)
+                        victim = voice;
+                    break;
+                case QUIETEST:
+                    if (envelopes.getLevel(voice) < envelopes.getLevel(victim)
+                        || (envelopes.getLevel(voice) == envelopes.getLevel(victim) && older))
+                        victim = voice;
+                    break;
+                case RELEASED_FIRST:
+                    if (envelopes.isReleased(voice) != envelopes.isReleased(victim)) {
+                        if (envelopes.isReleased(voice))
+                            victim = voice;
+                    }
+                    else if (older)
+                        victim = voice;
+                    break;
+            }
+        }
+    }
+    freeVoice(victim);
+    return victim;
+}
+
+// Return a voice to the pool
+void MidiVoicePool::freeVoice(uint8_t voice) {
+    if (voice >= polyphony || !bitRead(activeVoices[voice / 32], voice % 32))
+        return;
+    bitClear(activeVoices[voice / 32], voice % 32);
+    used--;
+    if (--channelVoices[channels[voice]] == 0)
+        bitClear(activeChannels, channels[voice]);
+
+    // Remove from the index, shifting back following entries of the same probe run
+    uint16_t slot = slotOf(channels[voice], notes[voice]);
+    while (slots[slot] != voice + 1)
+        slot = (slot + 1) & slotMask;
+    slots[slot] = 0;
+    for (uint16_t next=(slot + 1) & slotMask; slots[next]; next=(next + 1) & slotMask) {
+        uint8_t other = slots[next] - 1;
+        uint16_t home = slotOf(channels[other], notes[other]);
+        if (((next - home) & slotMask) >= ((next - slot) & slotMask)) { // Can move back to the hole?
+            slots[slot] = slots[next];
+            slots[next] = 0;
+            slot = next;
+        }
+    }
+}
+
+// Return all voices to the pool
+void MidiVoicePool::freeAll(void) {
+    for (size_t i=0; i<4; i++)
+        activeVoices[i] = 0x00000000;
+    for (size_t i=0; i<16; i++)
+        channelVoices[i] = 0;
+    for (size_t i=0; i<=slotMask && slots != NULL; i++)
+        slots[i] = 0;
+    used = 0;
+    activeChannels = 0x0000;
+    nextSerial = 0U;
+}
+
+// Get the MIDI channel of a voice
+uint8_t MidiVoicePool::getChannel(uint8_t voice) {
+    return channels[voice];
+}
+
+// Get the MIDI note of a voice
+uint8_t MidiVoicePool::getNote(uint8_t voice) {
+    return notes[voice];
+}
+
+// Test if a voice is in use
+bool MidiVoicePool::isActive(uint8_t voice) {
+    return voice < polyphony && bitRead(activeVoices[voice / 32], voice % 32);
+}
+
+// Test if all voices are in use
+bool MidiVoicePool::isFull(void) {
+    return used == polyphony;
+}
+
+// Get the number of voices in use
+uint8_t MidiVoicePool::getVoicesUsed(void) {
+    return used;
+}
+
+// Get the voices in use (128-bit voices mask, uint32_t[4])
+const uint32_t *MidiVoicePool::getActiveVoices(void) {
+    return activeVoices;
+}
+
+// Get the MIDI channels with voices in use (16-bit channels mask)
+uint16_t MidiVoicePool::getActiveChannels(void) {
+    return activeChannels;
+}
+
+// Compute the home index slot of a channel note
+uint16_t MidiVoicePool::slotOf(uint8_t channel, uint8_t note) {
+    uint16_t key = ((channel & 0xF) << 7) | (note & 0x7F);
+    return ((key * 0x9E37U) >> 7) & slotMask; // Fibonacci hashing
+}
@@ -0,0 +1,73 @@
+#ifndef MIDI_VOICE_POOL_H
+#define MIDI_VOICE_POOL_H
+/**
+ * MIDI Voice Pool class - Allocates a fixed number of voices (e.g. envelopes of an AdsrEnvelopeBank)
+ * to sounding MIDI channel notes, so that per-note state is O(polyphony) instead of O(128 x channels).
+ *
+ * Sounding notes are mapped to their voice through a small hash index (twice the polyphony, rounded
+ * up to a power of 2). When all voices are in use, a voice is stolen using a configurable policy:
+ *   OLDEST: the voice triggered longest ago
+ *   QUIETEST: the voice with the lowest envelope level (oldest on ties)
+ *   RELEASED_FIRST: the oldest voice in its release phase (or the oldest voice if none)
+ *
+ * Hugo Hromic - http://github.com/hhromic
+ * MIT license
+ */
+
+#include <cinttypes>
+#include <MidiLedsCompat.h>
+#include <AdsrEnvelopeBank.h>
+
+class MidiVoicePool {
+    public:
+        // Available voice stealing policies
+        enum StealPolicies { OLDEST, QUIETEST, RELEASED_FIRST };
+
+        // Class constructor/destructor
+        MidiVoicePool();
+        ~MidiVoicePool();
+
+        // Configuration
+        void resize(uint8_t polyphony);
+        uint8_t getPolyphony(void);
+        StealPolicies getStealPolicy(void);
+        void setStealPolicy(StealPolicies stealPolicy);
+
+        // Public methods
+        int16_t findVoice(uint8_t channel, uint8_t note);
+        int16_t allocateVoice(uint8_t channel, uint8_t note);
+        uint8_t stealVoice(AdsrEnvelopeBank &envelopes);
+        void freeVoice(uint8_t voice);
+        void freeAll(void);
+        uint8_t getChannel(uint8_t voice);
+        uint8_t getNote(uint8_t voice);
+        bool isActive(uint8_t voice);
+        bool isFull(void);
+        uint8_t getVoicesUsed(void);
+        const uint32_t *getActiveVoices(void);
+        uint16_t getActiveChannels(void);
+
+    private:
+        // Voice data (one entry per voice)
+        uint8_t polyphony;
+        uint8_t *channels;
+        uint8_t *notes;
+        uint32_t *serials;
+        uint32_t nextSerial;
+        uint32_t activeVoices[4];
+        uint8_t used;
+        uint8_t channelVoices[16];
+        uint16_t activeChannels;
+        StealPolicies stealPolicy;
+
+        // Hash index of sounding notes (voice + 1 per slot, 0 for empty slots)
+        uint8_t *slots;
+        uint16_t slotMask;
+        uint16_t slotOf(uint8_t channel, uint8_t note);
+
+        // Non-copyable (owns its voice data)
+        MidiVoicePool(const MidiVoicePool &);
+        MidiVoicePool &operator=(const MidiVoicePool &);
+};
+
+#endif
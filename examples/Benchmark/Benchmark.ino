@@ -0,0 +1,214 @@
+/**
+ * MIDI Leds benchmark - Measures the per-frame render path and per-event costs of the library classes.
+ * Because I only have a Teensy 3.1 available for testing, cycle counts use its DWT cycle counter
+ * (other platforms fall back to micros() scaled by F_CPU, which is much coarser).
+ *
+ * Results are printed to the serial port as CSV lines (see the header line printed first) so they
+ * can be captured and compared between commits:
+ *   benchmark,config,ops,cycles_per_op,ns_per_op
+ * A frame is one tick of all instances, an event is one call of the measured method.
+ *
+ * Hugo Hromic - http://github.com/hhromic
+ * MIT license
+ */
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include <AdsrEnvelope.h>
+#include <MidiLeds.h>
+#include <MidiLedsMultiChannel.h>
+#include <MidiColorMapper.h>
+#include <MidiDamperPedal.h>
+#include <MidiSostenutoPedal.h>
+
+// Benchmark configuration
+#define NOTE_MIN 0x15       // note 21 (first note on standard 88 keys keyboard)
+#define NOTE_MAX 0x6C       // note 108 (last note on standard 88 keys keyboard)
+#define MAX_INSTANCES 16    // Maximum number of MidiLeds instances to benchmark
+#define FRAMES 200          // Number of frames per tick benchmark
+#define FRAME_TIME 16667    // Simulated time between frames (us)
+#define EVENTS 1000         // Number of events per event benchmark
+
+//***********************************************************************
+// Global objects
+
+CRGB leds[NOTE_MAX - NOTE_MIN + 1];
+MidiLeds midiLeds[MAX_INSTANCES];
+MidiLedsMultiChannel midiLedsMultiChannel;
+MidiColorMapper colorMapper;
+MidiDamperPedal damperPedal;
+MidiSostenutoPedal sostenutoPedal;
+volatile uint8_t sink; // Keeps results alive
+
+//***********************************************************************
+// Main setup and loop functions
+
+void setup() {
+    Serial.begin(115200);
+    while (!Serial && millis() < 5000); // Wait for the serial monitor (if any)
+    initCycles();
+
+    // Init pedals handlers
+    damperPedal.setHandleNoteOn(nullNoteHandler);
+    damperPedal.setHandleNoteOff(nullNoteHandler);
+    sostenutoPedal.setHandleNoteOn(nullNoteHandler);
+    sostenutoPedal.setHandleNoteOff(nullNoteHandler);
+
+    // Run all benchmarks
+    Serial.println("benchmark,config,ops,cycles_per_op,ns_per_op");
+    const size_t instances[] = {1, 9, 16};
+    const uint8_t activePercents[] = {0, 10, 100};
+    for (size_t i=0; i<3; i++)
+        for (size_t j=0; j<3; j++)
+            benchMidiLedsTick(instances[i], activePercents[j]);
+    for (size_t i=0; i<3; i++)
+        for (size_t j=0; j<3; j++)
+            benchMidiLedsMultiChannelTick(instances[i], activePercents[j]);
+    benchAdsrEnvelopeTick();
+    benchColorMapperMap(MidiColorMapper::COLOR_MAP, "COLOR_MAP");
+    benchColorMapperMap(MidiColorMapper::RAINBOW, "RAINBOW");
+    benchColorMapperMap(MidiColorMapper::FIXED_COLOR, "FIXED_COLOR");
+    benchDamperRelease();
+    benchSostenutoRelease();
+    Serial.println("done");
+}
+
+void loop() {
+}
+
+//***********************************************************************
+// Cycle counting and reporting
+
+void initCycles() {
+#ifdef ARM_DWT_CYCCNT
+    ARM_DEMCR |= ARM_DEMCR_TRCENA;
+    ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+#endif
+}
+
+uint32_t cycles() {
+#ifdef ARM_DWT_CYCCNT
+    return ARM_DWT_CYCCNT;
+#else
+    return micros() * (F_CPU / 1000000);
+#endif
+}
+
+void report(const char *benchmark, const char *config, uint32_t ops, uint32_t elapsedCycles) {
+    float cyclesPerOp = elapsedCycles * 1.0f / ops;
+    Serial.print(benchmark);
+    Serial.print(",");
+    Serial.print(config);
+    Serial.print(",");
+    Serial.print(ops);
+    Serial.print(",");
+    Serial.print(cyclesPerOp, 1);
+    Serial.print(",");
+    Serial.println(cyclesPerOp * (1000000000.0f / F_CPU), 1);
+}
+
+void nullNoteHandler(uint8_t channel, uint8_t note, uint8_t velocity) {
+}
+
+//***********************************************************************
+// Benchmarks
+
+// MidiLeds::tick() per frame for a number of instances and percentage of active keys
+void benchMidiLedsTick(size_t instances, uint8_t activePercent) {
+    for (size_t i=0; i<instances; i++) {
+        midiLeds[i].useLeds(leds, NOTE_MIN, NOTE_MAX);
+        midiLeds[i].setDecayTime(60000U); // Keep notes active during the whole benchmark
+        for (uint8_t note=NOTE_MIN, n=0; note<=NOTE_MAX; note++, n++)
+            if ((n * activePercent) % 100 < activePercent)
+                midiLeds[i].noteOn(note, 0x7F);
+    }
+    unsigned long time = 0U;
+    uint32_t start = cycles();
+    for (size_t f=0; f<FRAMES; f++) {
+        for (size_t i=0; i<instances; i++)
+            sink = midiLeds[instances - i - 1].tick(time);
+        time += FRAME_TIME;
+    }
+    uint32_t elapsed = cycles() - start;
+    char config[32];
+    snprintf(config, sizeof(config), "instances=%u active=%u%%", (unsigned)instances, activePercent);
+    report("MidiLeds::tick", config, FRAMES, elapsed);
+}
+
+// MidiLedsMultiChannel::tick() per frame for a number of channels and percentage of active keys
+void benchMidiLedsMultiChannelTick(size_t channels, uint8_t activePercent) {
+    midiLedsMultiChannel.useLeds(leds, NOTE_MIN, NOTE_MAX, 128);
+    for (size_t i=0; i<channels; i++) {
+        midiLedsMultiChannel.setDecayTime(i, 60000U); // Keep notes active during the whole benchmark
+        for (uint8_t note=NOTE_MIN, n=0; note<=NOTE_MAX; note++, n++)
+            if ((n * activePercent) % 100 < activePercent)
+                midiLedsMultiChannel.noteOn(i, note, 0x7F);
+    }
+    unsigned long time = 0U;
+    uint32_t start = cycles();
+    for (size_t f=0; f<FRAMES; f++) {
+        sink = midiLedsMultiChannel.tick(time);
+        time += FRAME_TIME;
+    }
+    uint32_t elapsed = cycles() - start;
+    char config[48];
+    snprintf(config, sizeof(config), "channels=%u active=%u%% voices=%u", (unsigned)channels, activePercent,
+        midiLedsMultiChannel.getVoicesUsed());
+    report("MidiLedsMultiChannel::tick", config, FRAMES, elapsed);
+}
+
+// AdsrEnvelope::tick() per event during a full envelope
+void benchAdsrEnvelopeTick() {
+    AdsrEnvelope adsrEnvelope;
+    adsrEnvelope.noteOn(80U, 3000U, 0.5f, 400U);
+    unsigned long time = 0U;
+    uint32_t start = cycles();
+    for (size_t e=0; e<EVENTS; e++) {
+        sink = adsrEnvelope.tick(time);
+        time += 1000U;
+    }
+    uint32_t elapsed = cycles() - start;
+    report("AdsrEnvelope::tick", "attack=80 decay=3000 sustain=0.5", EVENTS, elapsed);
+}
+
+// MidiColorMapper::map() per event for a given mapper
+void benchColorMapperMap(MidiColorMapper::Mappers mapper, const char *config) {
+    colorMapper.setMapper(0, mapper);
+    colorMapper.setIgnoreVelocity(0, false);
+    sink = colorMapper.map(0, 0x00, 0x7F).v; // Warm up (builds the color cache)
+    uint32_t start = cycles();
+    for (size_t e=0; e<EVENTS; e++)
+        sink = colorMapper.map(0, e & 0x7F, e & 0x7F).v;
+    uint32_t elapsed = cycles() - start;
+    report("MidiColorMapper::map", config, EVENTS, elapsed);
+}
+
+// MidiDamperPedal::release() per event with 128 held notes
+void benchDamperRelease() {
+    uint32_t elapsed = 0;
+    for (size_t e=0; e<EVENTS; e++) {
+        damperPedal.press(0);
+        for (uint8_t note=0; note<128; note++)
+            damperPedal.noteOff(0, note, 0x00);
+        uint32_t start = cycles();
+        damperPedal.release(0);
+        elapsed += cycles() - start;
+    }
+    report("MidiDamperPedal::release", "held=128", EVENTS, elapsed);
+}
+
+// MidiSostenutoPedal::release() per event with 128 held notes
+void benchSostenutoRelease() {
+    uint32_t elapsed = 0;
+    for (size_t e=0; e<EVENTS; e++) {
+        for (uint8_t note=0; note<128; note++)
+            sostenutoPedal.noteOn(0, note, 0x7F);
+        sostenutoPedal.press(0);
+        for (uint8_t note=0; note<128; note++)
+            sostenutoPedal.noteOff(0, note, 0x00);
+        uint32_t start = cycles();
+        sostenutoPedal.release(0);
+        elapsed += cycles() - start;
+    }
+    report("MidiSostenutoPedal::release", "held=128", EVENTS, elapsed);
+}
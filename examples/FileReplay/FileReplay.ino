@@ -0,0 +1,199 @@
+/**
+ * MIDI Leds example - Replays a Standard MIDI File through the full pedals and MidiLeds chain.
+ * Because I only have a Teensy 3.1 available for testing, it is not guaranteed to work on other platforms.
+ *
+ * The file is streamed from an SD card and replayed on a virtual clock (as fast as possible), and
+ * each rendered frame is recorded into a binary frames file on the same SD card. This is useful to
+ * profile the rendering chain with real performances and to compare output between versions.
+ *
+ * The event handling chain is as follows:
+ * MIDI file -> Damper Pedal -> Soft Pedal -> Sostenuto Pedal -> MidiLeds -> Frame Recorder
+ *
+ * Hugo Hromic - http://github.com/hhromic
+ * MIT license
+ */
+
+#include <Arduino.h>
+#include <SD.h>
+#include <FastLED.h>
+#include <MidiLeds.h>
+#include <MidiFileReader.h>
+#include <MidiFrameRecorder.h>
+#include <MidiFrameScheduler.h>
+#include <MidiDamperPedal.h>
+#include <MidiSostenutoPedal.h>
+#include <MidiSoftPedal.h>
+
+// Program configuration
+#define SD_CS_PIN BUILTIN_SDCARD    // SD card chip select pin
+#define INPUT_FILE "input.mid"      // MIDI file to replay
+#define OUTPUT_FILE "frames.bin"    // Recorded frames file
+#define NOTE_MIN 0x15               // note 21 (first note on standard 88 keys keyboard)
+#define NOTE_MAX 0x6C               // note 108 (last note on standard 88 keys keyboard)
+#define FRAME_RATE 60               // Rendered frames per second of virtual clock
+
+// MIDI Control Change (CC) control bytes definitions
+#define CC_DAMPER_PEDAL           0x40
+#define CC_SOSTENUTO_PEDAL        0x42
+#define CC_SOFT_PEDAL             0x43
+
+//***********************************************************************
+// Global objects
+
+File midiFile;
+File framesFile;
+CRGB leds[NOTE_MAX - NOTE_MIN + 1];
+MidiLeds midiLeds;
+MidiFileReader midiFileReader;
+MidiFrameRecorder frameRecorder;
+MidiFrameScheduler frameScheduler;
+MidiDamperPedal damperPedal;
+MidiSoftPedal softPedal;
+MidiSostenutoPedal sostenutoPedal;
+
+//***********************************************************************
+// Main setup and loop functions
+
+void setup() {
+    Serial.begin(115200);
+    while (!Serial && millis() < 5000); // Wait for the serial monitor (if any)
+
+    // Open input and output files
+    if (!SD.begin(SD_CS_PIN)) {
+        Serial.println("SD card initialisation failed");
+        return;
+    }
+    midiFile = SD.open(INPUT_FILE, FILE_READ);
+    SD.remove(OUTPUT_FILE);
+    framesFile = SD.open(OUTPUT_FILE, FILE_WRITE);
+    if (!midiFile || !framesFile) {
+        Serial.println("Unable to open input/output files");
+        return;
+    }
+
+    // Init MidiLeds
+    midiLeds.useLeds(leds, NOTE_MIN, NOTE_MAX);
+
+    // Init pedals handlers
+    damperPedal.setHandleNoteOn(damperNoteOn);
+    damperPedal.setHandleNoteOff(damperNoteOff);
+    damperPedal.setHandleNotesOff(damperNotesOff);
+    softPedal.setHandleNoteOn(softNoteOn);
+    sostenutoPedal.setHandleNoteOn(sostenutoNoteOn);
+    sostenutoPedal.setHandleNoteOff(sostenutoNoteOff);
+    sostenutoPedal.setHandleNotesOff(sostenutoNotesOff);
+
+    // Init MIDI file reader and frame recorder
+    midiFileReader.setHandleRead(readMidiFile);
+    midiFileReader.setHandleNoteOn(onNoteOn);
+    midiFileReader.setHandleNoteOff(onNoteOff);
+    midiFileReader.setHandleControlChange(onControlChange);
+    frameRecorder.setHandleWrite(writeFrames);
+    if (!midiFileReader.begin() || !frameRecorder.begin(NOTE_MAX - NOTE_MIN + 1)) {
+        Serial.println("Invalid MIDI file (or too many tracks) or unable to write frames");
+        return;
+    }
+
+    // Replay the whole file on a virtual clock (1 ms steps), rendering frames at FRAME_RATE
+    // MidiLeds and the scheduler run on microseconds (which wrap around in long files)
+    unsigned long time = 0U;
+    unsigned long start = micros();
+    bool playing = true;
+    frameScheduler.setFrameRate(FRAME_RATE);
+    frameScheduler.begin(time * 1000U);
+    while (playing || !midiLeds.isIdle()) {
+        time++;
+        playing = midiFileReader.playUntil(time);
+        if (frameScheduler.isFrameDue(time * 1000U)) {
+            midiLeds.tick(frameScheduler.getFrameTime());
+            frameRecorder.record(frameScheduler.getFrameTime(), leds);
+        }
+    }
+    unsigned long elapsed = micros() - start;
+    framesFile.close();
+    midiFile.close();
+
+    // Report replay statistics
+    Serial.print("Replayed ");
+    Serial.print(time);
+    Serial.print(" ms of MIDI in ");
+    Serial.print(elapsed / 1000U);
+    Serial.print(" ms (");
+    Serial.print(frameRecorder.getFrameCount());
+    Serial.println(" frames)");
+}
+
+void loop() {
+}
+
+//***********************************************************************
+// File access handlers
+
+size_t readMidiFile(uint32_t offset, uint8_t *buffer, size_t length) {
+    if (!midiFile.seek(offset))
+        return 0;
+    return midiFile.read(buffer, length);
+}
+
+size_t writeFrames(const uint8_t *buffer, size_t length) {
+    return framesFile.write(buffer, length);
+}
+
+//***********************************************************************
+// Message handlers for the pedals
+
+void damperNoteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
+    softPedal.noteOn(channel, note, velocity);
+}
+
+void damperNoteOff(uint8_t channel, uint8_t note, uint8_t velocity) {
+    sostenutoPedal.noteOff(channel, note, velocity);
+}
+
+void damperNotesOff(uint8_t channel, const uint32_t *notes) {
+    sostenutoPedal.notesOff(channel, notes);
+}
+
+void softNoteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
+    sostenutoPedal.noteOn(channel, note, velocity);
+}
+
+void sostenutoNoteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
+    midiLeds.noteOn(note, velocity, midiFileReader.getEventTime() * 1000U);
+}
+
+void sostenutoNoteOff(uint8_t channel, uint8_t note, uint8_t velocity) {
+    midiLeds.noteOff(note, midiFileReader.getEventTime() * 1000U);
+}
+
+void sostenutoNotesOff(uint8_t channel, const uint32_t *notes) {
+    midiLeds.notesOff(notes, midiFileReader.getEventTime() * 1000U);
+}
+
+//***********************************************************************
+// Message handlers for MIDI file events (channel here comes in 0..15 range)
+
+void onNoteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
+    damperPedal.noteOn(channel, note, velocity);
+}
+
+void onNoteOff(uint8_t channel, uint8_t note, uint8_t velocity) {
+    damperPedal.noteOff(channel, note, velocity);
+}
+
+void onControlChange(uint8_t channel, uint8_t control, uint8_t value) {
+    switch (control) {
+        case CC_DAMPER_PEDAL:
+            if (value < 0x40) damperPedal.release(channel);
+            else damperPedal.press(channel);
+            break;
+        case CC_SOSTENUTO_PEDAL:
+            if (value < 0x40) sostenutoPedal.release(channel);
+            else sostenutoPedal.press(channel);
+            break;
+        case CC_SOFT_PEDAL:
+            if (value < 0x40) softPedal.release(channel);
+            else softPedal.press(channel);
+            break;
+    }
+}
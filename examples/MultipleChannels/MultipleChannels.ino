@@ -4,10 +4,17 @@
  * This Leds display controller also considers MIDI pedals for enhanced visualisation.
  *
  * This example uses multiple MIDI channels to work. It handles parameters and pedalling independently for
- * each MIDI channel and it super-imposes LED visuals in reverse channel order (lower takes precedence).
+ * each MIDI channel and it composites LED visuals of all channels with a single MidiLedsMultiChannel engine
+ * (by default lower channels take precedence, see the blend mode control).
  *
  * The event handling chain is as follows:
- * MIDI input -> Damper Pedal -> Soft Pedal -> Sostenuto Pedal -> MidiLeds
+ * MIDI input -> Event Queue -> Damper Pedal -> Soft Pedal -> Sostenuto Pedal -> MidiLeds
+ *
+ * The pedals and MidiLeds are composed into a MidiPipeline, so the whole chain is resolved at compile time.
+ *
+ * MIDI input handlers only timestamp and queue messages (so they are also safe to use from an ISR),
+ * and the main loop applies them at their arrival time. The Leds are only rendered at FRAME_RATE,
+ * so the time left in between goes to MIDI polling.
  *
  * Hugo Hromic - http://github.com/hhromic
  * MIT license
@@ -16,10 +23,14 @@
 #include <cmath> 
 #include <Arduino.h>
 #include <FastLED.h>
-#include <MidiLeds.h>
+#include <MidiLedsMultiChannel.h>
+#include <MidiEventQueue.h>
+#include <MidiFrameScheduler.h>
+#include <MidiLedsStats.h>
 #include <MidiDamperPedal.h>
 #include <MidiSostenutoPedal.h>
 #include <MidiSoftPedal.h>
+#include <MidiPipeline.h>
 
 // Program configuration
 #define DATA_PIN 2          // LED strip data pin
@@ -27,13 +38,11 @@
 #define NOTE_MIN 0x15       // note 21 (first note on standard 88 keys keyboard)
 #define NOTE_MAX 0x6C       // note 108 (last note on standard 88 keys keyboard)
 #define TIME_RANGE 5000     // Time range for setting parameters from MIDI control messages
+#define POLYPHONY 32        // Maximum number of notes lit at once across all channels
+#define FRAME_RATE 100      // Target LED refresh rate (frames per second)
 
-// MIDI channels to listen (for now this is tricky, be careful when setting this section)
-#define NUM_CHANNELS 9  // The number of total channels you will listen for (depends on RAM!)
+// MIDI channels to listen
 #define CHANNELS 0b0000001011111111 // From right-to-left, put 1s or 0s to map MIDI channels
-const size_t ML_INDEX[16] = { // From left-to-right put a correlative index (starts with 0)
-  0, 1, 2, 3, 4, 5, 6, 7, -1, 8, -1, -1, -1, -1, -1 // you can use -1 to mark unused channels
-};
 
 // MIDI Control Change (CC) control bytes definitions
 #define CC_COLOR_MAPPER           0x14
@@ -45,6 +54,11 @@ const size_t ML_INDEX[16] = { // From left-to-right put a correlative index (sta
 #define CC_RELEASE_TIME           0x1A
 #define CC_IGNORE_VELOCITY        0x1B
 #define CC_BASE_BRIGHTNESS        0x1C
+#define CC_BLEND_MODE             0x1D
+#define CC_ATTACK_CURVE           0x1E
+#define CC_DECAY_CURVE            0x1F
+#define CC_RELEASE_CURVE          0x66
+#define CC_DUMP_STATS             0x67
 #define CC_ALL_SOUND_OFF          0x78
 #define CC_RESET_ALL_CONTROLLERS  0x79
 #define CC_DAMPER_PEDAL           0x40
@@ -54,12 +68,20 @@ const size_t ML_INDEX[16] = { // From left-to-right put a correlative index (sta
 //***********************************************************************
 // Global objects
 
-elapsedMillis elapsedTime;
+elapsedMicros elapsedTime;
+MidiFrameScheduler frameScheduler;
+#ifdef MIDI_LEDS_INSTRUMENTATION
+MidiLedsStats stats;
+#endif
+MidiEventQueue<64> midiEvents;
 CRGB leds[NOTE_MAX - NOTE_MIN + 1];
-MidiLeds midiLeds[NUM_CHANNELS];
+MidiLedsMultiChannel midiLeds;
 MidiDamperPedal damperPedal;
 MidiSoftPedal softPedal;
 MidiSostenutoPedal sostenutoPedal;
+MidiLedsMultiChannelSink midiLedsSink(midiLeds);
+MidiPipeline<MidiDamperPedal, MidiSoftPedal, MidiSostenutoPedal, MidiLedsMultiChannelSink>
+    pipeline(damperPedal, softPedal, sostenutoPedal, midiLedsSink);
 
 //***********************************************************************
 // Main setup and loop functions
@@ -75,52 +97,61 @@ void setup() {
     FastLED.setDither(0);
     FastLED.setCorrection(TypicalSMD5050);
     
-    // Init pedals handlers
-    damperPedal.setHandleNoteOn(damperNoteOn);
-    damperPedal.setHandleNoteOff(damperNoteOff);
-    softPedal.setHandleNoteOn(softNoteOn);
-    sostenutoPedal.setHandleNoteOn(sostenutoNoteOn);
-    sostenutoPedal.setHandleNoteOff(sostenutoNoteOff);
-
     // Init MidiLeds
-    for (size_t i=0; i<NUM_CHANNELS; i++)
-        midiLeds[i].useLeds(leds, NOTE_MIN, NOTE_MAX);
+    midiLeds.useLeds(leds, NOTE_MIN, NOTE_MAX, POLYPHONY);
+
+    // Init frame scheduler
+    frameScheduler.setFrameRate(FRAME_RATE);
 
     // Init USB MIDI handlers
-    usbMIDI.setHandleNoteOn(onNoteOn);
-    usbMIDI.setHandleNoteOff(onNoteOff);
-    usbMIDI.setHandleControlChange(onControlChange);
+    usbMIDI.setHandleNoteOn(queueNoteOn);
+    usbMIDI.setHandleNoteOff(queueNoteOff);
+    usbMIDI.setHandleControlChange(queueControlChange);
 }
 
 void loop() {
     digitalWrite(STATUS_LED_PIN, HIGH);
     usbMIDI.read();
-    for (size_t i=0; i<NUM_CHANNELS; i++)
-        midiLeds[NUM_CHANNELS - i - 1].tick(elapsedTime); // tick in reverse order
-    FastLED.show();
+    processMidiEvents();
+    if (frameScheduler.isFrameDue(elapsedTime)) { // Render once per frame period, poll MIDI otherwise
+        MIDI_LEDS_STATS(stats.beginTick(micros()));
+        bool changed = midiLeds.tick(frameScheduler.getFrameTime());
+        MIDI_LEDS_STATS(stats.endTick(micros()));
+        if (changed) { // Only push LEDs data if something changed
+            MIDI_LEDS_STATS(stats.beginShow(micros()));
+            FastLED.show();
+            MIDI_LEDS_STATS(stats.endShow(micros()));
+        }
+        frameScheduler.endFrame(elapsedTime);
+    }
 }
 
 //***********************************************************************
-// Message handlers for the pedals
+// MIDI input queueing and processing (MIDI channel comes in range 1..16)
 
-void damperNoteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
-    softPedal.noteOn(channel, note, velocity);
+void queueNoteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
+    midiEvents.push(elapsedTime, MidiEvent::NOTE_ON, channel, note, velocity);
 }
 
-void damperNoteOff(uint8_t channel, uint8_t note) {
-    sostenutoPedal.noteOff(channel, note);
+void queueNoteOff(uint8_t channel, uint8_t note, uint8_t velocity) {
+    midiEvents.push(elapsedTime, MidiEvent::NOTE_OFF, channel, note, velocity);
 }
 
-void softNoteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
-    sostenutoPedal.noteOn(channel, note, velocity);
+void queueControlChange(uint8_t channel, uint8_t control, uint8_t value) {
+    midiEvents.push(elapsedTime, MidiEvent::CONTROL_CHANGE, channel, control, value);
 }
 
-void sostenutoNoteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
-    midiLeds[ML_INDEX[channel]].noteOn(note, velocity);
-}
-
-void sostenutoNoteOff(uint8_t channel, uint8_t note) {
-    midiLeds[ML_INDEX[channel]].noteOff(note);
+void processMidiEvents() {
+    struct MidiEvent event;
+    while (midiEvents.pop(event)) {
+        MIDI_LEDS_STATS(stats.countEvent(event.channel - 1, millis()));
+        midiLedsSink.setEventTime(event.time);
+        switch (event.type) {
+            case MidiEvent::NOTE_ON: onNoteOn(event.channel, event.data1, event.data2); break;
+            case MidiEvent::NOTE_OFF: onNoteOff(event.channel, event.data1, event.data2); break;
+            case MidiEvent::CONTROL_CHANGE: onControlChange(event.channel, event.data1, event.data2); break;
+        }
+    }
 }
 
 //***********************************************************************
@@ -129,82 +160,118 @@ void sostenutoNoteOff(uint8_t channel, uint8_t note) {
 void onNoteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
     if (!bitRead(CHANNELS, channel - 1))
         return;
-    damperPedal.noteOn(channel - 1, note, velocity);
+    pipeline.noteOn(channel - 1, note, velocity);
     digitalWrite(STATUS_LED_PIN, LOW);
 }
 
 void onNoteOff(uint8_t channel, uint8_t note, uint8_t velocity) {
     if (!bitRead(CHANNELS, channel - 1))
         return;
-    damperPedal.noteOff(channel - 1, note);
+    pipeline.noteOff(channel - 1, note, velocity);
     digitalWrite(STATUS_LED_PIN, LOW);
 }
 
 void onControlChange(uint8_t channel, uint8_t control, uint8_t value)  {
     if (!bitRead(CHANNELS, channel - 1))
         return;
-    size_t mlIndex = ML_INDEX[channel - 1];
     switch (control) {
         case CC_COLOR_MAPPER:
             switch (value) {
-                case 0x00: midiLeds[mlIndex].setColorMapper(MidiColorMapper::COLOR_MAP); initNotes(mlIndex); break;
-                case 0x01: midiLeds[mlIndex].setColorMapper(MidiColorMapper::RAINBOW); initNotes(mlIndex); break;
-                case 0x02: midiLeds[mlIndex].setColorMapper(MidiColorMapper::FIXED_COLOR); initNotes(mlIndex); break;
+                case 0x00: midiLeds.setColorMapper(channel - 1, MidiColorMapper::COLOR_MAP); break;
+                case 0x01: midiLeds.setColorMapper(channel - 1, MidiColorMapper::RAINBOW); break;
+                case 0x02: midiLeds.setColorMapper(channel - 1, MidiColorMapper::FIXED_COLOR); break;
             }
             break;
         case CC_NOTE_COLOR_MAP:
             switch (value) {
-                case 0x00: midiLeds[mlIndex].setNoteColorMap(MidiNoteColors::AEPPLI_1940); initNotes(mlIndex); break;
-                case 0x01: midiLeds[mlIndex].setNoteColorMap(MidiNoteColors::BELMONT_1944); initNotes(mlIndex); break;
-                case 0x02: midiLeds[mlIndex].setNoteColorMap(MidiNoteColors::BERTRAND_1734); initNotes(mlIndex); break;
-                case 0x03: midiLeds[mlIndex].setNoteColorMap(MidiNoteColors::BISHOP_1893); initNotes(mlIndex); break;
-                case 0x04: midiLeds[mlIndex].setNoteColorMap(MidiNoteColors::FIELD_1816); initNotes(mlIndex); break;
-                case 0x05: midiLeds[mlIndex].setNoteColorMap(MidiNoteColors::HELMHOLTZ_1910); initNotes(mlIndex); break;
-                case 0x06: midiLeds[mlIndex].setNoteColorMap(MidiNoteColors::JAMESON_1844); initNotes(mlIndex); break;
-                case 0x07: midiLeds[mlIndex].setNoteColorMap(MidiNoteColors::KLEIN_1930); initNotes(mlIndex); break;
-                case 0x08: midiLeds[mlIndex].setNoteColorMap(MidiNoteColors::NEWTON_1704); initNotes(mlIndex); break;
-                case 0x09: midiLeds[mlIndex].setNoteColorMap(MidiNoteColors::RIMINGTON_1893); initNotes(mlIndex); break;
-                case 0x0A: midiLeds[mlIndex].setNoteColorMap(MidiNoteColors::SCRIABIN_1911); initNotes(mlIndex); break;
-                case 0x0B: midiLeds[mlIndex].setNoteColorMap(MidiNoteColors::SEEMANN_1881); initNotes(mlIndex); break;
-                case 0x0C: midiLeds[mlIndex].setNoteColorMap(MidiNoteColors::ZIEVERINK_2004); initNotes(mlIndex); break;
+                case 0x00: midiLeds.setNoteColorMap(channel - 1, MidiNoteColors::AEPPLI_1940); break;
+                case 0x01: midiLeds.setNoteColorMap(channel - 1, MidiNoteColors::BELMONT_1944); break;
+                case 0x02: midiLeds.setNoteColorMap(channel - 1, MidiNoteColors::BERTRAND_1734); break;
+                case 0x03: midiLeds.setNoteColorMap(channel - 1, MidiNoteColors::BISHOP_1893); break;
+                case 0x04: midiLeds.setNoteColorMap(channel - 1, MidiNoteColors::FIELD_1816); break;
+                case 0x05: midiLeds.setNoteColorMap(channel - 1, MidiNoteColors::HELMHOLTZ_1910); break;
+                case 0x06: midiLeds.setNoteColorMap(channel - 1, MidiNoteColors::JAMESON_1844); break;
+                case 0x07: midiLeds.setNoteColorMap(channel - 1, MidiNoteColors::KLEIN_1930); break;
+                case 0x08: midiLeds.setNoteColorMap(channel - 1, MidiNoteColors::NEWTON_1704); break;
+                case 0x09: midiLeds.setNoteColorMap(channel - 1, MidiNoteColors::RIMINGTON_1893); break;
+                case 0x0A: midiLeds.setNoteColorMap(channel - 1, MidiNoteColors::SCRIABIN_1911); break;
+                case 0x0B: midiLeds.setNoteColorMap(channel - 1, MidiNoteColors::SEEMANN_1881); break;
+                case 0x0C: midiLeds.setNoteColorMap(channel - 1, MidiNoteColors::ZIEVERINK_2004); break;
+            }
+            break;
+        case CC_FIXED_HUE: midiLeds.setFixedHue(channel - 1, round(0xFF * (value * 1.0f / 0x7F))); break;
+        case CC_ATTACK_TIME: midiLeds.setAttackTime(channel - 1, round(TIME_RANGE * (value * 1.0f / 0x7F))); break;
+        case CC_DECAY_TIME: midiLeds.setDecayTime(channel - 1, round(TIME_RANGE * (value * 1.0f / 0x7F))); break;
+        case CC_SUSTAIN_LEVEL: midiLeds.setSustainLevel(channel - 1, 1.0f * (value * 1.0f / 0x7F)); break;
+        case CC_RELEASE_TIME: midiLeds.setReleaseTime(channel - 1, round(TIME_RANGE * (value * 1.0f / 0x7F))); break;
+        case CC_IGNORE_VELOCITY: midiLeds.setIgnoreVelocity(channel - 1, value < 0x40 ? false : true); break;
+        case CC_BASE_BRIGHTNESS: midiLeds.setBaseBrightness(channel - 1, value); break;
+        case CC_BLEND_MODE:
+            switch (value) {
+                case 0x00: midiLeds.setBlendMode(channel - 1, MidiLedsMultiChannel::PRIORITY); break;
+                case 0x01: midiLeds.setBlendMode(channel - 1, MidiLedsMultiChannel::ADD); break;
+                case 0x02: midiLeds.setBlendMode(channel - 1, MidiLedsMultiChannel::MAX); break;
             }
             break;
-        case CC_FIXED_HUE: midiLeds[mlIndex].setFixedHue(round(0xFF * (value * 1.0f / 0x7F))); initNotes(mlIndex); break;
-        case CC_ATTACK_TIME: midiLeds[mlIndex].setAttackTime(round(TIME_RANGE * (value * 1.0f / 0x7F))); break;
-        case CC_DECAY_TIME: midiLeds[mlIndex].setDecayTime(round(TIME_RANGE * (value * 1.0f / 0x7F))); break;
-        case CC_SUSTAIN_LEVEL: midiLeds[mlIndex].setSustainLevel(1.0f * (value * 1.0f / 0x7F)); break;
-        case CC_RELEASE_TIME: midiLeds[mlIndex].setReleaseTime(round(TIME_RANGE * (value * 1.0f / 0x7F))); break;
-        case CC_IGNORE_VELOCITY: midiLeds[mlIndex].setIgnoreVelocity(value < 0x40 ? false : true); break;
-        case CC_BASE_BRIGHTNESS: midiLeds[mlIndex].setBaseBrightness(value); initNotes(mlIndex); break;
+        case CC_ATTACK_CURVE:
+            switch (value) {
+                case 0x00: midiLeds.setAttackCurve(channel - 1, AdsrEnvelopeBank::LINEAR); break;
+                case 0x01: midiLeds.setAttackCurve(channel - 1, AdsrEnvelopeBank::EXPONENTIAL); break;
+                case 0x02: midiLeds.setAttackCurve(channel - 1, AdsrEnvelopeBank::LOGARITHMIC); break;
+                case 0x03: midiLeds.setAttackCurve(channel - 1, AdsrEnvelopeBank::S_CURVE); break;
+            }
+            break;
+        case CC_DECAY_CURVE:
+            switch (value) {
+                case 0x00: midiLeds.setDecayCurve(channel - 1, AdsrEnvelopeBank::LINEAR); break;
+                case 0x01: midiLeds.setDecayCurve(channel - 1, AdsrEnvelopeBank::EXPONENTIAL); break;
+                case 0x02: midiLeds.setDecayCurve(channel - 1, AdsrEnvelopeBank::LOGARITHMIC); break;
+                case 0x03: midiLeds.setDecayCurve(channel - 1, AdsrEnvelopeBank::S_CURVE); break;
+            }
+            break;
+        case CC_RELEASE_CURVE:
+            switch (value) {
+                case 0x00: midiLeds.setReleaseCurve(channel - 1, AdsrEnvelopeBank::LINEAR); break;
+                case 0x01: midiLeds.setReleaseCurve(channel - 1, AdsrEnvelopeBank::EXPONENTIAL); break;
+                case 0x02: midiLeds.setReleaseCurve(channel - 1, AdsrEnvelopeBank::LOGARITHMIC); break;
+                case 0x03: midiLeds.setReleaseCurve(channel - 1, AdsrEnvelopeBank::S_CURVE); break;
+            }
+            break;
+        case CC_DUMP_STATS: MIDI_LEDS_STATS(sendStats()); break;
         case CC_ALL_SOUND_OFF:
-            midiLeds[mlIndex].allLedsOff();
-            damperPedal.release(channel - 1);
-            sostenutoPedal.release(channel - 1);
-            softPedal.release(channel - 1);
+            midiLeds.allLedsOff(channel - 1);
+            pipeline.release(damperPedal, channel - 1);
+            pipeline.release(sostenutoPedal, channel - 1);
+            pipeline.release(softPedal, channel - 1);
             break;
-        case CC_RESET_ALL_CONTROLLERS: midiLeds[mlIndex].reset(); break;
+        case CC_RESET_ALL_CONTROLLERS: midiLeds.reset(channel - 1); break;
         case CC_DAMPER_PEDAL:
-            if (value < 0x40) damperPedal.release(channel - 1);
-            else damperPedal.press(channel - 1);
+            if (value < 0x40) pipeline.release(damperPedal, channel - 1);
+            else pipeline.press(damperPedal, channel - 1);
             break;
         case CC_SOSTENUTO_PEDAL:
-            if (value < 0x40) sostenutoPedal.release(channel - 1);
-            else sostenutoPedal.press(channel - 1);
+            if (value < 0x40) pipeline.release(sostenutoPedal, channel - 1);
+            else pipeline.press(sostenutoPedal, channel - 1);
             break;
         case CC_SOFT_PEDAL:
-            if (value < 0x40) softPedal.release(channel - 1);
-            else softPedal.press(channel - 1);
+            if (value < 0x40) pipeline.release(softPedal, channel - 1);
+            else pipeline.press(softPedal, channel - 1);
             break;
     }
     digitalWrite(STATUS_LED_PIN, LOW);
 }
 
+#ifdef MIDI_LEDS_INSTRUMENTATION
 //***********************************************************************
-// Quickly send Note On and Note Off messages to re-init Leds
+// Send a SysEx dump of the instrumentation counters
 
-void initNotes(size_t mlIndex) {
-    for (uint8_t i=NOTE_MIN; i<=NOTE_MAX; i++) {
-        midiLeds[mlIndex].noteOn(i, 0x00);
-        midiLeds[mlIndex].noteOff(i);
-    }
+void sendStats() {
+    uint8_t sysEx[MidiLedsStats::SYSEX_SIZE];
+    stats.setHeldNotes(MidiLedsStats::DAMPER, damperPedal.getHeldNotes());
+    stats.setHeldNotes(MidiLedsStats::SOSTENUTO, sostenutoPedal.getHeldNotes());
+    for (uint8_t channel=0; channel<16; channel++)
+        stats.setActiveEnvelopes(channel, midiLeds.getVoicesUsed(channel));
+    stats.setSkippedFrames(frameScheduler.getDroppedFrames());
+    usbMIDI.sendSysEx(stats.getSysEx(sysEx, sizeof(sysEx), millis()), sysEx, true);
 }
+#endif
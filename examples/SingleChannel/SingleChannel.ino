@@ -6,7 +6,11 @@
  * This example uses only a single MIDI channel to work, making it simpler and easier to the eye.
  *
  * The event handling chain is as follows:
- * MIDI input -> Damper Pedal -> Soft Pedal -> Sostenuto Pedal -> MidiLeds
+ * MIDI input -> Event Queue -> Damper Pedal -> Soft Pedal -> Sostenuto Pedal -> MidiLeds
+ *
+ * MIDI input handlers only timestamp and queue messages (so they are also safe to use from an ISR),
+ * and the main loop applies them at their arrival time. The Leds are only rendered at FRAME_RATE,
+ * so the time left in between goes to MIDI polling.
  *
  * Hugo Hromic - http://github.com/hhromic
  * MIT license
@@ -16,6 +20,9 @@
 #include <Arduino.h>
 #include <FastLED.h>
 #include <MidiLeds.h>
+#include <MidiEventQueue.h>
+#include <MidiFrameScheduler.h>
+#include <MidiLedsStats.h>
 #include <MidiDamperPedal.h>
 #include <MidiSostenutoPedal.h>
 #include <MidiSoftPedal.h>
@@ -27,6 +34,7 @@
 #define NOTE_MIN 0x15      // note 21 (first note on standard 88 keys keyboard)
 #define NOTE_MAX 0x6C      // note 108 (last note on standard 88 keys keyboard)
 #define TIME_RANGE 5000    // Time range for setting parameters from MIDI control messages
+#define FRAME_RATE 100     // Target LED refresh rate (frames per second)
 
 // MIDI Control Change (CC) control bytes definitions
 #define CC_COLOR_MAPPER           0x14
@@ -38,6 +46,13 @@
 #define CC_RELEASE_TIME           0x1A
 #define CC_IGNORE_VELOCITY        0x1B
 #define CC_BASE_BRIGHTNESS        0x1C
+#define CC_ATTACK_CURVE           0x1E
+#define CC_DECAY_CURVE            0x1F
+#define CC_RELEASE_CURVE          0x66
+#define CC_DUMP_STATS             0x67
+#define CC_VELOCITY_TO_ATTACK     0x68
+#define CC_VELOCITY_TO_DECAY      0x69
+#define CC_VELOCITY_TO_SUSTAIN    0x6A
 #define CC_ALL_SOUND_OFF          0x78
 #define CC_RESET_ALL_CONTROLLERS  0x79
 #define CC_DAMPER_PEDAL           0x40
@@ -47,13 +62,28 @@
 //***********************************************************************
 // Global objects
 
-elapsedMillis elapsedTime;
+elapsedMicros elapsedTime;
+MidiFrameScheduler frameScheduler;
+#ifdef MIDI_LEDS_INSTRUMENTATION
+MidiLedsStats stats;
+#endif
+MidiEventQueue<64> midiEvents;
+unsigned long eventTime;
 CRGB leds[NOTE_MAX - NOTE_MIN + 1];
 MidiLeds midiLeds;
 MidiDamperPedal damperPedal;
 MidiSoftPedal softPedal;
 MidiSostenutoPedal sostenutoPedal;
 
+//***********************************************************************
+// Custom color mapper (hue follows the note within its octave, higher octaves are paler)
+
+struct OctaveGradient {
+    static struct CHSV color(uint8_t note, uint8_t noteMin, uint8_t noteMax) {
+        return CHSV((note % 12) * 0x15, 0xFF - (note / 12) * 0x0C, 0xFF);
+    }
+};
+
 //***********************************************************************
 // Main setup and loop functions
 // Make sure you check the FastLED.addLeds() function call.
@@ -68,27 +98,43 @@ void setup() {
     FastLED.setDither(0);
     FastLED.setCorrection(TypicalSMD5050);
     
-    // Init MidiLeds
+    // Init MidiLeds (dithered by MidiLeds itself, as FastLED dithering is disabled above)
     midiLeds.useLeds(leds, NOTE_MIN, NOTE_MAX);
+    midiLeds.setDithering(true);
+
+    // Init frame scheduler
+    frameScheduler.setFrameRate(FRAME_RATE);
 
     // Init pedals handlers
     damperPedal.setHandleNoteOn(damperNoteOn);
     damperPedal.setHandleNoteOff(damperNoteOff);
+    damperPedal.setHandleNotesOff(damperNotesOff);
     softPedal.setHandleNoteOn(softNoteOn);
     sostenutoPedal.setHandleNoteOn(sostenutoNoteOn);
     sostenutoPedal.setHandleNoteOff(sostenutoNoteOff);
+    sostenutoPedal.setHandleNotesOff(sostenutoNotesOff);
 
     // Init USB MIDI handlers
-    usbMIDI.setHandleNoteOn(onNoteOn);
-    usbMIDI.setHandleNoteOff(onNoteOff);
-    usbMIDI.setHandleControlChange(onControlChange);
+    usbMIDI.setHandleNoteOn(queueNoteOn);
+    usbMIDI.setHandleNoteOff(queueNoteOff);
+    usbMIDI.setHandleControlChange(queueControlChange);
 }
 
 void loop() {
     digitalWrite(STATUS_LED_PIN, HIGH);
     usbMIDI.read();
-    midiLeds.tick(elapsedTime);
-    FastLED.show();
+    processMidiEvents();
+    if (frameScheduler.isFrameDue(elapsedTime)) { // Render once per frame period, poll MIDI otherwise
+        MIDI_LEDS_STATS(stats.beginTick(micros()));
+        bool changed = midiLeds.tick(frameScheduler.getFrameTime());
+        MIDI_LEDS_STATS(stats.endTick(micros()));
+        if (changed) { // Only push LEDs data if something changed
+            MIDI_LEDS_STATS(stats.beginShow(micros()));
+            FastLED.show();
+            MIDI_LEDS_STATS(stats.endShow(micros()));
+        }
+        frameScheduler.endFrame(elapsedTime);
+    }
 }
 
 //***********************************************************************
@@ -98,8 +144,12 @@ void damperNoteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
     softPedal.noteOn(channel, note, velocity);
 }
 
-void damperNoteOff(uint8_t channel, uint8_t note) {
-    sostenutoPedal.noteOff(channel, note);
+void damperNoteOff(uint8_t channel, uint8_t note, uint8_t velocity) {
+    sostenutoPedal.noteOff(channel, note, velocity);
+}
+
+void damperNotesOff(uint8_t channel, const uint32_t *notes) {
+    sostenutoPedal.notesOff(channel, notes);
 }
 
 void softNoteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
@@ -107,11 +157,43 @@ void softNoteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
 }
 
 void sostenutoNoteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
-    midiLeds.noteOn(note, velocity);
+    midiLeds.noteOn(note, velocity, eventTime);
+}
+
+void sostenutoNoteOff(uint8_t channel, uint8_t note, uint8_t velocity) {
+    midiLeds.noteOff(note, eventTime);
+}
+
+void sostenutoNotesOff(uint8_t channel, const uint32_t *notes) {
+    midiLeds.notesOff(notes, eventTime);
+}
+
+//***********************************************************************
+// MIDI input queueing and processing (MIDI channel comes in range 1..16)
+
+void queueNoteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
+    midiEvents.push(elapsedTime, MidiEvent::NOTE_ON, channel, note, velocity);
+}
+
+void queueNoteOff(uint8_t channel, uint8_t note, uint8_t velocity) {
+    midiEvents.push(elapsedTime, MidiEvent::NOTE_OFF, channel, note, velocity);
 }
 
-void sostenutoNoteOff(uint8_t channel, uint8_t note) {
-    midiLeds.noteOff(note);
+void queueControlChange(uint8_t channel, uint8_t control, uint8_t value) {
+    midiEvents.push(elapsedTime, MidiEvent::CONTROL_CHANGE, channel, control, value);
+}
+
+void processMidiEvents() {
+    struct MidiEvent event;
+    while (midiEvents.pop(event)) {
+        MIDI_LEDS_STATS(stats.countEvent(event.channel - 1, millis()));
+        eventTime = event.time;
+        switch (event.type) {
+            case MidiEvent::NOTE_ON: onNoteOn(event.channel, event.data1, event.data2); break;
+            case MidiEvent::NOTE_OFF: onNoteOff(event.channel, event.data1, event.data2); break;
+            case MidiEvent::CONTROL_CHANGE: onControlChange(event.channel, event.data1, event.data2); break;
+        }
+    }
 }
 
 //***********************************************************************
@@ -125,7 +207,7 @@ void onNoteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
 
 void onNoteOff(uint8_t channel, uint8_t note, uint8_t velocity) {
     if (channel == MIDI_CHANNEL)
-        damperPedal.noteOff(channel - 1, note);
+        damperPedal.noteOff(channel - 1, note, velocity);
     digitalWrite(STATUS_LED_PIN, LOW);
 }
 
@@ -134,35 +216,67 @@ void onControlChange(uint8_t channel, uint8_t control, uint8_t value)  {
         switch (control) {
             case CC_COLOR_MAPPER:
                 switch (value) {
-                    case 0x00: midiLeds.setColorMapper(MidiColorMapper::COLOR_MAP); initNotes(); break;
-                    case 0x01: midiLeds.setColorMapper(MidiColorMapper::RAINBOW); initNotes(); break;
-                    case 0x02: midiLeds.setColorMapper(MidiColorMapper::FIXED_COLOR); initNotes(); break;
+                    case 0x00: midiLeds.setColorMapper(MidiColorMapper::COLOR_MAP); break;
+                    case 0x01: midiLeds.setColorMapper(MidiColorMapper::RAINBOW); break;
+                    case 0x02: midiLeds.setColorMapper(MidiColorMapper::FIXED_COLOR); break;
+                    case 0x03:
+                        midiLeds.setCustomColorMapper(MidiColorMapper::customMapper<OctaveGradient>);
+                        midiLeds.setColorMapper(MidiColorMapper::CUSTOM);
+                        break;
                 }
                 break;
             case CC_NOTE_COLOR_MAP:
                 switch (value) {
-                    case 0x00: midiLeds.setNoteColorMap(MidiNoteColors::AEPPLI_1940); initNotes(); break;
-                    case 0x01: midiLeds.setNoteColorMap(MidiNoteColors::BELMONT_1944); initNotes(); break;
-                    case 0x02: midiLeds.setNoteColorMap(MidiNoteColors::BERTRAND_1734); initNotes(); break;
-                    case 0x03: midiLeds.setNoteColorMap(MidiNoteColors::BISHOP_1893); initNotes(); break;
-                    case 0x04: midiLeds.setNoteColorMap(MidiNoteColors::FIELD_1816); initNotes(); break;
-                    case 0x05: midiLeds.setNoteColorMap(MidiNoteColors::HELMHOLTZ_1910); initNotes(); break;
-                    case 0x06: midiLeds.setNoteColorMap(MidiNoteColors::JAMESON_1844); initNotes(); break;
-                    case 0x07: midiLeds.setNoteColorMap(MidiNoteColors::KLEIN_1930); initNotes(); break;
-                    case 0x08: midiLeds.setNoteColorMap(MidiNoteColors::NEWTON_1704); initNotes(); break;
-                    case 0x09: midiLeds.setNoteColorMap(MidiNoteColors::RIMINGTON_1893); initNotes(); break;
-                    case 0x0A: midiLeds.setNoteColorMap(MidiNoteColors::SCRIABIN_1911); initNotes(); break;
-                    case 0x0B: midiLeds.setNoteColorMap(MidiNoteColors::SEEMANN_1881); initNotes(); break;
-                    case 0x0C: midiLeds.setNoteColorMap(MidiNoteColors::ZIEVERINK_2004); initNotes(); break;
+                    case 0x00: midiLeds.setNoteColorMap(MidiNoteColors::AEPPLI_1940); break;
+                    case 0x01: midiLeds.setNoteColorMap(MidiNoteColors::BELMONT_1944); break;
+                    case 0x02: midiLeds.setNoteColorMap(MidiNoteColors::BERTRAND_1734); break;
+                    case 0x03: midiLeds.setNoteColorMap(MidiNoteColors::BISHOP_1893); break;
+                    case 0x04: midiLeds.setNoteColorMap(MidiNoteColors::FIELD_1816); break;
+                    case 0x05: midiLeds.setNoteColorMap(MidiNoteColors::HELMHOLTZ_1910); break;
+                    case 0x06: midiLeds.setNoteColorMap(MidiNoteColors::JAMESON_1844); break;
+                    case 0x07: midiLeds.setNoteColorMap(MidiNoteColors::KLEIN_1930); break;
+                    case 0x08: midiLeds.setNoteColorMap(MidiNoteColors::NEWTON_1704); break;
+                    case 0x09: midiLeds.setNoteColorMap(MidiNoteColors::RIMINGTON_1893); break;
+                    case 0x0A: midiLeds.setNoteColorMap(MidiNoteColors::SCRIABIN_1911); break;
+                    case 0x0B: midiLeds.setNoteColorMap(MidiNoteColors::SEEMANN_1881); break;
+                    case 0x0C: midiLeds.setNoteColorMap(MidiNoteColors::ZIEVERINK_2004); break;
                 }
                 break;
-            case CC_FIXED_HUE: midiLeds.setFixedHue(round(0xFF * (value * 1.0f / 0x7F))); initNotes(); break;
+            case CC_FIXED_HUE: midiLeds.setFixedHue(round(0xFF * (value * 1.0f / 0x7F))); break;
             case CC_ATTACK_TIME: midiLeds.setAttackTime(round(TIME_RANGE * (value * 1.0f / 0x7F))); break;
             case CC_DECAY_TIME: midiLeds.setDecayTime(round(TIME_RANGE * (value * 1.0f / 0x7F))); break;
             case CC_SUSTAIN_LEVEL: midiLeds.setSustainLevel(1.0f * (value * 1.0f / 0x7F)); break;
             case CC_RELEASE_TIME: midiLeds.setReleaseTime(round(TIME_RANGE * (value * 1.0f / 0x7F))); break;
             case CC_IGNORE_VELOCITY: midiLeds.setIgnoreVelocity(value < 0x40 ? false : true); break;
-            case CC_BASE_BRIGHTNESS: midiLeds.setBaseBrightness(value); initNotes(); break;
+            case CC_BASE_BRIGHTNESS: midiLeds.setBaseBrightness(value); break;
+            case CC_ATTACK_CURVE:
+                switch (value) {
+                    case 0x00: midiLeds.setAttackCurve(AdsrEnvelopeBank::LINEAR); break;
+                    case 0x01: midiLeds.setAttackCurve(AdsrEnvelopeBank::EXPONENTIAL); break;
+                    case 0x02: midiLeds.setAttackCurve(AdsrEnvelopeBank::LOGARITHMIC); break;
+                    case 0x03: midiLeds.setAttackCurve(AdsrEnvelopeBank::S_CURVE); break;
+                }
+                break;
+            case CC_DECAY_CURVE:
+                switch (value) {
+                    case 0x00: midiLeds.setDecayCurve(AdsrEnvelopeBank::LINEAR); break;
+                    case 0x01: midiLeds.setDecayCurve(AdsrEnvelopeBank::EXPONENTIAL); break;
+                    case 0x02: midiLeds.setDecayCurve(AdsrEnvelopeBank::LOGARITHMIC); break;
+                    case 0x03: midiLeds.setDecayCurve(AdsrEnvelopeBank::S_CURVE); break;
+                }
+                break;
+            case CC_RELEASE_CURVE:
+                switch (value) {
+                    case 0x00: midiLeds.setReleaseCurve(AdsrEnvelopeBank::LINEAR); break;
+                    case 0x01: midiLeds.setReleaseCurve(AdsrEnvelopeBank::EXPONENTIAL); break;
+                    case 0x02: midiLeds.setReleaseCurve(AdsrEnvelopeBank::LOGARITHMIC); break;
+                    case 0x03: midiLeds.setReleaseCurve(AdsrEnvelopeBank::S_CURVE); break;
+                }
+                break;
+            case CC_DUMP_STATS: MIDI_LEDS_STATS(sendStats()); break;
+            case CC_VELOCITY_TO_ATTACK: midiLeds.setVelocityToAttack((value - 0x40) / 63.0f); break;
+            case CC_VELOCITY_TO_DECAY: midiLeds.setVelocityToDecay((value - 0x40) / 63.0f); break;
+            case CC_VELOCITY_TO_SUSTAIN: midiLeds.setVelocityToSustain((value - 0x40) / 63.0f); break;
             case CC_ALL_SOUND_OFF:
                 midiLeds.allLedsOff();
                 damperPedal.release(channel - 1);
@@ -187,12 +301,16 @@ void onControlChange(uint8_t channel, uint8_t control, uint8_t value)  {
     digitalWrite(STATUS_LED_PIN, LOW);
 }
 
+#ifdef MIDI_LEDS_INSTRUMENTATION
 //***********************************************************************
-// Quickly send Note On and Note Off messages to re-init Leds
+// Send a SysEx dump of the instrumentation counters
 
-void initNotes() {
-    for (uint8_t i=NOTE_MIN; i<=NOTE_MAX; i++) {
-        midiLeds.noteOn(i, 0x00);
-        midiLeds.noteOff(i);
-    }
+void sendStats() {
+    uint8_t sysEx[MidiLedsStats::SYSEX_SIZE];
+    stats.setHeldNotes(MidiLedsStats::DAMPER, damperPedal.getHeldNotes());
+    stats.setHeldNotes(MidiLedsStats::SOSTENUTO, sostenutoPedal.getHeldNotes());
+    stats.setActiveEnvelopes(0, midiLeds.getActiveEnvelopes());
+    stats.setSkippedFrames(frameScheduler.getDroppedFrames());
+    usbMIDI.sendSysEx(stats.getSysEx(sysEx, sizeof(sysEx), millis()), sysEx, true);
 }
+#endif
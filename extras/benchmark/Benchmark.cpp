@@ -0,0 +1,224 @@
+/**
+ * MIDI Leds host benchmark - Measures the per-frame render path and per-event costs of the library classes.
+ * Host counterpart of the Benchmark example, built by the host CMake build (not run by ctest).
+ * Times use std::chrono::steady_clock and cycles use the time-stamp counter on x86 hosts (empty elsewhere).
+ *
+ * Results are written to stdout as CSV lines (see the header line written first) so they can be
+ * captured and compared between commits:
+ *   benchmark,config,ops,cycles_per_op,ns_per_op
+ * A frame is one tick of all instances, an event is one call of the measured method.
+ *
+ * Hugo Hromic - http://github.com/hhromic
+ * MIT license
+ */
+
+#include <chrono>
+#include <cstdio>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCHMARK_CYCLES
+#endif
+#include <AdsrEnvelope.h>
+#include <MidiLeds.h>
+#include <MidiLedsMultiChannel.h>
+#include <MidiColorMapper.h>
+#include <MidiDamperPedal.h>
+#include <MidiSostenutoPedal.h>
+
+// Benchmark configuration
+#define NOTE_MIN 0x15       // note 21 (first note on standard 88 keys keyboard)
+#define NOTE_MAX 0x6C       // note 108 (last note on standard 88 keys keyboard)
+#define MAX_INSTANCES 16    // Maximum number of MidiLeds instances to benchmark
+#define FRAMES 2000         // Number of frames per tick benchmark
+#define FRAME_TIME 16667    // Simulated time between frames (us)
+#define EVENTS 10000        // Number of events per event benchmark
+
+//***********************************************************************
+// Global objects
+
+static struct CRGB leds[NOTE_MAX - NOTE_MIN + 1];
+static MidiLeds midiLeds[MAX_INSTANCES];
+static MidiLedsMultiChannel midiLedsMultiChannel;
+static MidiColorMapper colorMapper;
+static MidiDamperPedal damperPedal;
+static MidiSostenutoPedal sostenutoPedal;
+static volatile uint8_t sink; // Keeps results alive
+
+//***********************************************************************
+// Time/cycle counting and reporting
+
+// Elapsed time and cycles of a measured section
+struct Elapsed {
+    std::chrono::steady_clock::duration time;
+    uint64_t cycles;
+
+    Elapsed() : time(0), cycles(0U) {}
+};
+
+// Start of a measured section
+struct Start {
+    std::chrono::steady_clock::time_point time;
+    uint64_t cycles;
+
+    Start() : time(std::chrono::steady_clock::now()), cycles(counter()) {}
+
+    // Add the time and cycles since the start to an elapsed total
+    void stop(struct Elapsed &elapsed) {
+        uint64_t endCycles = counter();
+        elapsed.time += std::chrono::steady_clock::now() - time;
+        elapsed.cycles += endCycles - cycles;
+    }
+
+    static uint64_t counter(void) {
+#ifdef BENCHMARK_CYCLES
+        return __rdtsc();
+#else
+        return 0U;
+#endif
+    }
+};
+
+static void report(const char *benchmark, const char *config, unsigned long ops, const struct Elapsed &elapsed) {
+    double nsPerOp = std::chrono::duration<double, std::nano>(elapsed.time).count() / ops;
+#ifdef BENCHMARK_CYCLES
+    printf("%s,%s,%lu,%.1f,%.1f\n", benchmark, config, ops, (double)elapsed.cycles / ops, nsPerOp);
+#else
+    printf("%s,%s,%lu,,%.1f\n", benchmark, config, ops, nsPerOp);
+#endif
+}
+
+static void nullNoteHandler(uint8_t channel, uint8_t note, uint8_t velocity) {
+}
+
+//***********************************************************************
+// Benchmarks
+
+// MidiLeds::tick() per frame for a number of instances and percentage of active keys
+static void benchMidiLedsTick(size_t instances, uint8_t activePercent) {
+    for (size_t i=0; i<instances; i++) {
+        midiLeds[i].useLeds(leds, NOTE_MIN, NOTE_MAX);
+        midiLeds[i].setDecayTime(60000U); // Keep notes active during the whole benchmark
+        for (uint8_t note=NOTE_MIN, n=0; note<=NOTE_MAX; note++, n++)
+            if ((n * activePercent) % 100 < activePercent)
+                midiLeds[i].noteOn(note, 0x7F);
+    }
+    unsigned long time = 0U;
+    struct Elapsed elapsed;
+    struct Start start;
+    for (size_t f=0; f<FRAMES; f++) {
+        for (size_t i=0; i<instances; i++)
+            sink = midiLeds[instances - i - 1].tick(time);
+        time += FRAME_TIME;
+    }
+    start.stop(elapsed);
+    char config[32];
+    snprintf(config, sizeof(config), "instances=%u active=%u%%", (unsigned)instances, activePercent);
+    report("MidiLeds::tick", config, FRAMES, elapsed);
+}
+
+// MidiLedsMultiChannel::tick() per frame for a number of channels and percentage of active keys
+static void benchMidiLedsMultiChannelTick(size_t channels, uint8_t activePercent) {
+    midiLedsMultiChannel.useLeds(leds, NOTE_MIN, NOTE_MAX, 128);
+    for (size_t i=0; i<channels; i++) {
+        midiLedsMultiChannel.setDecayTime(i, 60000U); // Keep notes active during the whole benchmark
+        for (uint8_t note=NOTE_MIN, n=0; note<=NOTE_MAX; note++, n++)
+            if ((n * activePercent) % 100 < activePercent)
+                midiLedsMultiChannel.noteOn(i, note, 0x7F);
+    }
+    unsigned long time = 0U;
+    struct Elapsed elapsed;
+    struct Start start;
+    for (size_t f=0; f<FRAMES; f++) {
+        sink = midiLedsMultiChannel.tick(time);
+        time += FRAME_TIME;
+    }
+    start.stop(elapsed);
+    char config[48];
+    snprintf(config, sizeof(config), "channels=%u active=%u%% voices=%u", (unsigned)channels, activePercent,
+        midiLedsMultiChannel.getVoicesUsed());
+    report("MidiLedsMultiChannel::tick", config, FRAMES, elapsed);
+}
+
+// AdsrEnvelope::tick() per event during a full envelope
+static void benchAdsrEnvelopeTick(void) {
+    AdsrEnvelope adsrEnvelope;
+    adsrEnvelope.noteOn(80U, 3000U, 0.5f, 400U);
+    unsigned long time = 0U;
+    struct Elapsed elapsed;
+    struct Start start;
+    for (size_t e=0; e<EVENTS; e++) {
+        sink = adsrEnvelope.tick(time);
+        time += 1000U;
+    }
+    start.stop(elapsed);
+    report("AdsrEnvelope::tick", "attack=80 decay=3000 sustain=0.5", EVENTS, elapsed);
+}
+
+// MidiColorMapper::map() per event for a given mapper
+static void benchColorMapperMap(MidiColorMapper::Mappers mapper, const char *config) {
+    colorMapper.setMapper(0, mapper);
+    colorMapper.setIgnoreVelocity(0, false);
+    sink = colorMapper.map(0, 0x00, 0x7F).v; // Warm up (builds the color cache)
+    struct Elapsed elapsed;
+    struct Start start;
+    for (size_t e=0; e<EVENTS; e++)
+        sink = colorMapper.map(0, e & 0x7F, e & 0x7F).v;
+    start.stop(elapsed);
+    report("MidiColorMapper::map", config, EVENTS, elapsed);
+}
+
+// MidiDamperPedal::release() per event with 128 held notes
+static void benchDamperRelease(void) {
+    struct Elapsed elapsed;
+    for (size_t e=0; e<EVENTS; e++) {
+        damperPedal.press(0);
+        for (uint8_t note=0; note<128; note++)
+            damperPedal.noteOff(0, note, 0x00);
+        struct Start start;
+        damperPedal.release(0);
+        start.stop(elapsed);
+    }
+    report("MidiDamperPedal::release", "held=128", EVENTS, elapsed);
+}
+
+// MidiSostenutoPedal::release() per event with 128 held notes
+static void benchSostenutoRelease(void) {
+    struct Elapsed elapsed;
+    for (size_t e=0; e<EVENTS; e++) {
+        for (uint8_t note=0; note<128; note++)
+            sostenutoPedal.noteOn(0, note, 0x7F);
+        sostenutoPedal.press(0);
+        for (uint8_t note=0; note<128; note++)
+            sostenutoPedal.noteOff(0, note, 0x00);
+        struct Start start;
+        sostenutoPedal.release(0);
+        start.stop(elapsed);
+    }
+    report("MidiSostenutoPedal::release", "held=128", EVENTS, elapsed);
+}
+
+int main() {
+    // Init pedals handlers
+    damperPedal.setHandleNoteOn(nullNoteHandler);
+    damperPedal.setHandleNoteOff(nullNoteHandler);
+    sostenutoPedal.setHandleNoteOn(nullNoteHandler);
+    sostenutoPedal.setHandleNoteOff(nullNoteHandler);
+
+    // Run all benchmarks
+    printf("benchmark,config,ops,cycles_per_op,ns_per_op\n");
+    const size_t instances[] = {1, 9, 16};
+    const uint8_t activePercents[] = {0, 10, 100};
+    for (size_t i=0; i<3; i++)
+        for (size_t j=0; j<3; j++)
+            benchMidiLedsTick(instances[i], activePercents[j]);
+    for (size_t i=0; i<3; i++)
+        for (size_t j=0; j<3; j++)
+            benchMidiLedsMultiChannelTick(instances[i], activePercents[j]);
+    benchAdsrEnvelopeTick();
+    benchColorMapperMap(MidiColorMapper::COLOR_MAP, "COLOR_MAP");
+    benchColorMapperMap(MidiColorMapper::RAINBOW, "RAINBOW");
+    benchColorMapperMap(MidiColorMapper::FIXED_COLOR, "FIXED_COLOR");
+    benchDamperRelease();
+    benchSostenutoRelease();
+    return 0;
+}
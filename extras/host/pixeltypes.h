@@ -0,0 +1,91 @@
+#ifndef MIDI_LEDS_HOST_PIXELTYPES_H
+#define MIDI_LEDS_HOST_PIXELTYPES_H
+/**
+ * Host pixel types - Minimal stand-in for FastLED's <pixeltypes.h> used by the host-side build.
+ * Only provides what the library uses: CHSV, CRGB (with HSV conversion, nscale8, saturating
+ * addition and comparison) and CRGB::Black. The HSV conversion is a plain six-section spectrum,
+ * so host colors are close to (but not the same as) FastLED's rainbow conversion.
+ *
+ * Hugo Hromic - http://github.com/hhromic
+ * MIT license
+ */
+
+#include <cinttypes>
+
+struct CHSV {
+    union {
+        struct { uint8_t h, s, v; };
+        uint8_t raw[3];
+    };
+
+    CHSV() {}
+    CHSV(uint8_t ih, uint8_t is, uint8_t iv) : h(ih), s(is), v(iv) {}
+};
+
+struct CRGB {
+    union {
+        struct { uint8_t r, g, b; };
+        uint8_t raw[3];
+    };
+
+    // Predefined colors
+    enum HTMLColorCode { Black = 0x000000 };
+
+    CRGB() {}
+    CRGB(uint8_t ir, uint8_t ig, uint8_t ib) : r(ir), g(ig), b(ib) {}
+    CRGB(HTMLColorCode code) : r((code >> 16) & 0xFF), g((code >> 8) & 0xFF), b(code & 0xFF) {}
+    CRGB(const struct CHSV &hsv) { fromHsv(hsv); }
+
+    CRGB &operator=(const struct CHSV &hsv) {
+        fromHsv(hsv);
+        return *this;
+    }
+
+    uint8_t &operator[](uint8_t index) {
+        return raw[index];
+    }
+
+    // Scale all components by (scale + 1) / 256 (like FastLED's fixed scale8)
+    CRGB &nscale8(uint8_t scale) {
+        r = ((uint16_t)r * (scale + 1)) >> 8;
+        g = ((uint16_t)g * (scale + 1)) >> 8;
+        b = ((uint16_t)b * (scale + 1)) >> 8;
+        return *this;
+    }
+
+    // Saturating addition
+    CRGB &operator+=(const struct CRGB &rgb) {
+        r = r + rgb.r > 0xFF ? 0xFF : r + rgb.r;
+        g = g + rgb.g > 0xFF ? 0xFF : g + rgb.g;
+        b = b + rgb.b > 0xFF ? 0xFF : b + rgb.b;
+        return *this;
+    }
+
+    private:
+        // Six-section spectrum HSV to RGB conversion
+        void fromHsv(const struct CHSV &hsv) {
+            uint8_t section = hsv.h / 43;
+            uint8_t fraction = (hsv.h - section * 43) * 6;
+            uint8_t p = ((uint16_t)hsv.v * (0xFF - hsv.s)) >> 8;
+            uint8_t q = ((uint16_t)hsv.v * (0xFF - (((uint16_t)hsv.s * fraction) >> 8))) >> 8;
+            uint8_t t = ((uint16_t)hsv.v * (0xFF - (((uint16_t)hsv.s * (0xFF - fraction)) >> 8))) >> 8;
+            switch (section) {
+                case 0: r = hsv.v; g = t; b = p; break;
+                case 1: r = q; g = hsv.v; b = p; break;
+                case 2: r = p; g = hsv.v; b = t; break;
+                case 3: r = p; g = q; b = hsv.v; break;
+                case 4: r = t; g = p; b = hsv.v; break;
+                default: r = hsv.v; g = p; b = q; break;
+            }
+        }
+};
+
+inline bool operator==(const struct CRGB &a, const struct CRGB &b) {
+    return a.r == b.r && a.g == b.g && a.b == b.b;
+}
+
+inline bool operator!=(const struct CRGB &a, const struct CRGB &b) {
+    return !(a == b);
+}
+
+#endif
@@ -0,0 +1,330 @@
+/**
+ * AdsrEnvelopeBank tests - Envelope phase transitions, timing, curves and parameter groups.
+ * Times are in us and phase times in ms (attack 10 ms, decay 20 ms, sustain 0.5, release 10 ms).
+ * The curve shapes are also checked against their exact formulas within one 8-bit brightness step.
+ *
+ * Hugo Hromic - http://github.com/hhromic
+ * MIT license
+ */
+
+#include <cmath>
+#include <AdsrEnvelopeBank.h>
+#include "MidiLedsTest.h"
+
+static const uint16_t SUSTAIN_LEVEL = 0x8000; // 0.5 as a Q16 level (rounded)
+
+// Configure the first group of a bank with the test parameters
+static void configure(AdsrEnvelopeBank &bank, uint8_t size) {
+    bank.resize(size);
+    bank.setAttackTime(10U);
+    bank.setDecayTime(20U);
+    bank.setSustainLevel(0.5f);
+    bank.setReleaseTime(10U);
+}
+
+// New envelopes are idle and do not tick
+static void testIdle(void) {
+    AdsrEnvelopeBank bank;
+    configure(bank, 2);
+    CHECK(bank.isIdle(0));
+    CHECK(!bank.isReleased(0));
+    CHECK(!bank.tick(0, 1000U));
+    CHECK_EQUAL(0, bank.getLevel(0));
+}
+
+// Attack, decay, sustain and release follow their times
+static void testPhases(void) {
+    AdsrEnvelopeBank bank;
+    configure(bank, 1);
+    bank.noteOn(0, 0U);
+    CHECK(bank.tick(0, 0U));
+    CHECK_EQUAL(0, bank.getLevel(0));
+    bank.tick(0, 5000U); // Half attack
+    CHECK_NEAR(0x7FFF, bank.getLevel(0), 2);
+    bank.tick(0, 10000U); // Attack end
+    CHECK_EQUAL(AdsrEnvelopeBank::LEVEL_MAX, bank.getLevel(0));
+    bank.tick(0, 20000U); // Half decay
+    CHECK_NEAR(0xC000, bank.getLevel(0), 2);
+    bank.tick(0, 30000U); // Decay end
+    CHECK_EQUAL(SUSTAIN_LEVEL, bank.getLevel(0));
+    bank.tick(0, 500000U); // Sustain holds
+    CHECK_EQUAL(SUSTAIN_LEVEL, bank.getLevel(0));
+    CHECK(!bank.isIdle(0));
+    bank.noteOff(0, 500000U);
+    CHECK(bank.isReleased(0));
+    bank.tick(0, 505000U); // Half release
+    CHECK_NEAR(0x4000, bank.getLevel(0), 2);
+    bank.tick(0, 510000U); // Release end
+    CHECK_EQUAL(0, bank.getLevel(0));
+    CHECK(bank.isIdle(0));
+    CHECK(!bank.tick(0, 520000U));
+}
+
+// Skipped ticks do not change the output (phases carry over at their exact end time)
+static void testSkippedTicks(void) {
+    AdsrEnvelopeBank dense, sparse;
+    configure(dense, 1);
+    configure(sparse, 1);
+    dense.noteOn(0, 0U);
+    sparse.noteOn(0, 0U);
+    for (unsigned long time=0U; time<=25000U; time+=100U)
+        dense.tick(0, time);
+    sparse.tick(0, 25000U);
+    CHECK_EQUAL(dense.getLevel(0), sparse.getLevel(0));
+}
+
+// Envelopes without a sustain level end after their decay
+static void testZeroSustainEnds(void) {
+    AdsrEnvelopeBank bank;
+    configure(bank, 1);
+    bank.setSustainLevel(0.0f);
+    bank.noteOn(0, 0U);
+    bank.tick(0, 29999U);
+    CHECK(!bank.isIdle(0));
+    bank.tick(0, 30000U);
+    CHECK(bank.isIdle(0));
+    CHECK_EQUAL(0, bank.getLevel(0));
+}
+
+// Phases with no time are instant
+static void testInstantPhases(void) {
+    AdsrEnvelopeBank bank;
+    configure(bank, 1);
+    bank.setAttackTime(0U);
+    bank.setDecayTime(0U);
+    bank.setReleaseTime(0U);
+    bank.noteOn(0, 1000U);
+    bank.tick(0, 1000U);
+    CHECK_EQUAL(SUSTAIN_LEVEL, bank.getLevel(0));
+    bank.noteOff(0, 2000U);
+    bank.tick(0, 2000U);
+    CHECK(bank.isIdle(0));
+}
+
+// Envelopes started or released without a time begin their phase on the next tick (time 0 included)
+static void testUntimedStart(void) {
+    AdsrEnvelopeBank bank;
+    configure(bank, 1);
+    bank.noteOn(0);
+    bank.tick(0, 0U);
+    bank.tick(0, 0U); // Ticking again at time 0 does not restart the phase
+    bank.tick(0, 5000U);
+    CHECK_NEAR(0x7FFF, bank.getLevel(0), 2);
+    bank.noteOff(0);
+    uint16_t start = bank.getLevel(0);
+    bank.tick(0, 8000U);
+    CHECK_EQUAL(start, bank.getLevel(0));
+    bank.tick(0, 13000U);
+    CHECK_NEAR(start / 2, bank.getLevel(0), 2);
+}
+
+// Releasing during the attack fades from the level reached
+static void testReleaseDuringAttack(void) {
+    AdsrEnvelopeBank bank;
+    configure(bank, 1);
+    bank.noteOn(0, 0U);
+    bank.noteOff(0, 5000U);
+    CHECK_NEAR(0x7FFF, bank.getLevel(0), 2);
+    bank.tick(0, 10000U);
+    CHECK_NEAR(0x4000, bank.getLevel(0), 2);
+}
+
+// Timestamps wrapping around 32 bits give the same output
+static void testTimeWrap(void) {
+    AdsrEnvelopeBank bank;
+    configure(bank, 2);
+    const uint32_t start = 0xFFFFF000;
+    bank.noteOn(0, 0U);
+    bank.noteOn(1, start);
+    for (uint32_t offset=0; offset<=40000; offset+=700) {
+        bank.tick(0, offset);
+        bank.tick(1, (uint32_t)(start + offset));
+        CHECK_EQUAL(bank.getLevel(0), bank.getLevel(1));
+    }
+}
+
+// The next change time is when the output first leaves its current level
+static void testNextChange(void) {
+    AdsrEnvelopeBank bank;
+    configure(bank, 1);
+    bank.setAttackTime(1000U);
+    bank.noteOn(0, 0U);
+    bank.tick(0, 100000U);
+    uint16_t level = bank.getLevel(0);
+    unsigned long time;
+    CHECK(bank.getNextChange(0, level, level, time));
+    bank.tick(0, time - 1);
+    CHECK_EQUAL(level, bank.getLevel(0));
+    bank.tick(0, time);
+    CHECK(bank.getLevel(0) > level);
+    bank.tick(0, 2000000U); // Sustaining envelopes do not change
+    CHECK(!bank.getNextChange(0, 0x0000, 0xFFFF, time));
+}
+
+// Curve shapes change the path but not the phase end points
+static void testCurves(void) {
+    AdsrEnvelopeBank bank;
+    configure(bank, 3);
+    bank.setGroups(3);
+    for (uint8_t group=0; group<3; group++) {
+        bank.setAttackTime(group, 10U);
+        bank.setDecayTime(group, 20U);
+        bank.setSustainLevel(group, 0.0f);
+        bank.setGroup(group, group);
+        bank.noteOn(group, 0U);
+    }
+    bank.setDecayCurve(1, AdsrEnvelopeBank::EXPONENTIAL);
+    bank.setDecayCurve(2, AdsrEnvelopeBank::LOGARITHMIC);
+    for (uint8_t index=0; index<3; index++)
+        bank.tick(index, 20000U); // Half decay
+    CHECK_NEAR(0x8000, bank.getLevel(0), 2);
+    CHECK(bank.getLevel(1) < bank.getLevel(0)); // Falls fast at first
+    CHECK(bank.getLevel(2) > bank.getLevel(0)); // Falls slowly at first
+    for (uint8_t index=0; index<3; index++) {
+        bank.tick(index, 30000U);
+        CHECK(bank.isIdle(index));
+    }
+}
+
+// Exact curve shapes of a phase progress (0.0 to 1.0)
+static double curve(AdsrEnvelopeBank::Curves shape, double progress) {
+    switch (shape) {
+        case AdsrEnvelopeBank::LINEAR:
+            return progress;
+        case AdsrEnvelopeBank::EXPONENTIAL:
+            return (1.0 - exp(-5.0 * progress)) / (1.0 - exp(-5.0));
+        case AdsrEnvelopeBank::LOGARITHMIC:
+            return (exp(5.0 * progress) - 1.0) / (exp(5.0) - 1.0);
+        case AdsrEnvelopeBank::S_CURVE:
+            return progress * progress * (3.0 - 2.0 * progress);
+    }
+    return progress;
+}
+
+// Envelope parameters for the exact curves (phase times in ms, Note Off time in us after the Note On)
+struct Parameters {
+    unsigned long attackTime;
+    unsigned long decayTime;
+    float sustainLevel;
+    unsigned long releaseTime;
+    unsigned long noteOffTime;
+};
+
+// Exact envelope level (0.0 to 1.0) at a time after the Note On
+static double exactLevel(const struct Parameters &p, AdsrEnvelopeBank::Curves shape, unsigned long time) {
+    double attackEnd = p.attackTime * 1000.0, decayEnd = attackEnd + p.decayTime * 1000.0;
+    double level;
+    unsigned long at = time < p.noteOffTime ? time : p.noteOffTime;
+    if (at < attackEnd)
+        level = curve(shape, at / attackEnd);
+    else if (at < decayEnd)
+        level = 1.0 - (1.0 - p.sustainLevel) * curve(shape, (at - attackEnd) / (decayEnd - attackEnd));
+    else
+        level = p.sustainLevel;
+    if (time < p.noteOffTime)
+        return level;
+    double releaseTime = p.releaseTime * 1000.0;
+    if (time - p.noteOffTime >= releaseTime)
+        return 0.0;
+    return level * (1.0 - curve(shape, (time - p.noteOffTime) / releaseTime));
+}
+
+// Curve shapes follow their exact formulas through all phases (ticked at an irregular period)
+static void testExactCurves(void) {
+    static const struct Parameters PARAMETERS[] = {
+        {80U, 3000U, 0.5f, 500U, 4000000U},
+        {1U, 3U, 0.25f, 7U, 20000U},
+        {0U, 0U, 1.0f, 0U, 10000U},
+        {1000U, 500U, 0.0f, 2000U, 2000000U},
+        {500U, 1000U, 0.75f, 2000U, 200000U}, // Released during the attack
+        {10U, 300U, 0.1f, 1000U, 100000U}, // Released during the decay
+        {2000U, 0U, 0.9f, 50U, 3000000U},
+    };
+    static const AdsrEnvelopeBank::Curves SHAPES[] = {
+        AdsrEnvelopeBank::LINEAR, AdsrEnvelopeBank::EXPONENTIAL,
+        AdsrEnvelopeBank::LOGARITHMIC, AdsrEnvelopeBank::S_CURVE,
+    };
+    const unsigned long tickPeriod = 997U;
+    for (size_t c=0; c<4; c++) {
+        for (size_t i=0; i<sizeof(PARAMETERS) / sizeof(PARAMETERS[0]); i++) {
+            const struct Parameters &p = PARAMETERS[i];
+            AdsrEnvelopeBank bank;
+            bank.resize(1);
+            bank.setAttackTime(p.attackTime);
+            bank.setDecayTime(p.decayTime);
+            bank.setSustainLevel(p.sustainLevel);
+            bank.setReleaseTime(p.releaseTime);
+            bank.setAttackCurve(SHAPES[c]);
+            bank.setDecayCurve(SHAPES[c]);
+            bank.setReleaseCurve(SHAPES[c]);
+            bank.noteOn(0, 0U);
+            unsigned long end = p.noteOffTime + p.releaseTime * 1000U + tickPeriod;
+            bool released = false;
+            for (unsigned long time=0U; time<=end; time+=tickPeriod) {
+                if (!released && time >= p.noteOffTime) {
+                    bank.noteOff(0, p.noteOffTime);
+                    released = true;
+                }
+                bank.tick(0, time);
+                double expected = exactLevel(p, SHAPES[c], time);
+                double actual = bank.getLevel(0) * (1.0 / AdsrEnvelopeBank::LEVEL_MAX);
+                if (fabs(expected - actual) > 1.0 / 0xFF) {
+                    printf("curve=%zu parameters=%zu time=%lu bank=%f exact=%f\n", c, i, time, actual, expected);
+                    CHECK(fabs(expected - actual) <= 1.0 / 0xFF);
+                    break;
+                }
+            }
+            CHECK(bank.isIdle(0));
+        }
+    }
+}
+
+// Envelopes use the parameters of their group
+static void testGroups(void) {
+    AdsrEnvelopeBank bank;
+    configure(bank, 2);
+    bank.setGroups(2); // Groups start with instant phases and no sustain
+    for (uint8_t group=0; group<2; group++)
+        bank.setSustainLevel(group, 1.0f);
+    bank.setAttackTime(0, 10U);
+    bank.setAttackTime(1, 20U);
+    bank.setGroup(1, 1);
+    bank.noteOn(0, 0U);
+    bank.noteOn(1, 0U);
+    bank.tick(0, 10000U);
+    bank.tick(1, 10000U);
+    CHECK_EQUAL(AdsrEnvelopeBank::LEVEL_MAX, bank.getLevel(0));
+    CHECK_NEAR(0x7FFF, bank.getLevel(1), 2);
+}
+
+// Phase times longer than half the clock range are clamped (their us do not overflow 32 bits)
+static void testLongPhases(void) {
+    AdsrEnvelopeBank bank;
+    configure(bank, 1);
+    bank.setAttackTime(5000000U); // About 83 minutes
+    bank.noteOn(0, 0U);
+    bank.tick(0, 0U);
+    bank.tick(0, 1073741500U); // Half of the clamped attack
+    CHECK_NEAR(0x7FFF, bank.getLevel(0), 2);
+    bank.tick(0, 2147483000U); // Clamped attack end
+    CHECK_EQUAL(AdsrEnvelopeBank::LEVEL_MAX, bank.getLevel(0));
+    bank.tick(0, 2147503000U); // Decay end
+    CHECK_EQUAL(SUSTAIN_LEVEL, bank.getLevel(0));
+}
+
+int main() {
+    RUN_TEST(testIdle);
+    RUN_TEST(testPhases);
+    RUN_TEST(testSkippedTicks);
+    RUN_TEST(testZeroSustainEnds);
+    RUN_TEST(testInstantPhases);
+    RUN_TEST(testUntimedStart);
+    RUN_TEST(testReleaseDuringAttack);
+    RUN_TEST(testTimeWrap);
+    RUN_TEST(testNextChange);
+    RUN_TEST(testCurves);
+    RUN_TEST(testExactCurves);
+    RUN_TEST(testGroups);
+    RUN_TEST(testLongPhases);
+    return testResult();
+}
@@ -0,0 +1,125 @@
+/**
+ * ADSR envelope tests - The fixed-point engine against curves recorded by the floating-point engine.
+ *
+ * This file is built twice, each time as its own executable: AdsrEnvelopeFloatTest (AdsrEnvelope built
+ * with ADSR_ENVELOPE_FLOAT) records the envelope output at every tick through attack, decay, sustain
+ * and release for several phase times and sustain levels into a reference file, and AdsrEnvelopeTest
+ * (fixed-point) replays the same ticks and must stay within one 8-bit brightness step of the recorded
+ * curves at every tick. ctest runs the recording first.
+ *
+ * Usage: AdsrEnvelopeTest <reference file> [--record]
+ *
+ * Hugo Hromic - http://github.com/hhromic
+ * MIT license
+ */
+
+#include <cmath>
+#include <cstring>
+#include <AdsrEnvelope.h>
+#include "MidiLedsTest.h"
+
+// Tolerance between the fixed-point engine and the reference (one 8-bit brightness step)
+#define TOLERANCE (1.0 / 0xFF)
+
+// Irregular tick period (us), so ticks do not line up with the phase ends
+#define TICK_PERIOD 997U
+
+// Envelope parameters to compare
+struct Parameters {
+    unsigned long attackTime;
+    unsigned long decayTime;
+    float sustainLevel;
+    unsigned long releaseTime;
+    unsigned long noteOffTime; // us after the Note On
+};
+static const struct Parameters PARAMETERS[] = {
+    {80U, 3000U, 0.5f, 500U, 4000000U},
+    {1U, 3U, 0.25f, 7U, 20000U},
+    {0U, 0U, 1.0f, 0U, 10000U},
+    {1000U, 500U, 0.0f, 2000U, 2000000U},
+    {500U, 1000U, 0.75f, 2000U, 200000U}, // Released during the attack
+    {10U, 300U, 0.1f, 1000U, 100000U}, // Released during the decay
+    {2000U, 0U, 0.9f, 50U, 3000000U},
+};
+
+// Reference file (written by the floating-point engine, read by the fixed-point engine)
+static FILE *referenceFile = NULL;
+static bool recordReference = false;
+
+// Record the envelope output at a tick, or compare it with the recorded one (returns false on a mismatch)
+static bool checkTick(size_t parameters, unsigned long time, AdsrEnvelope &envelope) {
+    if (recordReference) {
+        fprintf(referenceFile, "%zu %lu %.9f %u\n", parameters, time, envelope.getOutput(), envelope.scale(0xFF));
+        return true;
+    }
+    size_t recordedParameters;
+    unsigned long recordedTime;
+    float output;
+    unsigned int scaled;
+    if (fscanf(referenceFile, "%zu %lu %f %u", &recordedParameters, &recordedTime, &output, &scaled) != 4 ||
+            recordedParameters != parameters || recordedTime != time) {
+        printf("parameters=%zu time=%lu not found in the reference file\n", parameters, time);
+        CHECK(false);
+        return false;
+    }
+    double difference = fabs(envelope.getOutput() - output);
+    if (difference > TOLERANCE) {
+        printf("parameters=%zu time=%lu fixed=%f float=%f\n", parameters, time, envelope.getOutput(), output);
+        CHECK(difference <= TOLERANCE);
+        return false;
+    }
+    CHECK_NEAR(scaled, envelope.scale(0xFF), 1);
+    return true;
+}
+
+// The envelope follows the reference curves through all phases
+static void testAgainstReference(void) {
+    for (size_t i=0; i<sizeof(PARAMETERS) / sizeof(PARAMETERS[0]); i++) {
+        const struct Parameters &p = PARAMETERS[i];
+        AdsrEnvelope envelope;
+        envelope.noteOn(p.attackTime, p.decayTime, p.sustainLevel, p.releaseTime);
+        unsigned long end = p.noteOffTime + p.releaseTime * 1000U + TICK_PERIOD;
+        bool released = false;
+        for (unsigned long time=0U; time<=end; time+=TICK_PERIOD) {
+            if (!released && time >= p.noteOffTime) {
+                envelope.noteOff();
+                released = true;
+            }
+            envelope.tick(time);
+            if (!checkTick(i, time, envelope))
+                return; // Out of step with the reference file
+        }
+        envelope.tick(end + TICK_PERIOD);
+        CHECK(envelope.isIdle());
+    }
+}
+
+// Phase times longer than half the clock range are clamped
+static void testLongPhases(void) {
+    AdsrEnvelope envelope;
+    envelope.noteOn(5000000U, 20U, 0.5f, 10U); // About 83 minutes of attack
+    envelope.tick(0U);
+    envelope.tick(1073741500U); // Half of the clamped attack
+    CHECK_NEAR(0.5, envelope.getOutput(), TOLERANCE);
+    envelope.tick(2147483000U); // Clamped attack end
+    CHECK_NEAR(1.0, envelope.getOutput(), TOLERANCE);
+    envelope.tick(2147503000U); // Decay end
+    CHECK_NEAR(0.5, envelope.getOutput(), TOLERANCE);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("usage: %s <reference file> [--record]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    recordReference = argc > 2 && strcmp(argv[2], "--record") == 0;
+    referenceFile = fopen(argv[1], recordReference ? "w" : "r");
+    if (referenceFile == NULL) {
+        printf("unable to open %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    RUN_TEST(testAgainstReference);
+    RUN_TEST(testLongPhases);
+    fclose(referenceFile);
+    return testResult();
+}
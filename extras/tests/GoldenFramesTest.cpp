@@ -0,0 +1,254 @@
+/**
+ * Golden frames regression test - Replays scripted event timelines through the pedals and MidiLeds.
+ *
+ * Each scenario is a scripted timeline of MIDI events replayed on a virtual clock (as fast as possible)
+ * through the pedals into MidiLeds, with its own MidiLeds configuration. The rendered frames are compared
+ * against the golden files in extras/tests/golden within a tolerance, so that a faster implementation can
+ * be proven to render the same pixels. Render time is measured for each scenario, so correctness and
+ * performance regressions show up in the same run. Results are printed as CSV lines:
+ *   diff,scenario,frame,time,golden_time,mismatched_leds,first_led,max_difference (one per mismatched frame)
+ *   scenario,name,frames,mismatched_frames,max_difference,render_us_per_frame,result
+ *
+ * Usage: GoldenFramesTest <golden directory> [--record]
+ * Run with --record to (re-)record the golden files after an intended rendering change. Golden files
+ * are rendered with the host pixel types (extras/host), so they are only valid for host builds.
+ *
+ * The event handling chain is as follows:
+ * Scenario timeline -> Damper Pedal -> Soft Pedal -> Sostenuto Pedal -> MidiLeds -> Frame Recorder/Comparator
+ *
+ * Hugo Hromic - http://github.com/hhromic
+ * MIT license
+ */
+
+#include <chrono>
+#include <cstring>
+#include <MidiLeds.h>
+#include <MidiEventQueue.h>
+#include <MidiFrameRecorder.h>
+#include <MidiFrameComparator.h>
+#include <MidiFrameScheduler.h>
+#include <MidiDamperPedal.h>
+#include <MidiSostenutoPedal.h>
+#include <MidiSoftPedal.h>
+#include <MidiPipeline.h>
+#include "MidiLedsTest.h"
+
+// Test configuration
+#define TOLERANCE 0                 // Largest accepted difference of a color component
+#define NOTE_MIN 0x15               // note 21 (first note on standard 88 keys keyboard)
+#define NOTE_MAX 0x6C               // note 108 (last note on standard 88 keys keyboard)
+#define FRAME_RATE 60               // Rendered frames per second of virtual clock
+#define MAX_TIME 30000              // Longest replay of a scenario in ms of virtual clock
+
+// MIDI Control Change (CC) control bytes definitions
+#define CC_DAMPER_PEDAL           0x40
+#define CC_SOSTENUTO_PEDAL        0x42
+#define CC_SOFT_PEDAL             0x43
+
+//***********************************************************************
+// Global objects
+
+static FILE *goldenFile;
+static const char *scenarioName;
+static bool recordGolden = false;
+static struct CRGB leds[NOTE_MAX - NOTE_MIN + 1];
+static MidiLeds midiLeds;
+static MidiFrameRecorder frameRecorder;
+static MidiFrameComparator frameComparator;
+static MidiFrameScheduler frameScheduler;
+static MidiDamperPedal damperPedal;
+static MidiSoftPedal softPedal;
+static MidiSostenutoPedal sostenutoPedal;
+static MidiLedsSink midiLedsSink;
+static MidiPipeline<MidiDamperPedal, MidiSoftPedal, MidiSostenutoPedal, MidiLedsSink>
+    pipeline(damperPedal, softPedal, sostenutoPedal, midiLedsSink);
+
+//***********************************************************************
+// Scenarios (event times in ms of virtual clock, sorted, starting after 0)
+
+struct Scenario {
+    const char *name; // Also the golden file name
+    void (*configure)(void);
+    const struct MidiEvent *events;
+    size_t numEvents;
+};
+
+// Chords held by the damper pedal
+static const struct MidiEvent chordsEvents[] = {
+    {10, MidiEvent::NOTE_ON, 0, 60, 100}, {10, MidiEvent::NOTE_ON, 0, 64, 90}, {10, MidiEvent::NOTE_ON, 0, 67, 80},
+    {150, MidiEvent::CONTROL_CHANGE, 0, CC_DAMPER_PEDAL, 0x7F},
+    {300, MidiEvent::NOTE_OFF, 0, 60, 0}, {300, MidiEvent::NOTE_OFF, 0, 64, 0}, {300, MidiEvent::NOTE_OFF, 0, 67, 0},
+    {800, MidiEvent::NOTE_ON, 0, 65, 110}, {800, MidiEvent::NOTE_ON, 0, 69, 100}, {800, MidiEvent::NOTE_ON, 0, 72, 90},
+    {1200, MidiEvent::NOTE_OFF, 0, 65, 0}, {1200, MidiEvent::NOTE_OFF, 0, 69, 0}, {1200, MidiEvent::NOTE_OFF, 0, 72, 0},
+    {2000, MidiEvent::CONTROL_CHANGE, 0, CC_DAMPER_PEDAL, 0x00},
+};
+
+// Notes held by the sostenuto pedal while the soft pedal softens new ones
+static const struct MidiEvent pedalsEvents[] = {
+    {10, MidiEvent::NOTE_ON, 0, 36, 120}, {10, MidiEvent::NOTE_ON, 0, 48, 110},
+    {100, MidiEvent::CONTROL_CHANGE, 0, CC_SOSTENUTO_PEDAL, 0x7F},
+    {200, MidiEvent::NOTE_OFF, 0, 36, 0}, {200, MidiEvent::NOTE_OFF, 0, 48, 0},
+    {300, MidiEvent::CONTROL_CHANGE, 0, CC_SOFT_PEDAL, 0x7F},
+    {400, MidiEvent::NOTE_ON, 0, 76, 120}, {500, MidiEvent::NOTE_ON, 0, 79, 120},
+    {700, MidiEvent::NOTE_OFF, 0, 76, 0}, {700, MidiEvent::NOTE_OFF, 0, 79, 0},
+    {900, MidiEvent::CONTROL_CHANGE, 0, CC_SOFT_PEDAL, 0x00},
+    {1500, MidiEvent::CONTROL_CHANGE, 0, CC_SOSTENUTO_PEDAL, 0x00},
+};
+
+// A fast run of notes (also used with curve shapes, velocity sensitivity and stolen voices)
+static const struct MidiEvent runEvents[] = {
+    {10, MidiEvent::NOTE_ON, 0, 48, 40}, {60, MidiEvent::NOTE_ON, 0, 50, 60}, {110, MidiEvent::NOTE_ON, 0, 52, 80},
+    {160, MidiEvent::NOTE_ON, 0, 53, 100}, {210, MidiEvent::NOTE_ON, 0, 55, 120}, {260, MidiEvent::NOTE_ON, 0, 57, 127},
+    {310, MidiEvent::NOTE_ON, 0, 59, 100}, {360, MidiEvent::NOTE_ON, 0, 60, 80},
+    {400, MidiEvent::NOTE_OFF, 0, 48, 0}, {400, MidiEvent::NOTE_OFF, 0, 50, 0}, {400, MidiEvent::NOTE_OFF, 0, 52, 0},
+    {400, MidiEvent::NOTE_OFF, 0, 53, 0}, {900, MidiEvent::NOTE_OFF, 0, 55, 0}, {900, MidiEvent::NOTE_OFF, 0, 57, 0},
+    {900, MidiEvent::NOTE_OFF, 0, 59, 0}, {900, MidiEvent::NOTE_OFF, 0, 60, 0},
+};
+
+static void configureDefaults(void) {
+}
+
+static void configureCurves(void) {
+    midiLeds.setAttackTime(30);
+    midiLeds.setDecayCurve(AdsrEnvelopeBank::EXPONENTIAL);
+    midiLeds.setReleaseCurve(AdsrEnvelopeBank::S_CURVE);
+    midiLeds.setSustainLevel(0.3f);
+    midiLeds.setVelocityToDecay(0.8f);
+    midiLeds.setIgnoreVelocity(false);
+    midiLeds.setGamma(2.2f);
+    midiLeds.setBaseBrightness(0x04);
+    midiLeds.setDithering(true);
+}
+
+static void configureVoices(void) {
+    midiLeds.useVoices(4);
+    midiLeds.setStealPolicy(MidiVoicePool::QUIETEST);
+    midiLeds.setColorMapper(MidiColorMapper::RAINBOW);
+}
+
+static const struct Scenario scenarios[] = {
+    {"CHORDS", configureDefaults, chordsEvents, sizeof(chordsEvents) / sizeof(struct MidiEvent)},
+    {"PEDALS", configureDefaults, pedalsEvents, sizeof(pedalsEvents) / sizeof(struct MidiEvent)},
+    {"CURVES", configureCurves, runEvents, sizeof(runEvents) / sizeof(struct MidiEvent)},
+    {"VOICES", configureVoices, runEvents, sizeof(runEvents) / sizeof(struct MidiEvent)},
+};
+
+//***********************************************************************
+// Golden file access and diff report handlers
+
+static size_t writeGolden(const uint8_t *buffer, size_t length) {
+    return fwrite(buffer, 1, length, goldenFile);
+}
+
+static size_t readGolden(uint8_t *buffer, size_t length) {
+    return fread(buffer, 1, length, goldenFile);
+}
+
+static void onFrameDiff(unsigned long frame, unsigned long time, unsigned long goldenTime, uint16_t mismatches, uint16_t firstLed, uint8_t maxDifference) {
+    printf("diff,%s,%lu,%lu,%lu,%u,%u,%u\n", scenarioName, frame, time, goldenTime, mismatches, firstLed, maxDifference);
+}
+
+//***********************************************************************
+// Replay functions
+
+// Send a scenario event through the pedals (at its own time)
+static void dispatchEvent(const struct MidiEvent &event) {
+    midiLedsSink.setEventTime(event.time * 1000U);
+    switch (event.type) {
+        case MidiEvent::NOTE_ON: pipeline.noteOn(event.channel, event.data1, event.data2); break;
+        case MidiEvent::NOTE_OFF: pipeline.noteOff(event.channel, event.data1, event.data2); break;
+        case MidiEvent::CONTROL_CHANGE:
+            switch (event.data1) {
+                case CC_DAMPER_PEDAL:
+                    if (event.data2 < 0x40) pipeline.release(damperPedal, event.channel);
+                    else pipeline.press(damperPedal, event.channel);
+                    break;
+                case CC_SOSTENUTO_PEDAL:
+                    if (event.data2 < 0x40) pipeline.release(sostenutoPedal, event.channel);
+                    else pipeline.press(sostenutoPedal, event.channel);
+                    break;
+                case CC_SOFT_PEDAL:
+                    if (event.data2 < 0x40) pipeline.release(softPedal, event.channel);
+                    else pipeline.press(softPedal, event.channel);
+                    break;
+            }
+            break;
+    }
+}
+
+// Replay a scenario, recording or comparing its frames (returns true if it passed)
+static bool runScenario(const struct Scenario &scenario, const char *goldenDir) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s.bin", goldenDir, scenario.name);
+    goldenFile = fopen(path, recordGolden ? "wb" : "rb");
+    scenarioName = scenario.name;
+
+    // Start from a known state (pedals up, default parameters, all LEDs off)
+    for (uint8_t channel=0; channel<16; channel++) {
+        pipeline.release(damperPedal, channel);
+        pipeline.release(sostenutoPedal, channel);
+        pipeline.release(softPedal, channel);
+    }
+    midiLeds.setDithering(false);
+    midiLeds.useVoices(0);
+    midiLeds.useLeds(leds, NOTE_MIN, NOTE_MAX);
+    scenario.configure();
+    for (size_t i=0; i<NOTE_MAX - NOTE_MIN + 1; i++)
+        leds[i] = CRGB::Black;
+    bool started = goldenFile != NULL && (recordGolden ? frameRecorder.begin(NOTE_MAX - NOTE_MIN + 1) : frameComparator.begin(NOTE_MAX - NOTE_MIN + 1));
+
+    // Replay the timeline on a virtual clock (1 ms steps), rendering frames at FRAME_RATE until all LEDs are idle
+    unsigned long time = 0U;
+    std::chrono::steady_clock::duration renderTime(0);
+    unsigned long frames = 0U;
+    size_t next = 0;
+    frameScheduler.begin(time * 1000U);
+    while (started && (next < scenario.numEvents || !midiLeds.isIdle()) && time < MAX_TIME) {
+        time++;
+        for (; next < scenario.numEvents && scenario.events[next].time <= time; next++)
+            dispatchEvent(scenario.events[next]);
+        if (frameScheduler.isFrameDue(time * 1000U)) { // MidiLeds runs on microseconds
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            midiLeds.tick(frameScheduler.getFrameTime());
+            renderTime += std::chrono::steady_clock::now() - start;
+            frames++;
+            if (recordGolden)
+                frameRecorder.record(frameScheduler.getFrameTime(), leds);
+            else
+                frameComparator.compare(frameScheduler.getFrameTime(), leds);
+        }
+    }
+    bool passed = started && (recordGolden || frameComparator.end());
+    if (goldenFile != NULL)
+        fclose(goldenFile);
+
+    // Report scenario results
+    double renderUs = std::chrono::duration<double, std::micro>(renderTime).count();
+    printf("scenario,%s,%lu,%lu,%u,%.2f,%s\n", scenario.name, frames,
+        recordGolden ? 0U : frameComparator.getMismatchedFrames(),
+        recordGolden ? 0 : frameComparator.getMaxDifference(),
+        frames ? renderUs / frames : 0.0,
+        !started ? "error" : recordGolden ? "recorded" : passed ? "pass" : "fail");
+    return passed;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("usage: %s <golden directory> [--record]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    recordGolden = argc > 2 && strcmp(argv[2], "--record") == 0;
+
+    // Init frame recorder/comparator
+    midiLedsSink.setMidiLeds(0, &midiLeds);
+    frameRecorder.setHandleWrite(writeGolden);
+    frameComparator.setHandleRead(readGolden);
+    frameComparator.setHandleDiff(onFrameDiff);
+    frameComparator.setTolerance(TOLERANCE);
+    frameScheduler.setFrameRate(FRAME_RATE);
+
+    // Run all scenarios
+    for (size_t i=0; i<sizeof(scenarios) / sizeof(struct Scenario); i++)
+        CHECK(runScenario(scenarios[i], argv[1]));
+    return testResult();
+}
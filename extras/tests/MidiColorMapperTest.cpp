@@ -0,0 +1,163 @@
+/**
+ * MIDI color mapper tests - Built-in and custom mappers, note ranges and velocity scaling.
+ *
+ * Hugo Hromic - http://github.com/hhromic
+ * MIT license
+ */
+
+#include <MidiColorMapper.h>
+#include "MidiLedsTest.h"
+
+// Check that two HSV colors are equal
+static void checkColor(struct CHSV expected, struct CHSV actual) {
+    CHECK_EQUAL(expected.h, actual.h);
+    CHECK_EQUAL(expected.s, actual.s);
+    CHECK_EQUAL(expected.v, actual.v);
+}
+
+// The default mapper uses the Newton note color map for all notes
+static void testColorMap(void) {
+    MidiColorMapper mapper;
+    CHECK_EQUAL(MidiColorMapper::COLOR_MAP, mapper.getMapper(0));
+    for (uint8_t note=0; note<128; note++)
+        checkColor(MidiNoteColors::get(MidiNoteColors::NEWTON_1704, note), mapper.map(0, note, 0x7F));
+    mapper.setNoteColorMap(0, MidiNoteColors::SCRIABIN_1911);
+    for (uint8_t note=0; note<128; note++)
+        checkColor(MidiNoteColors::get(MidiNoteColors::SCRIABIN_1911, note), mapper.map(0, note, 0x7F));
+}
+
+// The rainbow mapper spreads hues over the note range in increasing order
+static void testRainbow(void) {
+    MidiColorMapper mapper;
+    mapper.setMapper(0, MidiColorMapper::RAINBOW);
+    mapper.setNoteMin(0, 36);
+    mapper.setNoteMax(0, 96);
+    CHECK_EQUAL(0, mapper.map(0, 36, 0x7F).h);
+    CHECK_NEAR(0xFF, mapper.map(0, 96, 0x7F).h, 5);
+    for (uint8_t note=37; note<=96; note++)
+        CHECK(mapper.map(0, note, 0x7F).h > mapper.map(0, note - 1, 0x7F).h);
+}
+
+// The fixed color mapper uses the same hue for all notes
+static void testFixedColor(void) {
+    MidiColorMapper mapper;
+    mapper.setMapper(0, MidiColorMapper::FIXED_COLOR);
+    mapper.setFixedHue(0, 0x60);
+    for (uint8_t note=0; note<128; note++)
+        checkColor(CHSV(0x60, 0xFF, 0xFF), mapper.map(0, note, 0x7F));
+}
+
+// Notes outside the note range are black
+static void testNoteRange(void) {
+    MidiColorMapper mapper;
+    mapper.setMapper(0, MidiColorMapper::FIXED_COLOR);
+    mapper.setNoteMin(0, 21);
+    mapper.setNoteMax(0, 108);
+    CHECK_EQUAL(0, mapper.map(0, 20, 0x7F).v);
+    CHECK_EQUAL(0xFF, mapper.map(0, 21, 0x7F).v);
+    CHECK_EQUAL(0xFF, mapper.map(0, 108, 0x7F).v);
+    CHECK_EQUAL(0, mapper.map(0, 109, 0x7F).v);
+}
+
+// Velocity scales the brightness only if velocity is not ignored
+static void testVelocity(void) {
+    MidiColorMapper mapper;
+    mapper.setMapper(0, MidiColorMapper::FIXED_COLOR);
+    CHECK(mapper.isIgnoreVelocity(0));
+    CHECK_EQUAL(0xFF, mapper.map(0, 60, 0x01).v);
+    mapper.setIgnoreVelocity(0, false);
+    CHECK_EQUAL(0xFF, mapper.map(0, 60, 0x7F).v);
+    CHECK_NEAR(0x80, mapper.map(0, 60, 0x40).v, 1);
+    CHECK_EQUAL(0, mapper.map(0, 60, 0x00).v);
+    for (uint8_t velocity=1; velocity<128; velocity++)
+        CHECK(mapper.map(0, 60, velocity).v >= mapper.map(0, 60, velocity - 1).v);
+}
+
+// Parameters are kept per MIDI channel
+static void testChannels(void) {
+    MidiColorMapper mapper;
+    mapper.setMapper(1, MidiColorMapper::FIXED_COLOR);
+    mapper.setFixedHue(1, 0xA0);
+    checkColor(MidiNoteColors::get(MidiNoteColors::NEWTON_1704, 60), mapper.map(0, 60, 0x7F));
+    checkColor(CHSV(0xA0, 0xFF, 0xFF), mapper.map(1, 60, 0x7F));
+    mapper.reset(1);
+    checkColor(MidiNoteColors::get(MidiNoteColors::NEWTON_1704, 60), mapper.map(1, 60, 0x7F));
+}
+
+// Custom mapper class giving each octave its own hue
+struct OctaveMapper {
+    static struct CHSV color(uint8_t note, uint8_t noteMin, uint8_t noteMax) {
+        return CHSV((note / 12) * 20, 0xFF, 0xFF);
+    }
+};
+
+// The custom mapper fills the note range and leaves the rest black
+static void testCustomMapper(void) {
+    MidiColorMapper mapper;
+    mapper.setMapper(0, MidiColorMapper::CUSTOM);
+    CHECK_EQUAL(0, mapper.map(0, 60, 0x7F).v); // No custom mapper set yet
+    mapper.setCustomMapper(0, MidiColorMapper::customMapper<OctaveMapper>);
+    mapper.setNoteMax(0, 95);
+    checkColor(CHSV(100, 0xFF, 0xFF), mapper.map(0, 60, 0x7F));
+    checkColor(CHSV(140, 0xFF, 0xFF), mapper.map(0, 95, 0x7F));
+    CHECK_EQUAL(0, mapper.map(0, 96, 0x7F).v);
+}
+
+// Custom note color maps are used once uploaded (and the map set again)
+static void testCustomNoteColorMap(void) {
+    struct CHSV colors[12];
+    for (size_t i=0; i<12; i++)
+        colors[i] = CHSV(i * 10, 0xFF, 0xFF);
+    MidiColorMapper mapper;
+    mapper.setNoteColorMap(0, MidiNoteColors::CUSTOM_2);
+    CHECK(MidiNoteColors::setCustomMap(MidiNoteColors::CUSTOM_2, colors));
+    CHECK(!MidiNoteColors::setCustomMap(MidiNoteColors::NEWTON_1704, colors));
+    mapper.refresh(0);
+    for (uint8_t note=0; note<128; note++)
+        checkColor(colors[note % 12], mapper.map(0, note, 0x7F));
+}
+
+// Custom mapper counting its calls (cache rebuilds)
+static unsigned long countingMapperCalls = 0;
+static void countingMapper(struct CHSV *noteColors, uint8_t noteMin, uint8_t noteMax) {
+    countingMapperCalls++;
+    for (uint16_t note=noteMin; note<=noteMax; note++)
+        noteColors[note] = CHSV(0x40, 0xFF, 0xFF);
+}
+
+// Several setters before mapping rebuild the cache once, and refresh() rebuilds it right away
+static void testBatchedRebuild(void) {
+    MidiColorMapper mapper;
+    mapper.setCustomMapper(0, countingMapper);
+    mapper.setMapper(0, MidiColorMapper::CUSTOM);
+    checkColor(CHSV(0x40, 0xFF, 0xFF), mapper.map(0, 60, 0x7F));
+    CHECK_EQUAL(1, countingMapperCalls);
+    mapper.setNoteColorMap(0, MidiNoteColors::SCRIABIN_1911);
+    mapper.setFixedHue(0, 0x80);
+    mapper.setNoteMin(0, 21);
+    mapper.setNoteMax(0, 108);
+    mapper.setCustomMapper(0, countingMapper);
+    CHECK_EQUAL(1, countingMapperCalls);
+    checkColor(CHSV(0x40, 0xFF, 0xFF), mapper.map(0, 60, 0x7F));
+    checkColor(CHSV(0x40, 0xFF, 0xFF), mapper.map(0, 61, 0x7F));
+    CHECK_EQUAL(2, countingMapperCalls);
+    checkColor(CHSV(0, 0, 0), mapper.map(0, 20, 0x7F));
+    mapper.refresh(0);
+    CHECK_EQUAL(3, countingMapperCalls);
+    mapper.setMapper(0, MidiColorMapper::FIXED_COLOR);
+    checkColor(CHSV(0x80, 0xFF, 0xFF), mapper.map(0, 60, 0x7F));
+    CHECK_EQUAL(3, countingMapperCalls);
+}
+
+int main() {
+    RUN_TEST(testColorMap);
+    RUN_TEST(testRainbow);
+    RUN_TEST(testFixedColor);
+    RUN_TEST(testNoteRange);
+    RUN_TEST(testVelocity);
+    RUN_TEST(testChannels);
+    RUN_TEST(testCustomMapper);
+    RUN_TEST(testCustomNoteColorMap);
+    RUN_TEST(testBatchedRebuild);
+    return testResult();
+}
@@ -0,0 +1,83 @@
+/**
+ * MIDI event queue tests - Single-threaded behaviour and a two-thread producer/consumer stress test.
+ *
+ * Hugo Hromic - http://github.com/hhromic
+ * MIT license
+ */
+
+#include <thread>
+#include <MidiEventQueue.h>
+#include "MidiLedsTest.h"
+
+// Number of events pushed by the stress test producer
+#define STRESS_EVENTS 500000U
+
+// Events are popped in order until the queue is empty
+static void testFifo(void) {
+    MidiEventQueue<8> queue;
+    struct MidiEvent event = { .time = 0U, .type = 0, .channel = 0, .data1 = 0, .data2 = 0 };
+    CHECK(queue.isEmpty());
+    CHECK(!queue.pop(event));
+    for (uint8_t i=0; i<5; i++)
+        CHECK(queue.push(i * 1000U, MidiEvent::NOTE_ON, 0, 60 + i, 100));
+    CHECK_EQUAL(5, queue.getCount());
+    for (uint8_t i=0; i<5; i++) {
+        CHECK(queue.pop(event));
+        CHECK_EQUAL(i * 1000U, event.time);
+        CHECK_EQUAL(60 + i, event.data1);
+    }
+    CHECK(queue.isEmpty());
+}
+
+// Events pushed to a full queue are dropped and counted
+static void testFull(void) {
+    MidiEventQueue<4> queue;
+    struct MidiEvent event = { .time = 0U, .type = 0, .channel = 0, .data1 = 0, .data2 = 0 };
+    for (uint8_t i=0; i<4; i++)
+        CHECK(queue.push(i, MidiEvent::NOTE_OFF, 0, i, 0));
+    CHECK(!queue.push(4, MidiEvent::NOTE_OFF, 0, 4, 0));
+    CHECK(!queue.push(5, MidiEvent::NOTE_OFF, 0, 5, 0));
+    CHECK_EQUAL(2, queue.getDropped());
+    CHECK(queue.pop(event));
+    CHECK_EQUAL(0, event.time);
+    CHECK(queue.push(6, MidiEvent::NOTE_OFF, 0, 6, 0));
+    CHECK_EQUAL(4, queue.getCount());
+}
+
+// A producer and a consumer thread see all events in order and intact (dropped events are retried)
+static void testProducerConsumer(void) {
+    static MidiEventQueue<64> queue;
+    unsigned long retries = 0U;
+    std::thread producer([&retries]() {
+        for (unsigned long i=0; i<STRESS_EVENTS; i++) {
+            struct MidiEvent event = { .time = i, .type = (uint8_t)(i % 3), .channel = (uint8_t)(i & 0xF), .data1 = (uint8_t)(i & 0x7F), .data2 = (uint8_t)((i >> 7) & 0x7F) };
+            while (!queue.push(event)) {
+                retries++;
+                std::this_thread::yield(); // Also lets the consumer run on single-core hosts
+            }
+        }
+    });
+    unsigned long received = 0U, errors = 0U;
+    struct MidiEvent event = { .time = 0U, .type = 0, .channel = 0, .data1 = 0, .data2 = 0 };
+    while (received < STRESS_EVENTS) {
+        if (!queue.pop(event)) {
+            std::this_thread::yield();
+            continue;
+        }
+        if (event.time != received || event.type != received % 3 || event.channel != (received & 0xF)
+            || event.data1 != (received & 0x7F) || event.data2 != ((received >> 7) & 0x7F))
+            errors++;
+        received++;
+    }
+    producer.join();
+    CHECK_EQUAL(0, errors);
+    CHECK(queue.isEmpty());
+    CHECK_EQUAL(retries, queue.getDropped());
+}
+
+int main() {
+    RUN_TEST(testFifo);
+    RUN_TEST(testFull);
+    RUN_TEST(testProducerConsumer);
+    return testResult();
+}
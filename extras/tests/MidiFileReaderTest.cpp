@@ -0,0 +1,222 @@
+/**
+ * MIDI file reader tests - Small Standard MIDI Files built in memory and replayed on a virtual clock.
+ * Covers running status, tempo changes, format 1 files with their tracks merged in time order, and files
+ * with more tracks than MIDI_FILE_MAX_TRACKS.
+ *
+ * Hugo Hromic - http://github.com/hhromic
+ * MIT license
+ */
+
+#include <cstring>
+#include <MidiFileReader.h>
+#include "MidiLedsTest.h"
+
+// In-memory MIDI file
+static uint8_t file[2048];
+static size_t fileLength = 0;
+static size_t trackStart = 0;
+
+// Append bytes to the file
+static void append(const uint8_t *data, size_t length) {
+    memcpy(file + fileLength, data, length);
+    fileLength += length;
+}
+
+// Start a file with a header chunk (division in ticks per quarter note)
+static void beginFile(uint16_t format, uint16_t chunks, uint16_t division) {
+    const uint8_t header[] = {'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, (uint8_t)format,
+        (uint8_t)(chunks >> 8), (uint8_t)chunks, (uint8_t)(division >> 8), (uint8_t)division};
+    fileLength = 0;
+    append(header, sizeof(header));
+}
+
+// Start a chunk of a type (its length is set by endChunk())
+static void beginChunk(const char *type) {
+    const uint8_t header[] = {(uint8_t)type[0], (uint8_t)type[1], (uint8_t)type[2], (uint8_t)type[3], 0, 0, 0, 0};
+    trackStart = fileLength;
+    append(header, sizeof(header));
+}
+
+// End the current chunk
+static void endChunk(void) {
+    uint32_t length = fileLength - trackStart - 8;
+    for (size_t i=0; i<4; i++)
+        file[trackStart + 4 + i] = length >> (24 - i * 8);
+}
+
+// Append a whole track of events (delta times and messages, an end of track is added)
+static void addTrack(const uint8_t *events, size_t length) {
+    const uint8_t endOfTrack[] = {0x00, 0xFF, 0x2F, 0x00};
+    beginChunk("MTrk");
+    append(events, length);
+    append(endOfTrack, sizeof(endOfTrack));
+    endChunk();
+}
+
+// Read handler of the in-memory file
+static size_t readFile(uint32_t offset, uint8_t *buffer, size_t length) {
+    if (offset >= fileLength)
+        return 0;
+    if (length > fileLength - offset)
+        length = fileLength - offset;
+    memcpy(buffer, file + offset, length);
+    return length;
+}
+
+// Replayed events (type, channel, data 1, data 2 and time in ms)
+struct Event {
+    char type;
+    uint8_t channel;
+    uint8_t data1;
+    uint8_t data2;
+    unsigned long time;
+};
+static struct Event events[64];
+static size_t numEvents = 0;
+static MidiFileReader *reader = NULL;
+
+// Record a replayed event
+static void record(char type, uint8_t channel, uint8_t data1, uint8_t data2) {
+    if (numEvents < 64)
+        events[numEvents++] = {.type = type, .channel = channel, .data1 = data1, .data2 = data2, .time = reader->getEventTime()};
+}
+static void onNoteOn(uint8_t channel, uint8_t note, uint8_t velocity) { record('+', channel, note, velocity); }
+static void onNoteOff(uint8_t channel, uint8_t note, uint8_t velocity) { record('-', channel, note, velocity); }
+static void onControlChange(uint8_t channel, uint8_t control, uint8_t value) { record('c', channel, control, value); }
+
+// Prepare a reader for the in-memory file
+static bool beginReader(MidiFileReader &midiFileReader) {
+    reader = &midiFileReader;
+    numEvents = 0;
+    midiFileReader.setHandleRead(readFile);
+    midiFileReader.setHandleNoteOn(onNoteOn);
+    midiFileReader.setHandleNoteOff(onNoteOff);
+    midiFileReader.setHandleControlChange(onControlChange);
+    return midiFileReader.begin();
+}
+
+// Check a replayed event
+static void checkEvent(size_t index, char type, uint8_t channel, uint8_t data1, uint8_t data2, unsigned long time) {
+    CHECK(index < numEvents);
+    if (index >= numEvents)
+        return;
+    CHECK_EQUAL(type, events[index].type);
+    CHECK_EQUAL(channel, events[index].channel);
+    CHECK_EQUAL(data1, events[index].data1);
+    CHECK_EQUAL(data2, events[index].data2);
+    CHECK_EQUAL(time, events[index].time);
+}
+
+// Messages without a status byte reuse the last status, and system exclusive events are skipped
+static void testRunningStatus(void) {
+    const uint8_t track[] = {
+        0x00, 0x90, 0x3C, 0x64, // Note On
+        0x60, 0x3C, 0x00,       // Running status Note On with velocity 0 (Note Off), 500 ms later
+        0x00, 0x40, 0x50,       // Running status Note On
+        0x00, 0xF0, 0x01, 0xF7, // System exclusive (skipped)
+        0x81, 0x40, 0xB1, 0x40, 0x7F, // Control Change on channel 1, 1000 ms later (2-byte delta)
+        0x00, 0x80, 0x40, 0x00, // Note Off
+    };
+    MidiFileReader midiFileReader;
+    beginFile(0, 2, 96);
+    beginChunk("XFIH"); // Unknown chunk (skipped)
+    append(track, 4);
+    endChunk();
+    addTrack(track, sizeof(track));
+    CHECK(beginReader(midiFileReader));
+    CHECK_EQUAL(0, midiFileReader.getFormat());
+    CHECK_EQUAL(1, midiFileReader.getNumTracks());
+    CHECK(!midiFileReader.playUntil(10000U));
+    CHECK(midiFileReader.isFinished());
+    CHECK_EQUAL(5, numEvents);
+    checkEvent(0, '+', 0, 0x3C, 0x64, 0U);
+    checkEvent(1, '-', 0, 0x3C, 0x00, 500U);
+    checkEvent(2, '+', 0, 0x40, 0x50, 500U);
+    checkEvent(3, 'c', 1, 0x40, 0x7F, 1500U);
+    checkEvent(4, '-', 0, 0x40, 0x00, 1500U);
+}
+
+// Tempo changes apply from their tick on, and events are dispatched when the clock reaches them
+static void testTempoChanges(void) {
+    const uint8_t track[] = {
+        0x00, 0xFF, 0x51, 0x03, 0x03, 0xD0, 0x90, // 250000 us per quarter note
+        0x60, 0x90, 0x3C, 0x64,                   // 250 ms
+        0x00, 0xFF, 0x51, 0x03, 0x0F, 0x42, 0x40, // 1000000 us per quarter note
+        0x60, 0x80, 0x3C, 0x00,                   // 250 + 1000 ms
+        0x30, 0x90, 0x3E, 0x64,                   // 1250 + 500 ms
+    };
+    MidiFileReader midiFileReader;
+    beginFile(0, 1, 96);
+    addTrack(track, sizeof(track));
+    CHECK(beginReader(midiFileReader));
+    CHECK(midiFileReader.playUntil(249U));
+    CHECK_EQUAL(0, numEvents);
+    CHECK_EQUAL(250, midiFileReader.getNextEventTime());
+    CHECK(midiFileReader.playUntil(1249U));
+    CHECK_EQUAL(1, numEvents);
+    CHECK_EQUAL(1250, midiFileReader.getNextEventTime());
+    CHECK(midiFileReader.playUntil(1250U));
+    CHECK_EQUAL(2, numEvents);
+    CHECK(!midiFileReader.playUntil(1750U)); // Last event, followed by the end of track
+    CHECK_EQUAL(3, numEvents);
+    checkEvent(0, '+', 0, 0x3C, 0x64, 250U);
+    checkEvent(1, '-', 0, 0x3C, 0x00, 1250U);
+    checkEvent(2, '+', 0, 0x3E, 0x64, 1750U);
+}
+
+// Format 1 tracks are merged in time order, with the tempo of the first track applying to all
+static void testFormat1(void) {
+    const uint8_t tempoTrack[] = {
+        0x00, 0xFF, 0x51, 0x03, 0x03, 0xD0, 0x90, // 250000 us per quarter note (96 ticks = 250 ms)
+        0x00, 0xFF, 0x03, 0x04, 'T', 'e', 's', 't', // Track name (skipped)
+    };
+    const uint8_t track1[] = {
+        0x00, 0x90, 0x3C, 0x64, // Tick 0
+        0x30, 0x80, 0x3C, 0x00, // Tick 48 (125 ms)
+        0x30, 0x90, 0x3E, 0x64, // Tick 96 (250 ms)
+    };
+    const uint8_t track2[] = {
+        0x18, 0x92, 0x30, 0x40, // Tick 24 (62 ms)
+        0x30, 0x30, 0x00,       // Tick 72 (187 ms, running status)
+    };
+    MidiFileReader midiFileReader;
+    beginFile(1, 3, 96);
+    addTrack(tempoTrack, sizeof(tempoTrack));
+    addTrack(track1, sizeof(track1));
+    addTrack(track2, sizeof(track2));
+    CHECK(beginReader(midiFileReader));
+    CHECK_EQUAL(1, midiFileReader.getFormat());
+    CHECK_EQUAL(3, midiFileReader.getNumTracks());
+    CHECK(!midiFileReader.playUntil(1000U));
+    CHECK_EQUAL(5, numEvents);
+    checkEvent(0, '+', 0, 0x3C, 0x64, 0U);
+    checkEvent(1, '+', 2, 0x30, 0x40, 62U);
+    checkEvent(2, '-', 0, 0x3C, 0x00, 125U);
+    checkEvent(3, '-', 2, 0x30, 0x00, 187U);
+    checkEvent(4, '+', 0, 0x3E, 0x64, 250U);
+}
+
+// Files with more tracks than MIDI_FILE_MAX_TRACKS are rejected instead of replayed with missing tracks
+static void testTooManyTracks(void) {
+    const uint8_t track[] = {0x00, 0x90, 0x3C, 0x64};
+    MidiFileReader midiFileReader;
+    beginFile(1, MIDI_FILE_MAX_TRACKS, 96);
+    for (size_t i=0; i<MIDI_FILE_MAX_TRACKS; i++)
+        addTrack(track, sizeof(track));
+    CHECK(beginReader(midiFileReader));
+    CHECK_EQUAL(MIDI_FILE_MAX_TRACKS, midiFileReader.getNumTracks());
+    beginFile(1, MIDI_FILE_MAX_TRACKS + 1, 96);
+    for (size_t i=0; i<MIDI_FILE_MAX_TRACKS + 1; i++)
+        addTrack(track, sizeof(track));
+    CHECK(!beginReader(midiFileReader));
+    CHECK_EQUAL(0, midiFileReader.getNumTracks());
+    CHECK(midiFileReader.isFinished());
+}
+
+int main() {
+    RUN_TEST(testRunningStatus);
+    RUN_TEST(testTempoChanges);
+    RUN_TEST(testFormat1);
+    RUN_TEST(testTooManyTracks);
+    return testResult();
+}
@@ -0,0 +1,115 @@
+/**
+ * MIDI frame scheduler tests - Frame pacing on a simulated 32-bit microsecond clock.
+ * The fake clock jumps straight to the next due frame (or stalls on purpose), so long runs are fast.
+ *
+ * Hugo Hromic - http://github.com/hhromic
+ * MIT license
+ */
+
+#include <MidiFrameScheduler.h>
+#include "MidiLedsTest.h"
+
+// Simulated micros() clock (32 bits, wraps around like on a microcontroller)
+struct FakeClock {
+    uint32_t now;
+
+    FakeClock(uint32_t start) : now(start) {}
+    unsigned long micros(void) {
+        return now;
+    }
+    void advance(unsigned long us) {
+        now += us;
+    }
+};
+
+// Frames at a frame period with a fraction of a us (60 fps) carry the fraction (no drift beyond the ns)
+static void testFractionalPeriod(void) {
+    MidiFrameScheduler scheduler;
+    FakeClock clock(1000U);
+    scheduler.setFrameRate(60);
+    scheduler.begin(clock.micros());
+    for (unsigned long frame=0; frame<6000; frame++) { // 100 s
+        clock.advance(scheduler.getSlack(clock.micros()));
+        CHECK(scheduler.isFrameDue(clock.micros()));
+        CHECK_EQUAL(1000U + frame * 16666666U / 1000U, scheduler.getFrameTime()); // 16666.666 us per frame
+        scheduler.endFrame(clock.micros() + 1000U);
+        CHECK(!scheduler.isFrameDue(clock.micros() + 1000U));
+    }
+    CHECK_EQUAL(6000, scheduler.getFrameCount());
+    CHECK_EQUAL(0, scheduler.getDroppedFrames());
+    CHECK_EQUAL(0, scheduler.getOverruns());
+    CHECK_EQUAL(0, scheduler.getMaxLateness());
+    CHECK_EQUAL(1000U + 99999996U, clock.micros() + scheduler.getSlack(clock.micros())); // Next frame after 100 s
+}
+
+// Frames a whole period late after a stall are dropped and the schedule skips ahead
+static void testDroppedFrames(void) {
+    MidiFrameScheduler scheduler;
+    FakeClock clock(0U);
+    scheduler.setFrameRate(100); // 10000 us per frame
+    CHECK(scheduler.isFrameDue(clock.micros())); // Starts the schedule
+    CHECK_EQUAL(0U, scheduler.getFrameTime());
+    clock.advance(55000U); // Stall
+    CHECK(scheduler.isFrameDue(clock.micros()));
+    CHECK_EQUAL(4, scheduler.getDroppedFrames()); // 10000 to 40000
+    CHECK_EQUAL(50000U, scheduler.getFrameTime());
+    CHECK_EQUAL(5000, scheduler.getSlack(clock.micros()));
+    clock.advance(5000U);
+    CHECK(scheduler.isFrameDue(clock.micros()));
+    CHECK_EQUAL(60000U, scheduler.getFrameTime());
+    CHECK_EQUAL(3, scheduler.getFrameCount());
+    CHECK_EQUAL(4, scheduler.getDroppedFrames());
+}
+
+// Late frames count their lateness and frames ending after the next frame is due count as overruns
+static void testOverrunsAndLateness(void) {
+    MidiFrameScheduler scheduler;
+    FakeClock clock(0U);
+    scheduler.setFrameRate(100);
+    scheduler.begin(clock.micros());
+    CHECK(scheduler.isFrameDue(clock.micros()));
+    scheduler.endFrame(3000U);
+    clock.advance(10500U);
+    CHECK(scheduler.isFrameDue(clock.micros())); // 500 us late
+    scheduler.endFrame(20100U); // Next frame already due
+    clock.now = 20100U;
+    CHECK(scheduler.isFrameDue(clock.micros())); // 100 us late
+    scheduler.endFrame(21000U);
+    CHECK_EQUAL(3, scheduler.getFrameCount());
+    CHECK_EQUAL(1, scheduler.getOverruns());
+    CHECK_EQUAL(500, scheduler.getMaxLateness());
+    CHECK_EQUAL(0, scheduler.getDroppedFrames());
+    scheduler.resetStats();
+    CHECK_EQUAL(0, scheduler.getFrameCount());
+    CHECK_EQUAL(0, scheduler.getOverruns());
+    CHECK_EQUAL(0, scheduler.getMaxLateness());
+}
+
+// The schedule, slack, lateness and dropped frames are unaffected by the clock wrap around
+static void testClockWrap(void) {
+    MidiFrameScheduler scheduler;
+    FakeClock clock(0xFFFFE000);
+    scheduler.setFrameRate(1000); // 1000 us per frame
+    scheduler.begin(clock.micros());
+    for (unsigned long frame=0; frame<16; frame++) {
+        clock.now = 0xFFFFE000 + frame * 1000U + 7U;
+        CHECK(scheduler.isFrameDue(clock.micros()));
+        CHECK_EQUAL((uint32_t)(0xFFFFE000 + frame * 1000U), (uint32_t)scheduler.getFrameTime());
+        CHECK_EQUAL(993, scheduler.getSlack(clock.micros()));
+        CHECK(!scheduler.isFrameDue(clock.micros() + 992U));
+    }
+    CHECK_EQUAL(7, scheduler.getMaxLateness());
+    clock.advance(3500U); // Stall across frames after the wrap around
+    CHECK(scheduler.isFrameDue(clock.micros()));
+    CHECK_EQUAL(2, scheduler.getDroppedFrames());
+    CHECK_EQUAL((uint32_t)(0xFFFFE000 + 18 * 1000U), (uint32_t)scheduler.getFrameTime());
+    CHECK_EQUAL(507, scheduler.getMaxLateness());
+}
+
+int main() {
+    RUN_TEST(testFractionalPeriod);
+    RUN_TEST(testDroppedFrames);
+    RUN_TEST(testOverrunsAndLateness);
+    RUN_TEST(testClockWrap);
+    return testResult();
+}
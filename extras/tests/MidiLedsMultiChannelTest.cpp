@@ -0,0 +1,169 @@
+/**
+ * MIDI Leds multi channel tests - Compositing of channels with the PRIORITY, ADD and MAX blend modes,
+ * finished voices, background layers and voice stealing across channels.
+ * Channels use fixed hues and instant envelopes (sustain 1.0), so sounding notes are at full brightness.
+ *
+ * Hugo Hromic - http://github.com/hhromic
+ * MIT license
+ */
+
+#include <MidiLedsMultiChannel.h>
+#include "MidiLedsTest.h"
+
+// Test configuration
+#define NOTE_MIN 0x15 // note 21 (first note on standard 88 keys keyboard)
+#define NOTE_MAX 0x6C // note 108 (last note on standard 88 keys keyboard)
+#define NOTE 60
+#define RED 0x00
+#define GREEN 0x60
+#define BLUE 0xA0
+
+static struct CRGB leds[NOTE_MAX - NOTE_MIN + 1];
+
+// Configure a channel with a fixed hue, instant envelopes and a blend mode
+static void configure(MidiLedsMultiChannel &midiLeds, uint8_t channel, uint8_t hue, MidiLedsMultiChannel::BlendModes blendMode) {
+    midiLeds.setColorMapper(channel, MidiColorMapper::FIXED_COLOR);
+    midiLeds.setFixedHue(channel, hue);
+    midiLeds.setAttackTime(channel, 0U);
+    midiLeds.setDecayTime(channel, 0U);
+    midiLeds.setSustainLevel(channel, 1.0f);
+    midiLeds.setReleaseTime(channel, 0U);
+    midiLeds.setBlendMode(channel, blendMode);
+}
+
+// Get the full-brightness color of a hue
+static struct CRGB colorOf(uint8_t hue) {
+    return CHSV(hue, 0xFF, 0xFF);
+}
+
+// Check that an LED has a color
+static void checkLed(struct CRGB expected, uint8_t note) {
+    CHECK_EQUAL(expected.r, leds[note - NOTE_MIN].r);
+    CHECK_EQUAL(expected.g, leds[note - NOTE_MIN].g);
+    CHECK_EQUAL(expected.b, leds[note - NOTE_MIN].b);
+}
+
+// Lower channels replace higher channels under PRIORITY
+static void testPriority(void) {
+    MidiLedsMultiChannel midiLeds;
+    midiLeds.useLeds(leds, NOTE_MIN, NOTE_MAX, 8);
+    configure(midiLeds, 0, RED, MidiLedsMultiChannel::PRIORITY);
+    configure(midiLeds, 1, GREEN, MidiLedsMultiChannel::PRIORITY);
+    midiLeds.noteOn(1, NOTE, 0x7F, 0U);
+    midiLeds.tick(0U);
+    checkLed(colorOf(GREEN), NOTE);
+    midiLeds.noteOn(0, NOTE, 0x7F, 1000U);
+    midiLeds.tick(1000U);
+    checkLed(colorOf(RED), NOTE);
+    midiLeds.noteOff(0, NOTE, 2000U); // Higher channel shows again
+    midiLeds.tick(2000U);
+    checkLed(colorOf(GREEN), NOTE);
+}
+
+// ADD adds the color components of both channels, saturating
+static void testAdd(void) {
+    MidiLedsMultiChannel midiLeds;
+    midiLeds.useLeds(leds, NOTE_MIN, NOTE_MAX, 8);
+    configure(midiLeds, 0, RED + 0x10, MidiLedsMultiChannel::ADD);
+    configure(midiLeds, 1, RED, MidiLedsMultiChannel::PRIORITY);
+    midiLeds.noteOn(0, NOTE, 0x7F, 0U);
+    midiLeds.noteOn(1, NOTE, 0x7F, 0U);
+    midiLeds.tick(0U);
+    struct CRGB expected = colorOf(RED);
+    expected += colorOf(RED + 0x10);
+    CHECK_EQUAL(0xFF, expected.r); // Saturated
+    checkLed(expected, NOTE);
+}
+
+// MAX keeps the larger value of each color component
+static void testMax(void) {
+    MidiLedsMultiChannel midiLeds;
+    midiLeds.useLeds(leds, NOTE_MIN, NOTE_MAX, 8);
+    configure(midiLeds, 0, GREEN, MidiLedsMultiChannel::MAX);
+    configure(midiLeds, 1, BLUE - 0x30, MidiLedsMultiChannel::PRIORITY);
+    midiLeds.noteOn(0, NOTE, 0x7F, 0U);
+    midiLeds.noteOn(1, NOTE, 0x7F, 0U);
+    midiLeds.tick(0U);
+    struct CRGB green = colorOf(GREEN), blue = colorOf(BLUE - 0x30);
+    checkLed(CRGB(green.r > blue.r ? green.r : blue.r, green.g > blue.g ? green.g : blue.g, green.b > blue.b ? green.b : blue.b), NOTE);
+}
+
+// A voice whose envelope just finished does not cover higher channels with black
+static void testFinishedVoice(void) {
+    MidiLedsMultiChannel midiLeds;
+    midiLeds.useLeds(leds, NOTE_MIN, NOTE_MAX, 8);
+    configure(midiLeds, 0, RED, MidiLedsMultiChannel::PRIORITY);
+    configure(midiLeds, 1, GREEN, MidiLedsMultiChannel::PRIORITY);
+    midiLeds.setReleaseTime(0, 10U);
+    midiLeds.noteOn(0, NOTE, 0x7F, 0U);
+    midiLeds.noteOn(1, NOTE, 0x7F, 0U);
+    midiLeds.tick(0U);
+    checkLed(colorOf(RED), NOTE);
+    midiLeds.noteOff(0, NOTE, 1000U);
+    midiLeds.tick(6000U); // Half released over the higher channel
+    checkLed(colorOf(RED).nscale8(0x80), NOTE);
+    midiLeds.tick(11000U); // Release finished on this tick
+    checkLed(colorOf(GREEN), NOTE);
+    CHECK_EQUAL(1, midiLeds.getVoicesUsed());
+}
+
+// The background of a channel shows on all its LEDs, and again after its notes are turned off
+static void testBackground(void) {
+    MidiLedsMultiChannel midiLeds;
+    midiLeds.useLeds(leds, NOTE_MIN, NOTE_MAX, 8);
+    configure(midiLeds, 0, BLUE, MidiLedsMultiChannel::PRIORITY);
+    midiLeds.setBaseBrightness(0, 0x40);
+    midiLeds.tick(0U);
+    struct CRGB background = colorOf(BLUE).nscale8(0x40);
+    checkLed(background, NOTE);
+    checkLed(background, NOTE_MIN);
+    midiLeds.noteOn(0, NOTE, 0x7F, 1000U);
+    midiLeds.noteOn(0, NOTE + 1, 0x7F, 1000U);
+    midiLeds.tick(1000U);
+    checkLed(colorOf(BLUE), NOTE);
+    checkLed(colorOf(BLUE), NOTE + 1);
+    midiLeds.allLedsOff(0);
+    midiLeds.tick(2000U);
+    checkLed(background, NOTE);
+    checkLed(background, NOTE + 1);
+    CHECK(midiLeds.isIdle());
+}
+
+// A full pool steals voices across channels and recoloring a channel only affects its own voices
+static void testStealingAndRecolor(void) {
+    MidiLedsMultiChannel midiLeds;
+    midiLeds.useLeds(leds, NOTE_MIN, NOTE_MAX, 2);
+    midiLeds.setStealPolicy(MidiVoicePool::OLDEST);
+    configure(midiLeds, 0, RED, MidiLedsMultiChannel::PRIORITY);
+    configure(midiLeds, 1, GREEN, MidiLedsMultiChannel::PRIORITY);
+    midiLeds.noteOn(1, NOTE, 0x7F, 0U);
+    midiLeds.noteOn(0, NOTE + 1, 0x7F, 1000U);
+    midiLeds.tick(1000U);
+    CHECK_EQUAL(2, midiLeds.getVoicesUsed());
+    CHECK_EQUAL(1, midiLeds.getVoicesUsed(0));
+    CHECK_EQUAL(1, midiLeds.getVoicesUsed(1));
+    midiLeds.noteOn(0, NOTE + 2, 0x7F, 2000U); // Steals the oldest voice (channel 1)
+    midiLeds.tick(2000U);
+    CHECK_EQUAL(2, midiLeds.getVoicesUsed());
+    CHECK_EQUAL(2, midiLeds.getVoicesUsed(0));
+    CHECK_EQUAL(0, midiLeds.getVoicesUsed(1));
+    checkLed(CRGB(0, 0, 0), NOTE);
+    checkLed(colorOf(RED), NOTE + 1);
+    checkLed(colorOf(RED), NOTE + 2);
+    midiLeds.setFixedHue(0, BLUE);
+    midiLeds.noteOn(1, NOTE + 3, 0x7F, 3000U); // Steals the oldest voice (channel 0, note + 1)
+    midiLeds.tick(3000U);
+    checkLed(CRGB(0, 0, 0), NOTE + 1);
+    checkLed(colorOf(BLUE), NOTE + 2);
+    checkLed(colorOf(GREEN), NOTE + 3);
+}
+
+int main() {
+    RUN_TEST(testPriority);
+    RUN_TEST(testAdd);
+    RUN_TEST(testMax);
+    RUN_TEST(testFinishedVoice);
+    RUN_TEST(testBackground);
+    RUN_TEST(testStealingAndRecolor);
+    return testResult();
+}
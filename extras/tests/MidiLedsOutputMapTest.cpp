@@ -0,0 +1,191 @@
+/**
+ * MIDI Leds output map tests - Notes written through an output map against a one LED per note render.
+ *
+ * The map spreads all 128 notes over two buffers: notes 0 to 63 with 2 LEDs per key from left to right,
+ * and notes 64 to 127 with 3 LEDs per key from right to left. The first and last notes also get an
+ * extra span, added before the segments so that later spans are inserted around them. The same random
+ * note streams are rendered with and without the map, and every mapped LED must match its note LED.
+ *
+ * Hugo Hromic - http://github.com/hhromic
+ * MIT license
+ */
+
+#include <cstdlib>
+#include <MidiLeds.h>
+#include <MidiLedsMultiChannel.h>
+#include "MidiLedsTest.h"
+
+// Test configuration
+#define LOW_OFFSET 4           // First LED of the low notes segment in the first buffer
+#define LOW_LEDS_PER_NOTE 2
+#define HIGH_LEDS_PER_NOTE 3
+#define EXTRA_OFFSET 192       // First LED of the extra spans in the second buffer
+#define NUM_SPANS (2 + 64 + 64)
+#define FRAMES 2000            // Rendered frames per note stream
+
+static struct CRGB reference[128];
+static struct CRGB strip1[LOW_OFFSET + 64 * LOW_LEDS_PER_NOTE + 4];
+static struct CRGB strip2[64 * HIGH_LEDS_PER_NOTE + 8];
+
+// Build the output map (extra spans of the edge notes first, then the segments of both buffers)
+static void buildMap(MidiLedsOutputMap &outputMap) {
+    outputMap.begin(NUM_SPANS);
+    CHECK(outputMap.addSpan(127, strip2, EXTRA_OFFSET + 2, 4));
+    CHECK(outputMap.addSpan(0, strip2, EXTRA_OFFSET, 2));
+    CHECK(outputMap.addSegment(strip2, 0, 64, 127, HIGH_LEDS_PER_NOTE, true));
+    CHECK(outputMap.addSegment(strip1, LOW_OFFSET, 0, 63, LOW_LEDS_PER_NOTE, false));
+    CHECK_EQUAL(NUM_SPANS, outputMap.getSpans());
+    CHECK(!outputMap.addSpan(60, strip1, 0, 1)); // Full
+}
+
+// Check that the LEDs of a span have the color of a note
+static bool checkSpan(uint8_t note, const struct CRGB *leds, size_t length) {
+    for (size_t i=0; i<length; i++)
+        if (leds[i] != reference[note]) {
+            CHECK_EQUAL(reference[note].r, leds[i].r);
+            CHECK_EQUAL(reference[note].g, leds[i].g);
+            CHECK_EQUAL(reference[note].b, leds[i].b);
+            return false;
+        }
+    return true;
+}
+
+// Check that all mapped LEDs have the color of their note and that unmapped LEDs are untouched
+static bool checkLeds(void) {
+    for (size_t note=0; note<128; note++) {
+        bool ok = note < 64 ?
+            checkSpan(note, strip1 + LOW_OFFSET + note * LOW_LEDS_PER_NOTE, LOW_LEDS_PER_NOTE) :
+            checkSpan(note, strip2 + (127 - note) * HIGH_LEDS_PER_NOTE, HIGH_LEDS_PER_NOTE);
+        if (!ok)
+            return false;
+    }
+    if (!checkSpan(0, strip2 + EXTRA_OFFSET, 2) || !checkSpan(127, strip2 + EXTRA_OFFSET + 2, 4))
+        return false;
+    const struct CRGB black = CRGB(0, 0, 0);
+    for (size_t i=0; i<LOW_OFFSET; i++)
+        CHECK(strip1[i] == black && strip1[LOW_OFFSET + 64 * LOW_LEDS_PER_NOTE + i] == black);
+    for (size_t i=EXTRA_OFFSET + 6; i<sizeof(strip2) / sizeof(strip2[0]); i++)
+        CHECK(strip2[i] == black);
+    return true;
+}
+
+// Clear all buffers
+static void clearLeds(void) {
+    for (size_t i=0; i<128; i++)
+        reference[i] = CRGB(0, 0, 0);
+    for (size_t i=0; i<sizeof(strip1) / sizeof(strip1[0]); i++)
+        strip1[i] = CRGB(0, 0, 0);
+    for (size_t i=0; i<sizeof(strip2) / sizeof(strip2[0]); i++)
+        strip2[i] = CRGB(0, 0, 0);
+}
+
+// Spans are kept sorted by note and looked up through the first span of each note (and the next note)
+static void testSpans(void) {
+    MidiLedsOutputMap outputMap;
+    clearLeds();
+    buildMap(outputMap);
+    for (size_t note=0; note<128; note++)
+        CHECK(outputMap.isMapped(note));
+    for (size_t note=0; note<128; note++)
+        reference[note] = CRGB(note, 0xFF - note, note ^ 0x55);
+    for (size_t note=0; note<128; note++)
+        CHECK(outputMap.write(note, reference[note]));
+    CHECK(!outputMap.write(0, reference[0])); // Unchanged
+    CHECK(!outputMap.write(127, reference[127]));
+    CHECK(checkLeds());
+    outputMap.clear();
+    CHECK_EQUAL(0, outputMap.getSpans());
+    CHECK(!outputMap.isMapped(0));
+    CHECK(!outputMap.isMapped(127));
+    CHECK(!outputMap.write(60, CRGB(0, 0, 0)));
+}
+
+// A MidiLeds instance renders the same colors through the map as into one LED per note
+static void testMidiLeds(void) {
+    MidiLeds midiLeds, referenceLeds;
+    MidiLedsOutputMap outputMap;
+    clearLeds();
+    buildMap(outputMap);
+    midiLeds.useLeds(NULL, 0, 127);
+    midiLeds.useOutputMap(&outputMap);
+    referenceLeds.useLeds(reference, 0, 127);
+    MidiLeds *instances[] = {&midiLeds, &referenceLeds};
+    for (size_t i=0; i<2; i++) {
+        instances[i]->setColorMapper(MidiColorMapper::RAINBOW);
+        instances[i]->setAttackTime(20U);
+        instances[i]->setDecayTime(300U);
+        instances[i]->setSustainLevel(0.3f);
+        instances[i]->setReleaseTime(200U);
+        instances[i]->setBaseBrightness(0x10);
+    }
+    srand(1);
+    for (unsigned long frame=0; frame<FRAMES; frame++) {
+        unsigned long time = frame * 10000U;
+        for (size_t event=rand() % 4; event>0; event--) {
+            uint8_t note = rand() % 2 ? rand() % 128 : (rand() % 2 ? 0 : 127); // Often the edge notes
+            unsigned long eventTime = time + rand() % 10000U;
+            bool on = rand() % 2;
+            for (size_t i=0; i<2; i++) {
+                if (on)
+                    instances[i]->noteOn(note, 1 + rand() % 127, eventTime);
+                else
+                    instances[i]->noteOff(note, eventTime);
+            }
+        }
+        midiLeds.tick(time + 10000U);
+        referenceLeds.tick(time + 10000U);
+        if (!checkLeds()) {
+            CHECK_EQUAL(-1, frame);
+            return;
+        }
+    }
+}
+
+// A MidiLedsMultiChannel instance renders the same colors through the map as into one LED per note
+static void testMultiChannel(void) {
+    MidiLedsMultiChannel midiLeds, referenceLeds;
+    MidiLedsOutputMap outputMap;
+    clearLeds();
+    buildMap(outputMap);
+    midiLeds.useLeds(NULL, 0, 127, 16);
+    midiLeds.useOutputMap(&outputMap);
+    referenceLeds.useLeds(reference, 0, 127, 16);
+    MidiLedsMultiChannel *instances[] = {&midiLeds, &referenceLeds};
+    for (size_t i=0; i<2; i++) {
+        for (uint8_t channel=0; channel<2; channel++) {
+            instances[i]->setColorMapper(channel, MidiColorMapper::FIXED_COLOR);
+            instances[i]->setFixedHue(channel, channel * 0x60);
+            instances[i]->setReleaseTime(channel, 100U);
+            instances[i]->setBlendMode(channel, MidiLedsMultiChannel::ADD);
+        }
+        instances[i]->setBaseBrightness(1, 0x08);
+    }
+    srand(2);
+    for (unsigned long frame=0; frame<FRAMES; frame++) {
+        unsigned long time = frame * 10000U;
+        for (size_t event=rand() % 4; event>0; event--) {
+            uint8_t channel = rand() % 2, note = rand() % 2 ? rand() % 128 : (rand() % 2 ? 0 : 127);
+            unsigned long eventTime = time + rand() % 10000U;
+            bool on = rand() % 2;
+            for (size_t i=0; i<2; i++) {
+                if (on)
+                    instances[i]->noteOn(channel, note, 0x7F, eventTime);
+                else
+                    instances[i]->noteOff(channel, note, eventTime);
+            }
+        }
+        midiLeds.tick(time + 10000U);
+        referenceLeds.tick(time + 10000U);
+        if (!checkLeds()) {
+            CHECK_EQUAL(-1, frame);
+            return;
+        }
+    }
+}
+
+int main() {
+    RUN_TEST(testSpans);
+    RUN_TEST(testMidiLeds);
+    RUN_TEST(testMultiChannel);
+    return testResult();
+}
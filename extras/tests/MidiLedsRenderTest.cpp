@@ -0,0 +1,212 @@
+/**
+ * MIDI Leds rendering tests - Lazily rendered LEDs against an eager reference renderer.
+ *
+ * MidiLeds only ticks notes when their brightness can change. The reference renderer instead ticks
+ * an envelope for every LED on every frame and scales its color by the brightness table, as MidiLeds
+ * did before lazy rendering. Both are fed the same random timed note streams for several parameter
+ * settings and must write the same LEDs on every frame. Dithered LEDs are checked against a float
+ * reference instead: averaged over 256 ticks, they must match the exact fading brightness.
+ *
+ * Hugo Hromic - http://github.com/hhromic
+ * MIT license
+ */
+
+#include <cstdlib>
+#include <cmath>
+#include <MidiLeds.h>
+#include "MidiLedsTest.h"
+
+// Test configuration
+#define NOTE_MIN 0x15       // note 21 (first note on standard 88 keys keyboard)
+#define NOTE_MAX 0x6C       // note 108 (last note on standard 88 keys keyboard)
+#define NUM_LEDS (NOTE_MAX - NOTE_MIN + 1)
+#define FRAMES 3000         // Rendered frames per note stream
+
+// Rendering parameters to compare
+struct Parameters {
+    unsigned long attackTime;
+    unsigned long decayTime;
+    float sustainLevel;
+    unsigned long releaseTime;
+    AdsrEnvelopeBank::Curves decayCurve;
+    AdsrEnvelopeBank::Curves releaseCurve;
+    float gamma;
+    uint8_t baseBrightness;
+    bool ignoreVelocity;
+    MidiColorMapper::Mappers colorMapper;
+};
+static const struct Parameters PARAMETERS[] = {
+    {80U, 3000U, 0.0f, 400U, AdsrEnvelopeBank::LINEAR, AdsrEnvelopeBank::LINEAR, 1.0f, 0x00, true, MidiColorMapper::COLOR_MAP},
+    {30U, 1500U, 0.3f, 800U, AdsrEnvelopeBank::EXPONENTIAL, AdsrEnvelopeBank::S_CURVE, 2.2f, 0x04, false, MidiColorMapper::RAINBOW},
+    {0U, 200U, 0.5f, 0U, AdsrEnvelopeBank::LOGARITHMIC, AdsrEnvelopeBank::EXPONENTIAL, 0.5f, 0x20, false, MidiColorMapper::COLOR_MAP},
+    {500U, 0U, 1.0f, 5000U, AdsrEnvelopeBank::S_CURVE, AdsrEnvelopeBank::LINEAR, 3.0f, 0x00, true, MidiColorMapper::FIXED_COLOR},
+};
+
+// Eager reference renderer (one envelope per LED, all ticked and rendered on every frame)
+struct EagerRenderer {
+    AdsrEnvelopeBank envelopes;
+    MidiColorMapper colorMapper;
+    uint8_t brightnessTable[256];
+    uint8_t velocities[NUM_LEDS];
+    struct Parameters parameters;
+    struct CRGB leds[NUM_LEDS];
+
+    EagerRenderer(const struct Parameters &p) : parameters(p) {
+        envelopes.resize(NUM_LEDS);
+        envelopes.setAttackTime(p.attackTime);
+        envelopes.setDecayTime(p.decayTime);
+        envelopes.setSustainLevel(p.sustainLevel);
+        envelopes.setReleaseTime(p.releaseTime);
+        envelopes.setDecayCurve(p.decayCurve);
+        envelopes.setReleaseCurve(p.releaseCurve);
+        colorMapper.setNoteMin(0, NOTE_MIN);
+        colorMapper.setNoteMax(0, NOTE_MAX);
+        colorMapper.setMapper(0, p.colorMapper);
+        colorMapper.setIgnoreVelocity(0, p.ignoreVelocity);
+        MidiLeds::buildBrightnessTable(brightnessTable, p.gamma);
+        for (size_t i=0; i<NUM_LEDS; i++)
+            velocities[i] = 0x7F;
+    }
+    void noteOn(uint8_t note, uint8_t velocity, unsigned long time) {
+        velocities[note - NOTE_MIN] = velocity;
+        envelopes.noteOn(note - NOTE_MIN, time);
+    }
+    void noteOff(uint8_t note, unsigned long time) {
+        envelopes.noteOff(note - NOTE_MIN, time);
+    }
+    void tick(unsigned long time) {
+        for (size_t i=0; i<NUM_LEDS; i++) {
+            envelopes.tick(i, time);
+            struct CHSV color = colorMapper.map(0, NOTE_MIN + i, velocities[i]);
+            uint8_t brightness = MidiLeds::scaleBrightness(brightnessTable, envelopes.getLevel(i), color.v);
+            leds[i] = CHSV(color.h, color.s, 0xFF);
+            leds[i].nscale8(brightness < parameters.baseBrightness ? parameters.baseBrightness : brightness);
+        }
+    }
+};
+
+// Lazily rendered LEDs match the eager reference on random note streams
+static void testLazyAgainstEager(void) {
+    static struct CRGB leds[NUM_LEDS];
+    srand(1);
+    for (size_t i=0; i<sizeof(PARAMETERS) / sizeof(PARAMETERS[0]); i++) {
+        const struct Parameters &p = PARAMETERS[i];
+        MidiLeds midiLeds;
+        midiLeds.useLeds(leds, NOTE_MIN, NOTE_MAX);
+        midiLeds.setAttackTime(p.attackTime);
+        midiLeds.setDecayTime(p.decayTime);
+        midiLeds.setSustainLevel(p.sustainLevel);
+        midiLeds.setReleaseTime(p.releaseTime);
+        midiLeds.setDecayCurve(p.decayCurve);
+        midiLeds.setReleaseCurve(p.releaseCurve);
+        midiLeds.setGamma(p.gamma);
+        midiLeds.setBaseBrightness(p.baseBrightness);
+        midiLeds.setIgnoreVelocity(p.ignoreVelocity);
+        midiLeds.setColorMapper(p.colorMapper);
+        EagerRenderer reference(p);
+        for (size_t j=0; j<NUM_LEDS; j++)
+            leds[j] = CRGB::Black;
+
+        // Random timed events between frames of random length (sometimes long, like skipped frames)
+        unsigned long time = 0xFFF00000; // Also crosses the clock wrap around
+        for (size_t frame=0; frame<FRAMES; frame++) {
+            unsigned long length = rand() % 16 == 0 ? 1000U + rand() % 200000U : 1000U + rand() % 20000U;
+            for (int events=rand() % 4; events--;) {
+                unsigned long eventTime = time + rand() % length;
+                uint8_t note = NOTE_MIN + rand() % 24; // Dense enough for retriggers
+                if (rand() % 2) {
+                    uint8_t velocity = 1 + rand() % 127;
+                    midiLeds.noteOn(note, velocity, eventTime);
+                    reference.noteOn(note, velocity, eventTime);
+                }
+                else {
+                    midiLeds.noteOff(note, eventTime);
+                    reference.noteOff(note, eventTime);
+                }
+            }
+            time += length;
+            midiLeds.tick(time);
+            reference.tick(time);
+            size_t mismatches = 0;
+            for (size_t j=0; j<NUM_LEDS; j++)
+                mismatches += leds[j] != reference.leds[j];
+            if (mismatches > 0) {
+                printf("parameters=%zu frame=%zu mismatched_leds=%zu\n", i, frame, mismatches);
+                CHECK_EQUAL(0, mismatches);
+                break;
+            }
+        }
+    }
+}
+
+// Dithered colors average to the exact 16-bit brightness over all thresholds
+static void testDitherAverage(void) {
+    static const uint16_t BRIGHTNESSES[] = {0x0000, 0x0001, 0x00FF, 0x0180, 0x1234, 0x7FFF, 0xA5A5, 0xFFFE, 0xFFFF};
+    struct CRGB color = CRGB(0xFF, 0x80, 0x03);
+    for (size_t i=0; i<sizeof(BRIGHTNESSES) / sizeof(BRIGHTNESSES[0]); i++) {
+        unsigned long sum[3] = {0, 0, 0};
+        for (uint16_t threshold=0; threshold<256; threshold++) {
+            struct CRGB dithered = MidiLeds::ditherColor(color, BRIGHTNESSES[i], threshold);
+            for (size_t j=0; j<3; j++)
+                sum[j] += dithered[j];
+        }
+        for (size_t j=0; j<3; j++)
+            CHECK_NEAR(color[j] * BRIGHTNESSES[i] / 65535.0, sum[j] / 256.0, 1.0 / 128);
+    }
+}
+
+// Dithered fades average to the float brightness over 256 consecutive ticks, and sustains are not dithered
+static void testDitherAgainstFloat(void) {
+    static const float GAMMAS[] = {1.0f, 2.2f, 3.0f};
+    static struct CRGB leds[NUM_LEDS];
+    const unsigned long decayTime = 10000U; // Slow enough to be constant over 256 ticks of 1 us
+    const uint8_t note = NOTE_MIN + 40;
+    for (size_t i=0; i<sizeof(GAMMAS) / sizeof(GAMMAS[0]); i++) {
+        MidiLeds midiLeds;
+        midiLeds.useLeds(leds, NOTE_MIN, NOTE_MAX);
+        midiLeds.setDithering(true);
+        midiLeds.setAttackTime(0U);
+        midiLeds.setDecayTime(decayTime);
+        midiLeds.setSustainLevel(0.0f);
+        midiLeds.setGamma(GAMMAS[i]);
+        unsigned long start = 0xFFFFFF00; // Also crosses the clock wrap around
+        midiLeds.noteOn(note, 0x7F, start);
+        midiLeds.tick(start);
+        struct CRGB color = leds[note - NOTE_MIN]; // Full brightness
+        for (size_t k=1; k<8; k++) {
+            unsigned long time = start + k * decayTime * 1000U / 8;
+            unsigned long sum[3] = {0, 0, 0};
+            for (size_t tick=0; tick<256; tick++) {
+                midiLeds.tick(time + tick);
+                for (size_t j=0; j<3; j++)
+                    sum[j] += leds[note - NOTE_MIN][j];
+            }
+            float brightness = powf(1.0f - (k / 8.0f), GAMMAS[i]);
+            for (size_t j=0; j<3; j++)
+                CHECK_NEAR(color[j] * brightness, sum[j] / 256.0, 1.0 / 64);
+        }
+    }
+
+    // Sustaining notes are rounded to their nearest color once and not ticked again
+    MidiLeds midiLeds;
+    midiLeds.useLeds(leds, NOTE_MIN, NOTE_MAX);
+    midiLeds.setDithering(true);
+    midiLeds.setAttackTime(0U);
+    midiLeds.setDecayTime(0U);
+    midiLeds.setSustainLevel(0.3f);
+    midiLeds.noteOn(note, 0x7F, 0U);
+    midiLeds.tick(0U);
+    struct CRGB sustained = leds[note - NOTE_MIN];
+    midiLeds.clearDirty();
+    for (unsigned long time=1U; time<256U; time++)
+        CHECK(!midiLeds.tick(time));
+    CHECK(!midiLeds.isChanged());
+    CHECK(sustained == leds[note - NOTE_MIN]);
+}
+
+int main() {
+    RUN_TEST(testLazyAgainstEager);
+    RUN_TEST(testDitherAverage);
+    RUN_TEST(testDitherAgainstFloat);
+    return testResult();
+}
@@ -0,0 +1,84 @@
+/**
+ * MIDI Leds stats tests - Event rates, section durations and the SysEx dump layout.
+ *
+ * Hugo Hromic - http://github.com/hhromic
+ * MIT license
+ */
+
+#include <MidiLedsStats.h>
+#include "MidiLedsTest.h"
+
+// Events are counted per channel in 1000 ms windows
+static void testEventRates(void) {
+    MidiLedsStats stats;
+    for (unsigned long time=0U; time<1000U; time+=10U)
+        stats.countEvent(3, time);
+    stats.countEvent(15, 500U);
+    CHECK_EQUAL(0, stats.getEventRate(3, 999U)); // Window not complete yet
+    CHECK_EQUAL(100, stats.getEventRate(3, 1000U));
+    CHECK_EQUAL(1, stats.getEventRate(15, 1000U));
+    CHECK_EQUAL(0, stats.getEventRate(0, 1000U));
+    CHECK_EQUAL(0, stats.getEventRate(3, 2000U)); // No events in the last window
+}
+
+// Durations are counted, maximised and averaged across the clock wrap around
+static void testDurations(void) {
+    MidiLedsStats stats;
+    unsigned long time = 0xFFFFFF00;
+    for (size_t i=0; i<4; i++) {
+        stats.beginTick(time);
+        time += 100U * (i + 1);
+        stats.endTick(time);
+    }
+    CHECK_EQUAL(4, stats.getTickCount());
+    CHECK_EQUAL(400, stats.getMaxTickTime());
+    CHECK_EQUAL(250, stats.getAverageTickTime());
+    CHECK_EQUAL(0, stats.getShowCount());
+    CHECK_EQUAL(0, stats.getAverageShowTime());
+}
+
+// Averages stay valid after the total duration exceeds 32 bits
+static void testLongRun(void) {
+    MidiLedsStats stats;
+    unsigned long time = 0U;
+    for (size_t i=0; i<5000; i++) { // 5000 s in total
+        stats.beginShow(time);
+        time += 1000000U;
+        stats.endShow(time);
+    }
+    CHECK_EQUAL(5000, stats.getShowCount());
+    CHECK_EQUAL(1000000, stats.getAverageShowTime());
+}
+
+// The SysEx dump has the documented size and framing
+static void testSysEx(void) {
+    MidiLedsStats stats;
+    uint8_t sysEx[MidiLedsStats::SYSEX_SIZE];
+    stats.setActiveEnvelopes(0, 300);
+    stats.setActiveEnvelopes(15, 88);
+    stats.setSkippedFrames(5);
+    CHECK_EQUAL(300, stats.getActiveEnvelopes(0));
+    CHECK_EQUAL(0, stats.getActiveEnvelopes(1));
+    CHECK_EQUAL(0, stats.getSysEx(sysEx, sizeof(sysEx) - 1, 0U));
+    CHECK_EQUAL(MidiLedsStats::SYSEX_SIZE, stats.getSysEx(sysEx, sizeof(sysEx), 0U));
+    CHECK_EQUAL(0xF0, sysEx[0]);
+    CHECK_EQUAL(0x02, sysEx[5]); // Dump version
+    CHECK_EQUAL(0xF7, sysEx[MidiLedsStats::SYSEX_SIZE - 1]);
+    size_t offset = 6 + 16 * 3 + 2 * 3; // Active envelopes of each instance
+    CHECK_EQUAL(300, sysEx[offset] | (sysEx[offset + 1] << 7) | (sysEx[offset + 2] << 14));
+    CHECK_EQUAL(0, sysEx[offset + 3] | (sysEx[offset + 4] << 7) | (sysEx[offset + 5] << 14));
+    offset += 15 * 3;
+    CHECK_EQUAL(88, sysEx[offset] | (sysEx[offset + 1] << 7) | (sysEx[offset + 2] << 14));
+    offset = MidiLedsStats::SYSEX_SIZE - 1 - 5; // Skipped frames
+    CHECK_EQUAL(5, sysEx[offset]);
+    for (size_t i=1; i<MidiLedsStats::SYSEX_SIZE - 1; i++)
+        CHECK(sysEx[i] < 0x80);
+}
+
+int main() {
+    RUN_TEST(testEventRates);
+    RUN_TEST(testDurations);
+    RUN_TEST(testLongRun);
+    RUN_TEST(testSysEx);
+    return testResult();
+}
@@ -0,0 +1,55 @@
+#ifndef MIDI_LEDS_TEST_H
+#define MIDI_LEDS_TEST_H
+/**
+ * MIDI Leds host tests - Minimal assertion helpers for the host-side unit tests.
+ * Each test executable runs its test functions with RUN_TEST() and returns testResult() from main(),
+ * so ctest reports it as failed if any check failed. Failed checks print their file, line and values.
+ *
+ * Hugo Hromic - http://github.com/hhromic
+ * MIT license
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+static unsigned long testFailures = 0;
+
+// Check that a condition holds
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+        testFailures++; \
+        printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+    } \
+} while (0)
+
+// Check that two integer values are equal
+#define CHECK_EQUAL(expected, actual) do { \
+    long _expected = (long)(expected), _actual = (long)(actual); \
+    if (_expected != _actual) { \
+        testFailures++; \
+        printf("%s:%d: CHECK_EQUAL(%s, %s) failed: %ld != %ld\n", __FILE__, __LINE__, #expected, #actual, _expected, _actual); \
+    } \
+} while (0)
+
+// Check that two numeric values differ by at most a tolerance
+#define CHECK_NEAR(expected, actual, tolerance) do { \
+    double _expected = (double)(expected), _actual = (double)(actual); \
+    if (_expected - _actual > (tolerance) || _actual - _expected > (tolerance)) { \
+        testFailures++; \
+        printf("%s:%d: CHECK_NEAR(%s, %s, %s) failed: %g != %g\n", __FILE__, __LINE__, #expected, #actual, #tolerance, _expected, _actual); \
+    } \
+} while (0)
+
+// Run a test function and report its result
+#define RUN_TEST(test) do { \
+    unsigned long _failures = testFailures; \
+    test(); \
+    printf("%s %s\n", testFailures == _failures ? "PASS" : "FAIL", #test); \
+} while (0)
+
+// Get the exit status of a test executable
+static inline int testResult(void) {
+    return testFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#endif
@@ -0,0 +1,124 @@
+/**
+ * MIDI Leds velocity tests - Envelopes following the Note On velocity.
+ * Hard (127), normal (64) and soft (1) notes are played together and their LED brightness is compared
+ * with the attack time, decay time and sustain level scaled for their velocity.
+ *
+ * Hugo Hromic - http://github.com/hhromic
+ * MIT license
+ */
+
+#include <MidiLeds.h>
+#include "MidiLedsTest.h"
+
+// Test configuration
+#define NOTE_MIN 0x15 // note 21 (first note on standard 88 keys keyboard)
+#define NOTE_MAX 0x6C // note 108 (last note on standard 88 keys keyboard)
+#define HARD_NOTE 60
+#define NORMAL_NOTE 62
+#define SOFT_NOTE 64
+
+static struct CRGB leds[NOTE_MAX - NOTE_MIN + 1];
+
+// Configure an instance with a fixed full-brightness color (so LEDs only follow the envelopes)
+static void configure(MidiLeds &midiLeds) {
+    midiLeds.useLeds(leds, NOTE_MIN, NOTE_MAX);
+    midiLeds.setColorMapper(MidiColorMapper::FIXED_COLOR);
+    midiLeds.setAttackTime(100U);
+    midiLeds.setDecayTime(1000U);
+    midiLeds.setSustainLevel(0.25f);
+    midiLeds.setReleaseTime(100U);
+}
+
+// Play the hard, normal and soft notes at a given time
+static void play(MidiLeds &midiLeds, unsigned long time) {
+    midiLeds.noteOn(HARD_NOTE, 127, time);
+    midiLeds.noteOn(NORMAL_NOTE, 64, time);
+    midiLeds.noteOn(SOFT_NOTE, 1, time);
+}
+
+// Get the brightness of a note LED (0.0 to 1.0, red is at full brightness with hue 0)
+static float brightness(uint8_t note) {
+    return leds[note - NOTE_MIN].r / 255.0f;
+}
+
+// Hard notes attack slower and soft notes instantly with a velocity to attack of 1.0
+static void testVelocityToAttack(void) {
+    MidiLeds midiLeds;
+    configure(midiLeds);
+    midiLeds.setVelocityToAttack(1.0f);
+    play(midiLeds, 0U);
+    midiLeds.tick(0U);
+    CHECK_NEAR(0.0, brightness(HARD_NOTE), 0.01);
+    CHECK_NEAR(0.0, brightness(NORMAL_NOTE), 0.01);
+    CHECK_NEAR(1.0, brightness(SOFT_NOTE), 0.01);
+    midiLeds.tick(50000U); // Half of the normal attack
+    CHECK_NEAR(0.25, brightness(HARD_NOTE), 0.01);
+    CHECK_NEAR(0.5, brightness(NORMAL_NOTE), 0.01);
+    midiLeds.tick(100000U); // Normal attack end
+    CHECK_NEAR(0.5, brightness(HARD_NOTE), 0.01);
+    CHECK_NEAR(1.0, brightness(NORMAL_NOTE), 0.01);
+    midiLeds.tick(200000U); // Hard attack end
+    CHECK_NEAR(1.0, brightness(HARD_NOTE), 0.01);
+}
+
+// Hard notes decay slower and soft notes instantly with a velocity to decay of 1.0
+static void testVelocityToDecay(void) {
+    MidiLeds midiLeds;
+    configure(midiLeds);
+    midiLeds.setAttackTime(0U);
+    midiLeds.setSustainLevel(0.0f);
+    midiLeds.setVelocityToDecay(1.0f);
+    play(midiLeds, 0U);
+    midiLeds.tick(0U);
+    CHECK_NEAR(1.0, brightness(HARD_NOTE), 0.01);
+    CHECK_NEAR(1.0, brightness(NORMAL_NOTE), 0.01);
+    CHECK_NEAR(0.0, brightness(SOFT_NOTE), 0.01);
+    midiLeds.tick(500000U); // Half of the normal decay
+    CHECK_NEAR(0.75, brightness(HARD_NOTE), 0.01);
+    CHECK_NEAR(0.5, brightness(NORMAL_NOTE), 0.01);
+    midiLeds.tick(1000000U); // Normal decay end
+    CHECK_NEAR(0.5, brightness(HARD_NOTE), 0.01);
+    CHECK_NEAR(0.0, brightness(NORMAL_NOTE), 0.01);
+}
+
+// Hard notes sustain higher and soft notes at zero with a velocity to sustain of 1.0
+static void testVelocityToSustain(void) {
+    MidiLeds midiLeds;
+    configure(midiLeds);
+    midiLeds.setVelocityToSustain(1.0f);
+    play(midiLeds, 0U);
+    midiLeds.tick(0U);
+    midiLeds.tick(2000000U); // Sustaining
+    CHECK_NEAR(0.5, brightness(HARD_NOTE), 0.01);
+    CHECK_NEAR(0.25, brightness(NORMAL_NOTE), 0.01);
+    CHECK_NEAR(0.0, brightness(SOFT_NOTE), 0.01);
+}
+
+// Sounding notes follow amounts changed and cleared between ticks, as set on the next tick
+static void testAmountChanges(void) {
+    MidiLeds midiLeds;
+    configure(midiLeds);
+    play(midiLeds, 0U);
+    midiLeds.tick(0U);
+    midiLeds.tick(2000000U);
+    CHECK_NEAR(0.25, brightness(HARD_NOTE), 0.01);
+    midiLeds.setVelocityToSustain(1.0f);
+    midiLeds.noteOff(SOFT_NOTE, 2000000U); // Released with the parameters in use before the next tick
+    CHECK(!midiLeds.isIdle());
+    midiLeds.tick(2010000U);
+    CHECK_NEAR(0.5, brightness(HARD_NOTE), 0.01);
+    CHECK_NEAR(0.25, brightness(NORMAL_NOTE), 0.01);
+    CHECK_NEAR(0.225, brightness(SOFT_NOTE), 0.01); // A tenth of its release
+    midiLeds.setVelocityToSustain(0.0f);
+    midiLeds.tick(2020000U);
+    CHECK_NEAR(0.25, brightness(HARD_NOTE), 0.01);
+    CHECK_NEAR(0.25, brightness(NORMAL_NOTE), 0.01);
+}
+
+int main() {
+    RUN_TEST(testVelocityToAttack);
+    RUN_TEST(testVelocityToDecay);
+    RUN_TEST(testVelocityToSustain);
+    RUN_TEST(testAmountChanges);
+    return testResult();
+}
@@ -0,0 +1,206 @@
+/**
+ * MIDI pedals tests - Hold and release semantics of the damper, sostenuto and soft pedals.
+ * Pedals are used as pipeline stages in front of a sink that records the notes reaching it.
+ *
+ * Hugo Hromic - http://github.com/hhromic
+ * MIT license
+ */
+
+#include <MidiDamperPedal.h>
+#include <MidiSostenutoPedal.h>
+#include <MidiSoftPedal.h>
+#include "MidiLedsTest.h"
+
+// Pipeline sink recording the sounding notes of all channels and the last Note On velocity
+struct RecordingSink {
+    uint32_t sounding[16][4];
+    uint8_t lastVelocity;
+    unsigned long batches;
+
+    RecordingSink() : lastVelocity(0), batches(0U) {
+        for (size_t i=0; i<16; i++)
+            for (size_t j=0; j<4; j++)
+                sounding[i][j] = 0x00000000;
+    }
+    void noteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
+        bitSet(sounding[channel][note / 32], note % 32);
+        lastVelocity = velocity;
+    }
+    void noteOff(uint8_t channel, uint8_t note, uint8_t velocity) {
+        bitClear(sounding[channel][note / 32], note % 32);
+    }
+    void notesOff(uint8_t channel, const uint32_t *notes) {
+        for (size_t i=0; i<4; i++)
+            sounding[channel][i] &= ~notes[i];
+        batches++;
+    }
+    bool isSounding(uint8_t channel, uint8_t note) {
+        return bitRead(sounding[channel][note / 32], note % 32);
+    }
+};
+
+// Without the damper pedal, Note Off messages pass through
+static void testDamperPassThrough(void) {
+    MidiDamperPedal damper;
+    RecordingSink sink;
+    damper.noteOn(0, 60, 100, sink);
+    CHECK(sink.isSounding(0, 60));
+    damper.noteOff(0, 60, 0, sink);
+    CHECK(!sink.isSounding(0, 60));
+    CHECK_EQUAL(0, damper.getHeldNotes());
+}
+
+// The damper pedal holds all Note Off messages until released (in a single batch)
+static void testDamperHoldAndRelease(void) {
+    MidiDamperPedal damper;
+    RecordingSink sink;
+    damper.noteOn(0, 60, 100, sink);
+    damper.noteOn(0, 100, 100, sink);
+    damper.press(0);
+    damper.noteOff(0, 60, 0, sink);
+    damper.noteOff(0, 100, 0, sink);
+    CHECK(sink.isSounding(0, 60));
+    CHECK(sink.isSounding(0, 100));
+    CHECK_EQUAL(2, damper.getHeldNotes());
+    damper.release(0, sink);
+    CHECK(!sink.isSounding(0, 60));
+    CHECK(!sink.isSounding(0, 100));
+    CHECK_EQUAL(1, sink.batches);
+    CHECK_EQUAL(0, damper.getHeldNotes());
+}
+
+// Notes played again while held are no longer released by the damper pedal
+static void testDamperReplayedNote(void) {
+    MidiDamperPedal damper;
+    RecordingSink sink;
+    damper.press(0);
+    damper.noteOn(0, 60, 100, sink);
+    damper.noteOff(0, 60, 0, sink);
+    damper.noteOn(0, 60, 100, sink);
+    CHECK_EQUAL(0, damper.getHeldNotes());
+    damper.release(0, sink);
+    CHECK(sink.isSounding(0, 60));
+}
+
+// The damper pedal only holds notes of its channel
+static void testDamperChannels(void) {
+    MidiDamperPedal damper;
+    RecordingSink sink;
+    damper.press(1);
+    damper.noteOn(0, 60, 100, sink);
+    damper.noteOn(1, 60, 100, sink);
+    damper.noteOff(0, 60, 0, sink);
+    damper.noteOff(1, 60, 0, sink);
+    CHECK(!sink.isSounding(0, 60));
+    CHECK(sink.isSounding(1, 60));
+    damper.release(1, sink);
+    CHECK(!sink.isSounding(1, 60));
+}
+
+// The sostenuto pedal only holds the notes sounding when it was pressed
+static void testSostenutoHoldAndRelease(void) {
+    MidiSostenutoPedal sostenuto;
+    RecordingSink sink;
+    sostenuto.noteOn(0, 60, 100, sink);
+    sostenuto.press(0);
+    sostenuto.noteOn(0, 64, 100, sink);
+    sostenuto.noteOff(0, 60, 0, sink);
+    sostenuto.noteOff(0, 64, 0, sink);
+    CHECK(sink.isSounding(0, 60)); // Sounding at press time, held
+    CHECK(!sink.isSounding(0, 64)); // Played after the press, not held
+    CHECK_EQUAL(1, sostenuto.getHeldNotes());
+    sostenuto.release(0, sink);
+    CHECK(!sink.isSounding(0, 60));
+    CHECK_EQUAL(0, sostenuto.getHeldNotes());
+}
+
+// Notes released before the sostenuto pedal is pressed are not held
+static void testSostenutoReleasedBeforePress(void) {
+    MidiSostenutoPedal sostenuto;
+    RecordingSink sink;
+    sostenuto.noteOn(0, 60, 100, sink);
+    sostenuto.noteOff(0, 60, 0, sink);
+    sostenuto.press(0);
+    sostenuto.noteOn(0, 60, 100, sink);
+    sostenuto.noteOff(0, 60, 0, sink);
+    CHECK(!sink.isSounding(0, 60));
+    CHECK_EQUAL(0, sostenuto.getHeldNotes());
+}
+
+// Batches of Note Off messages only pass the notes the sostenuto pedal does not hold
+static void testSostenutoBatches(void) {
+    MidiSostenutoPedal sostenuto;
+    RecordingSink sink;
+    sostenuto.noteOn(0, 60, 100, sink);
+    sostenuto.press(0);
+    sostenuto.noteOn(0, 100, 100, sink);
+    uint32_t notes[4] = {0x00000000, 0x00000000, 0x00000000, 0x00000000};
+    bitSet(notes[60 / 32], 60 % 32);
+    bitSet(notes[100 / 32], 100 % 32);
+    sostenuto.notesOff(0, notes, sink);
+    CHECK(sink.isSounding(0, 60));
+    CHECK(!sink.isSounding(0, 100));
+}
+
+// The damper pedal behind the sostenuto pedal holds the rest (the usual chain)
+static void testChainedPedals(void) {
+    MidiSostenutoPedal sostenuto;
+    MidiDamperPedal damper;
+    RecordingSink sink;
+    damper.noteOn(0, 60, 100, sink);
+    sostenuto.noteOn(0, 60, 100, sink);
+    sostenuto.press(0);
+    damper.press(0);
+    sostenuto.noteOff(0, 60, 0, damper); // Held by the sostenuto pedal, never reaches the damper
+    CHECK_EQUAL(0, damper.getHeldNotes());
+    damper.release(0, sink);
+    CHECK(sink.isSounding(0, 60));
+    sostenuto.release(0, sink);
+    CHECK(!sink.isSounding(0, 60));
+}
+
+// The soft pedal scales Note On velocities while pressed
+static void testSoftPedal(void) {
+    MidiSoftPedal soft;
+    RecordingSink sink;
+    soft.noteOn(0, 60, 90, sink);
+    CHECK_EQUAL(90, sink.lastVelocity);
+    soft.press(0);
+    soft.noteOn(0, 60, 90, sink);
+    CHECK_EQUAL(60, sink.lastVelocity);
+    soft.release(0, sink);
+    soft.noteOn(0, 60, 90, sink);
+    CHECK_EQUAL(90, sink.lastVelocity);
+}
+
+// Runtime handlers receive held notes one at a time if no batch handler is set
+static uint8_t handledNotes;
+static void countNoteOff(uint8_t channel, uint8_t note, uint8_t velocity) {
+    handledNotes++;
+}
+static void testDamperHandlers(void) {
+    MidiDamperPedal damper;
+    damper.setHandleNoteOff(countNoteOff);
+    handledNotes = 0;
+    damper.press(0);
+    for (uint8_t note=0; note<128; note++)
+        damper.noteOff(0, note, 0);
+    CHECK_EQUAL(0, handledNotes);
+    CHECK_EQUAL(128, damper.getHeldNotes());
+    damper.release(0);
+    CHECK_EQUAL(128, handledNotes);
+}
+
+int main() {
+    RUN_TEST(testDamperPassThrough);
+    RUN_TEST(testDamperHoldAndRelease);
+    RUN_TEST(testDamperReplayedNote);
+    RUN_TEST(testDamperChannels);
+    RUN_TEST(testSostenutoHoldAndRelease);
+    RUN_TEST(testSostenutoReleasedBeforePress);
+    RUN_TEST(testSostenutoBatches);
+    RUN_TEST(testChainedPedals);
+    RUN_TEST(testSoftPedal);
+    RUN_TEST(testDamperHandlers);
+    return testResult();
+}
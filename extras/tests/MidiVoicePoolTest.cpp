@@ -0,0 +1,178 @@
+/**
+ * MIDI voice pool tests - Voice allocation, the hash index of sounding notes and the steal policies.
+ * Colliding notes are found with the same Fibonacci hashing as the pool, so that freeing voices must
+ * shift the following entries of a probe run back. A random allocate/free sequence is also checked
+ * against a plain table of the sounding notes.
+ *
+ * Hugo Hromic - http://github.com/hhromic
+ * MIT license
+ */
+
+#include <cstdlib>
+#include <MidiVoicePool.h>
+#include <AdsrEnvelopeBank.h>
+#include "MidiLedsTest.h"
+
+// Home index slot of a channel note in a pool index of a given size (as MidiVoicePool::slotOf())
+static uint16_t homeOf(uint8_t channel, uint8_t note, uint16_t numSlots) {
+    uint16_t key = ((channel & 0xF) << 7) | (note & 0x7F);
+    return ((key * 0x9E37U) >> 7) & (numSlots - 1);
+}
+
+// Voices are allocated once per channel note, found, freed and reused up to the polyphony
+static void testAllocateAndFree(void) {
+    MidiVoicePool pool;
+    pool.resize(4);
+    CHECK_EQUAL(4, pool.getPolyphony());
+    for (uint8_t i=0; i<4; i++)
+        CHECK_EQUAL(i, pool.allocateVoice(i % 2, 60 + i));
+    CHECK_EQUAL(2, pool.allocateVoice(0, 62)); // Already sounding
+    CHECK(pool.isFull());
+    CHECK_EQUAL(4, pool.getVoicesUsed());
+    CHECK_EQUAL(0x0003, pool.getActiveChannels());
+    CHECK_EQUAL(-1, pool.allocateVoice(2, 60)); // Exhausted
+    CHECK_EQUAL(-1, pool.findVoice(2, 60));
+    CHECK_EQUAL(1, pool.findVoice(1, 61));
+    CHECK_EQUAL(1, pool.getChannel(1));
+    CHECK_EQUAL(61, pool.getNote(1));
+    pool.freeVoice(1);
+    CHECK(!pool.isActive(1));
+    CHECK(!pool.isFull());
+    CHECK_EQUAL(-1, pool.findVoice(1, 61));
+    CHECK_EQUAL(3, pool.findVoice(1, 63));
+    CHECK_EQUAL(1, pool.allocateVoice(2, 60)); // Lowest free voice
+    CHECK_EQUAL(0x0007, pool.getActiveChannels());
+    pool.freeAll();
+    CHECK_EQUAL(0, pool.getVoicesUsed());
+    CHECK_EQUAL(0x0000, pool.getActiveChannels());
+    CHECK_EQUAL(-1, pool.findVoice(0, 60));
+}
+
+// Freeing a voice in the middle of a probe run keeps the notes after it findable
+static void testCollisions(void) {
+    const uint8_t polyphony = 8;
+    const uint16_t numSlots = 16; // Twice the polyphony
+    MidiVoicePool pool;
+    pool.resize(polyphony);
+
+    // Four notes with the same home slot, and one whose home slot is inside their probe run
+    uint8_t channels[5], notes[5];
+    size_t count = 0;
+    uint16_t home = homeOf(0, 0, numSlots);
+    for (uint16_t key=0; key<2048 && count<4; key++)
+        if (homeOf(key >> 7, key & 0x7F, numSlots) == home) {
+            channels[count] = key >> 7;
+            notes[count++] = key & 0x7F;
+        }
+    for (uint16_t key=0; key<2048 && count<5; key++)
+        if (homeOf(key >> 7, key & 0x7F, numSlots) == ((home + 2) & (numSlots - 1))) {
+            channels[count] = key >> 7;
+            notes[count++] = key & 0x7F;
+        }
+    CHECK_EQUAL(5, count);
+    for (size_t i=0; i<5; i++)
+        CHECK_EQUAL(i, pool.allocateVoice(channels[i], notes[i]));
+
+    // Free from the front and the middle of the run, the others must stay findable
+    size_t order[] = {0, 2, 4, 1, 3};
+    for (size_t i=0; i<5; i++) {
+        pool.freeVoice(order[i]);
+        CHECK_EQUAL(-1, pool.findVoice(channels[order[i]], notes[order[i]]));
+        for (size_t j=i + 1; j<5; j++)
+            CHECK_EQUAL(order[j], pool.findVoice(channels[order[j]], notes[order[j]]));
+    }
+    CHECK_EQUAL(0, pool.getVoicesUsed());
+}
+
+// Random allocations and frees match a plain table of the sounding notes
+static void testRandomAgainstTable(void) {
+    MidiVoicePool pool;
+    int16_t table[4][32];
+    pool.resize(16);
+    for (size_t channel=0; channel<4; channel++)
+        for (size_t note=0; note<32; note++)
+            table[channel][note] = -1;
+    srand(1);
+    for (size_t i=0; i<20000; i++) {
+        uint8_t channel = rand() % 4, note = rand() % 32;
+        if (rand() % 2) {
+            int16_t voice = pool.allocateVoice(channel, note);
+            if (table[channel][note] >= 0)
+                CHECK_EQUAL(table[channel][note], voice);
+            else if (voice < 0)
+                CHECK_EQUAL(16, pool.getVoicesUsed());
+            table[channel][note] = voice;
+        }
+        else if (table[channel][note] >= 0) {
+            pool.freeVoice(table[channel][note]);
+            table[channel][note] = -1;
+        }
+        size_t used = 0;
+        for (size_t c=0; c<4; c++)
+            for (size_t n=0; n<32; n++) {
+                used += table[c][n] >= 0;
+                if (pool.findVoice(c, n) != table[c][n]) {
+                    CHECK_EQUAL(table[c][n], pool.findVoice(c, n));
+                    return;
+                }
+            }
+        CHECK_EQUAL(used, pool.getVoicesUsed());
+    }
+}
+
+// Each policy steals its victim from a full pool (levels 0.9, 0.4, 0.1 and 0.7 of voices 0 to 3)
+static void testStealPolicies(void) {
+    static const unsigned long ATTACKS[] = {0U, 50000U, 80000U, 20000U}; // Note On times (us)
+    static const MidiVoicePool::StealPolicies POLICIES[] = {MidiVoicePool::OLDEST, MidiVoicePool::QUIETEST, MidiVoicePool::RELEASED_FIRST};
+    static const uint8_t VICTIMS[] = {0, 2, 1};
+    for (size_t i=0; i<3; i++) {
+        MidiVoicePool pool;
+        AdsrEnvelopeBank envelopes;
+        pool.resize(4);
+        pool.setStealPolicy(POLICIES[i]);
+        envelopes.resize(4);
+        envelopes.setAttackTime(100U);
+        envelopes.setSustainLevel(1.0f);
+        envelopes.setReleaseTime(1000U);
+        for (uint8_t voice=0; voice<4; voice++) {
+            CHECK_EQUAL(voice, pool.allocateVoice(0, 60 + voice));
+            envelopes.noteOn(voice, ATTACKS[voice]);
+        }
+        envelopes.noteOff(3, 85000U); // Released voices (the oldest is voice 1)
+        envelopes.noteOff(1, 85000U);
+        for (uint8_t voice=0; voice<4; voice++)
+            envelopes.tick(voice, 90000U);
+        CHECK_EQUAL(VICTIMS[i], pool.stealVoice(envelopes));
+        CHECK_EQUAL(3, pool.getVoicesUsed());
+        CHECK_EQUAL(60 + VICTIMS[i], pool.getNote(VICTIMS[i])); // Still readable
+        CHECK_EQUAL(-1, pool.findVoice(0, 60 + VICTIMS[i]));
+    }
+}
+
+// Retriggered voices become the newest, and policies fall back to the oldest voice
+static void testStealFallbacks(void) {
+    MidiVoicePool pool;
+    AdsrEnvelopeBank envelopes;
+    pool.resize(3);
+    envelopes.resize(3);
+    for (uint8_t voice=0; voice<3; voice++)
+        pool.allocateVoice(0, 60 + voice);
+    pool.allocateVoice(0, 60); // Retrigger
+    pool.setStealPolicy(MidiVoicePool::OLDEST);
+    CHECK_EQUAL(1, pool.stealVoice(envelopes));
+    pool.allocateVoice(0, 70);
+    pool.setStealPolicy(MidiVoicePool::RELEASED_FIRST); // None released
+    CHECK_EQUAL(2, pool.stealVoice(envelopes));
+    pool.allocateVoice(0, 71);
+    pool.setStealPolicy(MidiVoicePool::QUIETEST); // All idle (same level)
+    CHECK_EQUAL(0, pool.stealVoice(envelopes));
+}
+
+int main() {
+    RUN_TEST(testAllocateAndFree);
+    RUN_TEST(testCollisions);
+    RUN_TEST(testRandomAgainstTable);
+    RUN_TEST(testStealPolicies);
+    RUN_TEST(testStealFallbacks);
+    return testResult();
+}